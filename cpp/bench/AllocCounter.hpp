@@ -0,0 +1,85 @@
+#pragma once
+
+// 替换malloc族函数统计分配次数和堆上的字节数，operator new和onnxruntime内部的分配最终都走这里。
+// 定义的是全局符号，每个可执行程序只能在一个源文件里include
+#include <errno.h>
+#include <malloc.h>
+#include <stddef.h>
+#include <atomic>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+static std::atomic<size_t> g_alloc_count(0);
+// 当前未释放的字节数(按malloc_usable_size)及其峰值
+static std::atomic<size_t> g_alloc_live(0);
+static std::atomic<size_t> g_alloc_peak(0);
+
+// 进程启动以来的分配次数，前后两次相减得到一段代码的分配次数
+inline size_t alloc_count() {
+    return g_alloc_count.load(std::memory_order_relaxed);
+}
+
+inline size_t alloc_live_bytes() {
+    return g_alloc_live.load(std::memory_order_relaxed);
+}
+
+// 上次alloc_reset_peak以来的峰值，减去当时的alloc_live_bytes得到一段代码额外占用的堆
+inline size_t alloc_peak_bytes() {
+    return g_alloc_peak.load(std::memory_order_relaxed);
+}
+
+inline void alloc_reset_peak() {
+    g_alloc_peak.store(alloc_live_bytes(), std::memory_order_relaxed);
+}
+
+static inline void* alloc_track(void* ptr) {
+    if (ptr) {
+        size_t live = g_alloc_live.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed) + malloc_usable_size(ptr);
+        size_t peak = g_alloc_peak.load(std::memory_order_relaxed);
+        while (live > peak && !g_alloc_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+    return ptr;
+}
+
+static inline void alloc_untrack(void* ptr) {
+    if (ptr)
+        g_alloc_live.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+}
+
+extern "C" {
+__attribute__((visibility("default"))) void* malloc(size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return alloc_track(__libc_malloc(size));
+}
+__attribute__((visibility("default"))) void* calloc(size_t n, size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return alloc_track(__libc_calloc(n, size));
+}
+__attribute__((visibility("default"))) void* realloc(void* ptr, size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_untrack(ptr);
+    return alloc_track(__libc_realloc(ptr, size));
+}
+__attribute__((visibility("default"))) void* memalign(size_t alignment, size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    return alloc_track(__libc_memalign(alignment, size));
+}
+__attribute__((visibility("default"))) void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+__attribute__((visibility("default"))) int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    *ptr = memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+__attribute__((visibility("default"))) void free(void* ptr) {
+    alloc_untrack(ptr);
+    __libc_free(ptr);
+}
+}
@@ -0,0 +1,347 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// 端到端benchmark：模型只加载一次，语料每行作为一次合成，预热后跑N轮，
+// 统计RTF、首包时间、每句延迟分位数、吞吐和峰值RSS，结果写成JSON，
+// --baseline与保存的结果对比，变差超过阈值的指标标记为回归并返回非0
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "cmdline.hpp"
+#include "MeloTTS.hpp"
+#include "Profiler.hpp"
+#include "FlacEncoder.hpp"
+#include "server/HttpServer.hpp"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+    return sorted[idx];
+}
+
+// 进程的峰值RSS，单位KB
+static long peak_rss_kb() {
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage))
+        return 0;
+    return usage.ru_maxrss;
+}
+
+// 指标名、越小越好还是越大越好
+struct Metric {
+    const char* name;
+    bool lower_is_better;
+};
+
+static const Metric kMetrics[] = {
+    {"rtf", true},
+    {"throughput_audio_s_per_s", false},
+    {"ttfa_p50_ms", true},
+    {"ttfa_p90_ms", true},
+    {"ttfa_p99_ms", true},
+    {"latency_p50_ms", true},
+    {"latency_p90_ms", true},
+    {"latency_p99_ms", true},
+    {"latency_max_ms", true},
+    {"peak_rss_kb", true},
+    {"slices_per_sentence", true},
+    {"slice_efficiency", false},
+    {"decoded_per_output_frame", true},
+    {"decoder_ms_saved_per_utterance", false},
+    {"flac_compression_ratio", false},
+    {"flac_encode_mb_per_s", false},
+};
+
+static std::string format_number(double value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.4f", value);
+    return buf;
+}
+
+// 对比当前结果和baseline，返回回归的指标数
+static int compare(const std::map<std::string, std::string>& result,
+                   const std::map<std::string, std::string>& baseline, double threshold) {
+    printf("\n%-26s %14s %14s %10s\n", "metric", "baseline", "current", "change");
+    int regressions = 0;
+    for (const Metric& m : kMetrics) {
+        auto cur_it = result.find(m.name);
+        auto base_it = baseline.find(m.name);
+        if (cur_it == result.end() || base_it == baseline.end())
+            continue;
+        double cur = atof(cur_it->second.c_str());
+        double base = atof(base_it->second.c_str());
+        double change = base != 0 ? (cur - base) / base * 100.0 : 0;
+        bool worse = m.lower_is_better ? change > threshold : change < -threshold;
+        printf("%-26s %14.4f %14.4f %+9.2f%% %s\n", m.name, base, cur, change, worse ? "REGRESSION" : "");
+        if (worse)
+            regressions++;
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("encoder", 'e', "encoder onnx", false, "");
+    cmd.add<std::string>("decoder", 'd', "decoder axmodel, or onnx for cpu backend; comma separated models with different dec_len are dispatched per slice", false, "");
+    cmd.add<std::string>("lexicon", 'l', "lexicon.txt", false, "../models/lexicon.txt");
+    cmd.add<std::string>("token", 't', "tokens.txt", false, "../models/tokens.txt");
+    cmd.add<std::string>("g", 0, "g.bin", false, "");
+    cmd.add<std::string>("language", 0, "language, choose from ZH, EN, JP", false, "ZH");
+    cmd.add<std::string>("backend", 0, "decoder backend, choose from npu, cpu, mock", false, "npu");
+
+    cmd.add<std::string>("file", 'f', "corpus, one utterance per line, default ../model_convert/test_text_<lang>.txt", false, "");
+    cmd.add<int>("iterations", 'n', "times to synthesize the whole corpus", false, 5);
+    cmd.add<int>("warmup", 0, "untimed passes over the corpus", false, 1);
+    cmd.add<float>("speed", 0, "speak speed", false, 0.8f);
+    cmd.add<int>("sample_rate", 0, "resample the output to this rate in the pipeline, 0 keeps 44100", false, 0);
+    cmd.add<std::string>("output", 'o', "write results as json", false, "");
+    cmd.add<std::string>("baseline", 'b', "compare with a json written by --output", false, "");
+    cmd.add<int>("flac", 0, "also encode each utterance to flac in memory with this many threads, 0 disables", false, 0);
+    cmd.add<float>("threshold", 0, "percent a metric may get worse before it counts as a regression", false, 5.0f);
+
+    cmd.add<int>("pipeline_depth", 0, "max encoded sentences waiting for decoder", false, 2);
+    cmd.add<int>("decoder_depth", 0, "decoder slices in flight, 1 runs slices synchronously", false, 2);
+    cmd.add("cached_io", 0, "use cached CMM for npu decoder io");
+    cmd.add<std::string>("slice_planner", 0, "decoder slicing, choose from greedy, optimal", false, "greedy");
+    cmd.add<int>("stitch_overlap", 0, "slice z_p by frames with this many overlapped frames and crossfade them, 0 overlaps two whole words", false, 0);
+    cmd.add<std::string>("crossfade", 0, "crossfade curve for --stitch_overlap, choose from power, linear", false, "power");
+    cmd.add<int>("encoder_threads", 0, "sentences encoded concurrently by the encoder pool", false, 1);
+    cmd.add("io_binding", 0, "bind encoder inputs and outputs to preallocated buffers");
+    cmd.add("no_encoder_cache", 0, "do not load or save the optimized encoder next to the onnx");
+    cmd.add<int>("intra_op_threads", 0, "onnxruntime global intra-op threads", false, 1);
+    cmd.add<int>("inter_op_threads", 0, "onnxruntime global inter-op threads", false, 1);
+    cmd.parse_check(argc, argv);
+
+    MeloTTSConfig config;
+    config.encoder_file   = cmd.get<std::string>("encoder");
+    config.decoder_file   = cmd.get<std::string>("decoder");
+    config.lexicon_file   = cmd.get<std::string>("lexicon");
+    config.token_file     = cmd.get<std::string>("token");
+    config.g_file         = cmd.get<std::string>("g");
+    config.backend        = cmd.get<std::string>("backend");
+    config.language       = cmd.get<std::string>("language");
+    config.decoder_depth  = cmd.get<int>("decoder_depth");
+    config.decoder_cached_io = cmd.exist("cached_io");
+    config.slice_planner = cmd.get<std::string>("slice_planner");
+    config.stitch_overlap = cmd.get<int>("stitch_overlap");
+    config.crossfade = cmd.get<std::string>("crossfade");
+    config.encoder_threads = cmd.get<int>("encoder_threads");
+    config.encoder_io_binding = cmd.exist("io_binding");
+    config.encoder_cache = !cmd.exist("no_encoder_cache");
+    config.intra_op_threads = cmd.get<int>("intra_op_threads");
+    config.inter_op_threads = cmd.get<int>("inter_op_threads");
+    config.pipeline_depth = cmd.get<int>("pipeline_depth");
+    config.ResolveDefaultPaths();
+
+    auto iterations = cmd.get<int>("iterations");
+    auto warmup     = cmd.get<int>("warmup");
+    auto threshold  = cmd.get<float>("threshold");
+    auto corpus_file = cmd.get<std::string>("file");
+    if (corpus_file.empty()) {
+        std::string lower_lang = config.language;
+        std::transform(lower_lang.begin(), lower_lang.end(), lower_lang.begin(), ::tolower);
+        corpus_file = "../model_convert/test_text_" + lower_lang + ".txt";
+    }
+
+    std::vector<std::string> corpus;
+    std::ifstream ifs(corpus_file);
+    if (!ifs.is_open()) {
+        printf("Open %s failed!\n", corpus_file.c_str());
+        return -1;
+    }
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            corpus.push_back(line);
+    }
+    if (corpus.empty()) {
+        printf("No utterance in %s!\n", corpus_file.c_str());
+        return -1;
+    }
+
+    std::map<std::string, std::string> baseline;
+    if (cmd.exist("baseline")) {
+        std::ifstream bfs(cmd.get<std::string>("baseline"));
+        std::stringstream ss;
+        ss << bfs.rdbuf();
+        if (!bfs.is_open() || !parse_flat_json(ss.str(), baseline)) {
+            printf("Read baseline %s failed!\n", cmd.get<std::string>("baseline").c_str());
+            return -1;
+        }
+    }
+
+    MeloTTS tts;
+    if (0 != tts.Init(config)) {
+        printf("Init MeloTTS failed!\n");
+        return -1;
+    }
+
+    SynthesizeOptions options;
+    options.speed = cmd.get<float>("speed");
+    options.sample_rate = cmd.get<int>("sample_rate");
+    const int out_rate = options.sample_rate > 0 ? options.sample_rate : tts.GetSampleRate();
+    const int flac_threads = cmd.get<int>("flac");
+    std::unique_ptr<FlacEncoder> flac;
+    if (flac_threads > 0)
+        flac.reset(new FlacEncoder(flac_threads));
+
+    std::vector<double> latency, ttfa;
+    double total_wall_ms = 0, total_audio_s = 0;
+    size_t sentences = 0, slices = 0, useful_frames = 0, decoded_frames = 0;
+    double decoder_ms_saved = 0;
+    // 不计入合成耗时，压缩率相对16bit PCM
+    double flac_ms = 0, flac_pcm_bytes = 0, flac_bytes = 0;
+    for (int iter = -warmup; iter < iterations; iter++) {
+        // 只统计预热之后的阶段耗时
+        if (iter == 0) {
+            Profiler::Reset();
+            Profiler::SetEnabled(true);
+        }
+        for (auto& text : corpus) {
+            std::vector<float> audio;
+            SynthesizeStats stats;
+            double start = get_current_time();
+            if (0 != tts.Synthesize(text, options, audio, &stats)) {
+                printf("Synthesize failed: %s\n", text.c_str());
+                return -1;
+            }
+            double wall_ms = get_current_time() - start;
+            if (iter < 0)
+                continue;
+            latency.push_back(wall_ms);
+            ttfa.push_back(stats.first_audio_ms);
+            total_wall_ms += wall_ms;
+            sentences += stats.sentences;
+            slices += stats.decoder_slices;
+            useful_frames += stats.decoder_useful_frames;
+            decoded_frames += stats.decoder_frames;
+            decoder_ms_saved += stats.decoder_ms_saved;
+            total_audio_s += static_cast<double>(audio.size()) / out_rate;
+            if (flac) {
+                size_t bytes = 0;
+                double flac_start = get_current_time();
+                if (0 != flac->Begin(out_rate, [&bytes](const uint8_t*, size_t n) { bytes += n; return 0; }) ||
+                    0 != flac->Encode(audio.data(), audio.size()) || 0 != flac->Finish()) {
+                    printf("Encode flac failed: %s\n", text.c_str());
+                    return -1;
+                }
+                flac_ms += get_current_time() - flac_start;
+                flac_pcm_bytes += audio.size() * sizeof(int16_t);
+                flac_bytes += bytes;
+            }
+        }
+    }
+    std::sort(latency.begin(), latency.end());
+    std::sort(ttfa.begin(), ttfa.end());
+
+    std::map<std::string, double> metrics;
+    metrics["rtf"] = total_audio_s > 0 ? total_wall_ms / 1000.0 / total_audio_s : 0;
+    metrics["throughput_audio_s_per_s"] = total_wall_ms > 0 ? total_audio_s / (total_wall_ms / 1000.0) : 0;
+    metrics["ttfa_p50_ms"] = percentile(ttfa, 50);
+    metrics["ttfa_p90_ms"] = percentile(ttfa, 90);
+    metrics["ttfa_p99_ms"] = percentile(ttfa, 99);
+    metrics["latency_p50_ms"] = percentile(latency, 50);
+    metrics["latency_p90_ms"] = percentile(latency, 90);
+    metrics["latency_p99_ms"] = percentile(latency, 99);
+    metrics["latency_max_ms"] = latency.empty() ? 0 : latency.back();
+    metrics["peak_rss_kb"] = peak_rss_kb();
+    metrics["slices_per_sentence"] = sentences ? static_cast<double>(slices) / sentences : 0;
+    metrics["slice_efficiency"] = decoded_frames ? static_cast<double>(useful_frames) / decoded_frames : 0;
+    metrics["decoded_per_output_frame"] = useful_frames ? static_cast<double>(decoded_frames) / useful_frames : 0;
+    metrics["stitch_overlap"] = config.stitch_overlap;
+    metrics["sample_rate"] = out_rate;
+    metrics["decoder_ms_saved_per_utterance"] = latency.empty() ? 0 : decoder_ms_saved / latency.size();
+    if (flac) {
+        metrics["flac_compression_ratio"] = flac_bytes > 0 ? flac_pcm_bytes / flac_bytes : 0;
+        metrics["flac_encode_mb_per_s"] = flac_ms > 0 ? flac_pcm_bytes / (1024.0 * 1024.0) / (flac_ms / 1000.0) : 0;
+    }
+    metrics["audio_s"] = total_audio_s;
+    metrics["wall_s"] = total_wall_ms / 1000.0;
+    metrics["encoder_load_ms"] = tts.GetEncoderLoadMs();
+    metrics["decoder_load_ms"] = tts.GetDecoderLoadMs();
+
+    printf("\nCorpus %s: %zu utterances x %d iterations (warm-up %d)\n", corpus_file.c_str(), corpus.size(), iterations, warmup);
+    printf("RTF:             %.4f\n", metrics["rtf"]);
+    printf("Throughput:      %.2f audio s / wall s\n", metrics["throughput_audio_s_per_s"]);
+    printf("First audio(ms): p50 %.2f  p90 %.2f  p99 %.2f\n",
+           metrics["ttfa_p50_ms"], metrics["ttfa_p90_ms"], metrics["ttfa_p99_ms"]);
+    printf("Latency(ms):     p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           metrics["latency_p50_ms"], metrics["latency_p90_ms"], metrics["latency_p99_ms"], metrics["latency_max_ms"]);
+    printf("Peak RSS:        %.1f MB\n", metrics["peak_rss_kb"] / 1024.0);
+    printf("Slices:          %.2f per sentence, %.1f%% useful frames, %.3f decoded frames per output frame (%s, overlap %s)\n",
+           metrics["slices_per_sentence"], metrics["slice_efficiency"] * 100.0, metrics["decoded_per_output_frame"],
+           config.slice_planner.c_str(),
+           config.stitch_overlap > 0 ? (std::to_string(config.stitch_overlap) + " frames " + config.crossfade).c_str() : "2 words");
+    printf("Decoder windows: %.2f ms saved per utterance\n", metrics["decoder_ms_saved_per_utterance"]);
+    if (flac)
+        printf("FLAC:            %.3fx smaller than pcm16, encode %.1f MB/s (%d threads)\n",
+               metrics["flac_compression_ratio"], metrics["flac_encode_mb_per_s"], flac_threads);
+    if (Profiler::IsCompiled()) {
+        printf("\nStage latency (ms):\n");
+        Profiler::Print(stdout);
+    }
+
+    // 平铺的JSON，数值之外只有描述配置的字符串，--baseline用同一个解析器读回
+    std::map<std::string, std::string> result;
+    for (auto& kv : metrics)
+        result[kv.first] = format_number(kv.second);
+    if (cmd.exist("output")) {
+        std::string json = "{\"language\": \"" + json_escape(config.language) + "\", \"backend\": \"" +
+                           json_escape(config.backend) + "\", \"slice_planner\": \"" +
+                           json_escape(config.slice_planner) + "\", \"crossfade\": \"" +
+                           json_escape(config.crossfade) + "\", \"corpus\": \"" + json_escape(corpus_file) +
+                           "\", \"utterances\": " + std::to_string(corpus.size()) +
+                           ", \"iterations\": " + std::to_string(iterations);
+        for (auto& kv : result)
+            json += ", \"" + kv.first + "\": " + kv.second;
+        json += "}\n";
+        FILE* fp = fopen(cmd.get<std::string>("output").c_str(), "w");
+        if (!fp || fwrite(json.data(), 1, json.size(), fp) != json.size()) {
+            printf("Write %s failed!\n", cmd.get<std::string>("output").c_str());
+            if (fp)
+                fclose(fp);
+            return -1;
+        }
+        fclose(fp);
+        printf("Results written to %s\n", cmd.get<std::string>("output").c_str());
+    }
+
+    if (!baseline.empty()) {
+        if (baseline["language"] != config.language || baseline["corpus"] != corpus_file)
+            printf("\nWarning: baseline was measured on %s / %s\n", baseline["language"].c_str(), baseline["corpus"].c_str());
+        int regressions = compare(result, baseline, threshold);
+        if (regressions > 0) {
+            printf("%d metric(s) regressed more than %.1f%%\n", regressions, threshold);
+            return 1;
+        }
+        printf("No regression beyond %.1f%%\n", threshold);
+    }
+
+    return 0;
+}
@@ -0,0 +1,302 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// encoder池的扩展性测试：不同池大小、intra-op线程数下encoder每秒处理的句子数
+// 每个配置在单独的子进程里跑，onnxruntime的全局线程池只能在创建env时设置
+// --allocs统计预热之后每次encoder调用的堆分配次数，对比Run和绑定IO的RunBound
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "cmdline.hpp"
+#include "Lexicon.hpp"
+#include "OnnxWrapper.hpp"
+#include "OrtEnv.hpp"
+#include "EncoderPool.hpp"
+#include "split_utils.hpp"
+#include "tts_utils.hpp"
+#include "bench/AllocCounter.hpp"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static std::vector<int> parse_list(const std::string& s) {
+    std::vector<int> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        values.push_back(std::stoi(item));
+    return values;
+}
+
+// encoder的输入，前端在计时之外做好
+struct EncoderInput {
+    std::vector<int> phones, tones, langids;
+};
+
+struct BenchResult {
+    double sentences_per_s;
+    double avg_latency_ms;
+};
+
+static int run_config(const std::string& encoder_file, const std::vector<EncoderInput>& inputs, std::vector<float> g,
+                      int pool_size, int intra, int inter, int repeat, bool io_binding, BenchResult& result) {
+    OrtEnvOptions env_options;
+    env_options.intra_op_threads = intra;
+    env_options.inter_op_threads = inter;
+    OrtEnv::Get(env_options);
+
+    EncoderPool pool;
+    if (0 != pool.Init(encoder_file, pool_size, io_binding ? 512 : 0))
+        return -1;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t finished = 0;
+    double latency = 0;
+    bool failed = false;
+    auto run = [&](const EncoderInput& input, OnnxWrapper& encoder, EncoderBinding* binding) {
+        std::vector<int> phones = input.phones, tones = input.tones, langids = input.langids;
+        double start = get_current_time();
+        bool ok = true;
+        try {
+            if (binding)
+                encoder.RunBound(*binding, phones, tones, langids, g, 0.3f, 0.6f, 1.25f, 0.2f);
+            else
+                encoder.Run(phones, tones, langids, g, 0.3f, 0.6f, 1.25f, 0.2f);
+        } catch (const Ort::Exception& e) {
+            printf("Encoder exception: %s\n", e.what());
+            ok = false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        latency += get_current_time() - start;
+        failed |= !ok;
+        finished++;
+        cond.notify_all();
+    };
+    auto run_all = [&](int times) {
+        size_t total = 0;
+        for (int r = 0; r < times; r++) {
+            for (auto& input : inputs) {
+                pool.Submit([&run, &input](OnnxWrapper& encoder, EncoderBinding* binding) { run(input, encoder, binding); });
+                total++;
+            }
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return finished == total; });
+        finished = 0;
+        return !failed;
+    };
+
+    // 预热，每个工作线程至少跑一次
+    if (!run_all(1))
+        return -1;
+    latency = 0;
+
+    double start = get_current_time();
+    if (!run_all(repeat))
+        return -1;
+    double elapsed = get_current_time() - start;
+
+    size_t total = inputs.size() * repeat;
+    result.sentences_per_s = total / elapsed * 1000.0;
+    result.avg_latency_ms = latency / total;
+    return 0;
+}
+
+// 每一步平均每次调用的分配次数
+struct AllocResult {
+    double run, bind, run_bound, outputs;
+};
+
+static int count_allocs(const std::string& encoder_file, const std::vector<EncoderInput>& inputs, std::vector<float> g,
+                        int repeat, AllocResult& result) {
+    OrtEnv::Get(OrtEnvOptions());
+    OnnxWrapper encoder;
+    if (0 != encoder.Init(encoder_file))
+        return -1;
+    EncoderBinding binding;
+    if (0 != encoder.InitBinding(binding, 512))
+        return -1;
+
+    // 输入拷贝在计数之外做好，Run的参数是非const引用
+    std::vector<EncoderInput> copies(inputs);
+    size_t run = 0, bind = 0, run_bound = 0, outputs = 0;
+    std::vector<Ort::Value> consumed;
+    consumed.reserve(3);
+    try {
+        // 第一轮预热：arena扩容、每种长度的视图创建
+        for (int r = 0; r <= repeat; r++) {
+            for (auto& input : copies) {
+                size_t before = alloc_count();
+                {
+                    auto out = encoder.Run(input.phones, input.tones, input.langids, g, 0.3f, 0.6f, 1.25f, 0.2f);
+                }
+                size_t after_run = alloc_count();
+
+                if (0 != encoder.BindInputs(binding, input.phones, input.tones, input.langids, g, 0.3f, 0.6f, 1.25f, 0.2f))
+                    return -1;
+                size_t after_bind = alloc_count();
+                encoder.RunBinding(binding);
+                size_t after_run_bound = alloc_count();
+                // 与流水线一样把输出移走，z_p在计数之外释放(流水线里由decoder阶段释放)
+                for (auto& value : encoder.GetBoundOutputs(binding))
+                    consumed.push_back(std::move(value));
+                size_t after_outputs = alloc_count();
+                consumed.clear();
+
+                if (r == 0)
+                    continue;
+                run += after_run - before;
+                bind += after_bind - after_run;
+                run_bound += after_run_bound - after_bind;
+                outputs += after_outputs - after_run_bound;
+            }
+        }
+    } catch (const Ort::Exception& e) {
+        printf("Encoder exception: %s\n", e.what());
+        return -1;
+    }
+
+    double calls = (double)copies.size() * repeat;
+    result.run = run / calls;
+    result.bind = bind / calls;
+    result.run_bound = run_bound / calls;
+    result.outputs = outputs / calls;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("encoder", 'e', "encoder onnx", false, "../models/encoder-zh.onnx");
+    cmd.add<std::string>("lexicon", 'l', "lexicon.txt", false, "../models/lexicon.txt");
+    cmd.add<std::string>("token", 't', "tokens.txt", false, "../models/tokens.txt");
+    cmd.add<std::string>("g", 0, "g.bin", false, "../models/g-zh_mix_en.bin");
+    cmd.add<std::string>("language", 0, "language, choose from ZH, EN, JP", false, "ZH");
+    cmd.add<std::string>("file", 'f', "text file", false, "../model_convert/test_text_zh.txt");
+    cmd.add<std::string>("pool", 'p', "encoder pool sizes, comma separated", false, "1,2,4,8");
+    cmd.add<std::string>("intra", 0, "global intra-op threads, comma separated", false, "1");
+    cmd.add<int>("inter", 0, "global inter-op threads", false, 1);
+    cmd.add<int>("repeat", 'n', "times to encode all sentences", false, 10);
+    cmd.add("io_binding", 0, "run the pool with bound encoder io");
+    cmd.add("allocs", 0, "count heap allocations per encoder call instead of the pool sweep");
+    cmd.parse_check(argc, argv);
+
+    auto encoder_file = cmd.get<std::string>("encoder");
+    auto language     = cmd.get<std::string>("language");
+    auto pool_sizes   = parse_list(cmd.get<std::string>("pool"));
+    auto intra_list   = parse_list(cmd.get<std::string>("intra"));
+    auto inter        = cmd.get<int>("inter");
+    auto repeat       = cmd.get<int>("repeat");
+    auto io_binding   = cmd.exist("io_binding");
+
+    Lexicon lexicon(cmd.get<std::string>("lexicon"), cmd.get<std::string>("token"));
+    if (!lexicon.IsLoaded()) {
+        printf("Load lexicon failed!\n");
+        return -1;
+    }
+
+    std::vector<float> g(256, 0);
+    FILE* fp = fopen(cmd.get<std::string>("g").c_str(), "rb");
+    if (!fp) {
+        printf("Open %s failed!\n", cmd.get<std::string>("g").c_str());
+        return -1;
+    }
+    fread(g.data(), sizeof(float), g.size(), fp);
+    fclose(fp);
+
+    std::ifstream ifs(cmd.get<std::string>("file"));
+    if (!ifs.is_open()) {
+        printf("Open %s failed!\n", cmd.get<std::string>("file").c_str());
+        return -1;
+    }
+    std::vector<EncoderInput> inputs;
+    std::string line;
+    SplitResult sens;
+    while (std::getline(ifs, line)) {
+        split_sentence(line, sens, 10, language);
+        for (size_t i = 0; i < sens.size(); i++) {
+            std::vector<int> phones, tones, word2ph;
+            lexicon.convert(sens.sentence(i), phones, tones, word2ph);
+            EncoderInput input;
+            input.phones = intersperse(phones, 0);
+            input.tones = intersperse(tones, 0);
+            input.langids.assign(input.phones.size(), 3);
+            inputs.push_back(input);
+        }
+    }
+    if (inputs.empty()) {
+        printf("No sentence in %s!\n", cmd.get<std::string>("file").c_str());
+        return -1;
+    }
+
+    if (cmd.exist("allocs")) {
+        AllocResult r;
+        if (0 != count_allocs(encoder_file, inputs, g, repeat, r)) {
+            printf("Count allocations failed!\n");
+            return -1;
+        }
+        printf("heap allocations per call, %zu sentences x %d after warm-up\n", inputs.size(), repeat);
+        printf("\n%-22s %10s\n", "stage", "allocs");
+        printf("%-22s %10.2f\n", "Run", r.run);
+        printf("%-22s %10.2f\n", "RunBound: BindInputs", r.bind);
+        printf("%-22s %10.2f\n", "RunBound: Session::Run", r.run_bound);
+        printf("%-22s %10.2f\n", "RunBound: outputs", r.outputs);
+        return 0;
+    }
+
+    printf("%zu sentences x %d, %ld online cpus\n", inputs.size(), repeat, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("\n%6s %6s %14s %14s %10s\n", "pool", "intra", "sentences/s", "latency", "scaling");
+    double baseline = 0;
+    for (int intra : intra_list) {
+        for (int pool_size : pool_sizes) {
+            int fds[2];
+            if (0 != pipe(fds))
+                return -1;
+            pid_t pid = fork();
+            if (pid < 0)
+                return -1;
+            if (pid == 0) {
+                close(fds[0]);
+                BenchResult r;
+                int ret = run_config(encoder_file, inputs, g, pool_size, intra, inter, repeat, io_binding, r);
+                ssize_t n = ret == 0 ? write(fds[1], &r, sizeof(r)) : 0;
+                _exit(n == sizeof(r) ? 0 : 1);
+            }
+            close(fds[1]);
+            BenchResult r;
+            ssize_t n = read(fds[0], &r, sizeof(r));
+            close(fds[0]);
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if (n != sizeof(r) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                printf("%6d %6d failed\n", pool_size, intra);
+                continue;
+            }
+            if (baseline == 0)
+                baseline = r.sentences_per_s;
+            printf("%6d %6d %14.2f %11.2f ms %9.2fx\n", pool_size, intra, r.sentences_per_s, r.avg_latency_ms,
+                   r.sentences_per_s / baseline);
+        }
+    }
+
+    return 0;
+}
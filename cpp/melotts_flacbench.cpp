@@ -0,0 +1,471 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// FLAC编码微基准：不需要模型。对语料(wav文件，默认仓库里的demo.wav，读不到时用合成的音频)
+// 按decoder切片大小流式送入FlacEncoder，比较不同线程数和块大小的
+//   压缩率(相对16bit PCM的WAV)、编码速度(MB/s，按16bit PCM计)和实时倍数
+// 每次编码的结果都用按标准实现的解码器解回来，校验CRC8/CRC16、STREAMINFO和MD5，
+// 并与float_to_int16量化的PCM(即16bit WAV的内容)逐采样比较
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "cmdline.hpp"
+#include "AudioSink.hpp"
+#include "AudioFile.h"
+#include "audio_utils.hpp"
+#include "FlacEncoder.hpp"
+
+// decoder一片输出的采样数(dec_len 128 * 512)
+static const size_t SLICE_SAMPLES = 128 * 512;
+static const int DEFAULT_RATE = 44100;
+static const double TWO_PI = 6.283185307179586;
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<std::string> split(const std::string& s) {
+    std::vector<std::string> items;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+static std::vector<int> parse_ints(const std::string& s) {
+    std::vector<int> values;
+    for (auto& item : split(s)) {
+        int v = atoi(item.c_str());
+        if (v > 0)
+            values.push_back(v);
+    }
+    return values;
+}
+
+struct Clip {
+    std::string name;
+    int sample_rate;
+    std::vector<float> audio;
+};
+
+// 合成一段类似语音的音频：基频缓慢变化的谐波，按音节开关，再加一点噪声
+static Clip make_synthetic(float seconds) {
+    Clip clip;
+    clip.name = "synthetic";
+    clip.sample_rate = DEFAULT_RATE;
+    clip.audio.resize(static_cast<size_t>(seconds * DEFAULT_RATE));
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> noise(0.0f, 0.003f);
+    double phase = 0;
+    for (size_t i = 0; i < clip.audio.size(); i++) {
+        double t = static_cast<double>(i) / DEFAULT_RATE;
+        double f0 = 160 + 40 * std::sin(TWO_PI * 0.7 * t);
+        phase += TWO_PI * f0 / DEFAULT_RATE;
+        double envelope = std::max(0.0, std::sin(TWO_PI * 2.5 * t));
+        double v = 0;
+        for (int h = 1; h <= 12; h++)
+            v += std::sin(phase * h) / h;
+        clip.audio[i] = static_cast<float>(0.3 * envelope * v) + noise(rng);
+    }
+    return clip;
+}
+
+// ---------------------------------------------------------------- 参考解码器
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t bytes) : m_data(data), m_bytes(bytes), m_pos(0) {}
+
+    bool Ok(int bits) const { return m_pos + bits <= m_bytes * 8; }
+
+    uint32_t Get(int bits) {
+        uint32_t v = 0;
+        for (int i = 0; i < bits; i++, m_pos++)
+            v = (v << 1) | ((m_data[m_pos >> 3] >> (7 - (m_pos & 7))) & 1);
+        return v;
+    }
+
+    int32_t GetSigned(int bits) {
+        uint32_t v = Get(bits);
+        return bits > 0 && (v >> (bits - 1)) ? static_cast<int32_t>(v) - (1 << bits) : static_cast<int32_t>(v);
+    }
+
+    bool GetRice(int k, int32_t& value) {
+        uint32_t q = 0;
+        for (;;) {
+            if (!Ok(1))
+                return false;
+            if (Get(1))
+                break;
+            q++;
+        }
+        if (!Ok(k))
+            return false;
+        uint32_t u = (q << k) | Get(k);
+        value = static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+        return true;
+    }
+
+    void Align() { m_pos = (m_pos + 7) & ~static_cast<size_t>(7); }
+    size_t BytePos() const { return m_pos >> 3; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_bytes;
+    size_t m_pos;
+};
+
+// 按定义逐位计算，不与编码器共用查表
+static uint32_t crc_bits(const uint8_t* data, size_t n, int width, uint32_t poly) {
+    uint32_t crc = 0, top = 1u << (width - 1), mask = (top << 1) - 1;
+    for (size_t i = 0; i < n; i++) {
+        crc ^= static_cast<uint32_t>(data[i]) << (width - 8);
+        for (int k = 0; k < 8; k++)
+            crc = ((crc & top) ? (crc << 1) ^ poly : crc << 1) & mask;
+    }
+    return crc;
+}
+
+struct StreamInfo {
+    int min_block, max_block;
+    uint32_t min_frame, max_frame;
+    int sample_rate, channels, bits;
+    uint64_t total_samples;
+    uint8_t md5[16];
+};
+
+// 解码单声道16bit的FLAC，出错返回错误信息
+static std::string flac_decode(const std::vector<uint8_t>& data, StreamInfo& info, std::vector<int16_t>& pcm) {
+    if (data.size() < FLAC_HEADER_SIZE || memcmp(data.data(), "fLaC", 4) != 0)
+        return "missing fLaC marker";
+    BitReader meta(data.data() + 4, data.size() - 4);
+    bool last = meta.Get(1) != 0;
+    if (meta.Get(7) != 0 || meta.Get(24) != 34)
+        return "first metadata block is not STREAMINFO";
+    info.min_block = meta.Get(16);
+    info.max_block = meta.Get(16);
+    info.min_frame = meta.Get(24);
+    info.max_frame = meta.Get(24);
+    info.sample_rate = meta.Get(20);
+    info.channels = meta.Get(3) + 1;
+    info.bits = meta.Get(5) + 1;
+    info.total_samples = static_cast<uint64_t>(meta.Get(4)) << 32;
+    info.total_samples |= meta.Get(32);
+    for (int i = 0; i < 16; i++)
+        info.md5[i] = static_cast<uint8_t>(meta.Get(8));
+    if (!last)
+        return "unexpected metadata blocks";
+    if (info.channels != 1 || info.bits != 16)
+        return "not mono 16-bit";
+
+    static const int RATES[] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    size_t offset = FLAC_HEADER_SIZE;
+    uint64_t expected_frame = 0;
+    uint32_t min_frame = 0, max_frame = 0;
+    while (offset < data.size()) {
+        const uint8_t* frame = data.data() + offset;
+        BitReader br(frame, data.size() - offset);
+        if (!br.Ok(32) || br.Get(16) != 0xFFF8)
+            return "bad frame sync at byte " + std::to_string(offset);
+        int bs_code = br.Get(4), sr_code = br.Get(4);
+        int channel = br.Get(4), size_code = br.Get(3);
+        if (br.Get(1) != 0 || channel != 0 || (size_code != 4 && size_code != 0))
+            return "bad frame header";
+        // UTF-8方式编码的帧号
+        uint32_t first = br.Get(8);
+        int extra = 0;
+        uint64_t number = first;
+        if (first & 0x80) {
+            while (extra < 7 && (first & (0x40 >> extra)))
+                extra++;
+            number = first & (0x3F >> extra);
+            for (int i = 0; i < extra; i++) {
+                uint32_t b = br.Get(8);
+                if ((b & 0xC0) != 0x80)
+                    return "bad frame number";
+                number = (number << 6) | (b & 0x3F);
+            }
+        }
+        if (number != expected_frame)
+            return "frame number " + std::to_string(number) + " != " + std::to_string(expected_frame);
+        int n = 0;
+        if (bs_code == 1)
+            n = 192;
+        else if (bs_code >= 2 && bs_code <= 5)
+            n = 576 << (bs_code - 2);
+        else if (bs_code == 6)
+            n = br.Get(8) + 1;
+        else if (bs_code == 7)
+            n = br.Get(16) + 1;
+        else if (bs_code >= 8)
+            n = 256 << (bs_code - 8);
+        else
+            return "reserved block size";
+        int rate = info.sample_rate;
+        if (sr_code >= 1 && sr_code <= 11)
+            rate = RATES[sr_code];
+        else if (sr_code == 12)
+            rate = br.Get(8) * 1000;
+        else if (sr_code == 13)
+            rate = br.Get(16);
+        else if (sr_code == 14)
+            rate = br.Get(16) * 10;
+        else if (sr_code == 15)
+            return "invalid sample rate code";
+        if (rate != info.sample_rate)
+            return "frame sample rate differs from STREAMINFO";
+        size_t header_bytes = br.BytePos();
+        if (br.Get(8) != crc_bits(frame, header_bytes, 8, 0x07))
+            return "frame header crc8 mismatch";
+
+        // 子帧
+        if (br.Get(1) != 0)
+            return "bad subframe padding";
+        int type = br.Get(6);
+        if (br.Get(1) != 0)
+            return "unexpected wasted bits";
+        size_t base = pcm.size();
+        pcm.resize(base + n);
+        int16_t* x = pcm.data() + base;
+        if (type == 0) {
+            int16_t v = static_cast<int16_t>(br.GetSigned(16));
+            std::fill(x, x + n, v);
+        } else if (type == 1) {
+            for (int i = 0; i < n; i++)
+                x[i] = static_cast<int16_t>(br.GetSigned(16));
+        } else if (type >= 8 && type <= 12) {
+            int order = type - 8;
+            std::vector<int32_t> s(n);
+            for (int i = 0; i < order; i++)
+                s[i] = br.GetSigned(16);
+            int method = br.Get(2);
+            if (method > 1)
+                return "reserved residual coding method";
+            const int param_bits = method == 0 ? 4 : 5;
+            const int escape = (1 << param_bits) - 1;
+            int partition_order = br.Get(4);
+            int parts = 1 << partition_order;
+            if (n % parts != 0 || (n >> partition_order) < order)
+                return "bad partition order";
+            int i = order;
+            for (int j = 0; j < parts; j++) {
+                int end = (j + 1) * (n >> partition_order);
+                int k = br.Get(param_bits);
+                if (k == escape) {
+                    int raw_bits = br.Get(5);
+                    for (; i < end; i++)
+                        s[i] = br.GetSigned(raw_bits);
+                    continue;
+                }
+                for (; i < end; i++) {
+                    if (!br.GetRice(k, s[i]))
+                        return "truncated residual";
+                }
+            }
+            for (i = order; i < n; i++) {
+                int32_t pred = 0;
+                switch (order) {
+                case 1: pred = s[i - 1]; break;
+                case 2: pred = 2 * s[i - 1] - s[i - 2]; break;
+                case 3: pred = 3 * s[i - 1] - 3 * s[i - 2] + s[i - 3]; break;
+                case 4: pred = 4 * s[i - 1] - 6 * s[i - 2] + 4 * s[i - 3] - s[i - 4]; break;
+                default: break;
+                }
+                s[i] += pred;
+            }
+            for (i = 0; i < n; i++) {
+                if (s[i] < -32768 || s[i] > 32767)
+                    return "decoded sample out of 16-bit range";
+                x[i] = static_cast<int16_t>(s[i]);
+            }
+        } else {
+            return "unsupported subframe type " + std::to_string(type);
+        }
+
+        br.Align();
+        size_t body_bytes = br.BytePos();
+        if (!br.Ok(16) || br.Get(16) != crc_bits(frame, body_bytes, 16, 0x8005))
+            return "frame crc16 mismatch";
+        uint32_t frame_bytes = static_cast<uint32_t>(body_bytes + 2);
+        min_frame = min_frame == 0 ? frame_bytes : std::min(min_frame, frame_bytes);
+        max_frame = std::max(max_frame, frame_bytes);
+        // 固定块大小，只有最后一帧可以更短
+        if (n > info.max_block || (n != info.max_block && offset + frame_bytes != data.size()))
+            return "unexpected block size " + std::to_string(n);
+        offset += frame_bytes;
+        expected_frame++;
+    }
+    if (pcm.size() != info.total_samples)
+        return "total samples in STREAMINFO differ from decoded";
+    if (min_frame != info.min_frame || max_frame != info.max_frame)
+        return "frame size range in STREAMINFO differs from decoded";
+    return "";
+}
+
+// 解码并与16bit WAV的PCM逐采样比较，MD5也要一致
+static bool verify(const std::vector<uint8_t>& flac, const std::vector<int16_t>& expected, int sample_rate,
+                   std::string& error) {
+    StreamInfo info;
+    std::vector<int16_t> decoded;
+    error = flac_decode(flac, info, decoded);
+    if (!error.empty())
+        return false;
+    if (info.sample_rate != sample_rate) {
+        error = "sample rate mismatch";
+        return false;
+    }
+    if (decoded != expected) {
+        error = "decoded pcm differs from pcm16 wav";
+        return false;
+    }
+    Md5 md5;
+    md5.Update(decoded.data(), decoded.size() * sizeof(int16_t));
+    uint8_t digest[16];
+    md5.Final(digest);
+    if (memcmp(digest, info.md5, sizeof(digest)) != 0) {
+        error = "md5 mismatch";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("input", 'i', "comma separated wav files as the corpus, mono or the first channel", false, "../demo.wav");
+    cmd.add<std::string>("threads", 0, "comma separated encoder thread counts", false, "1,2,4");
+    cmd.add<std::string>("block_sizes", 0, "comma separated flac block sizes", false, "1152,2304,4096,4608");
+    cmd.add<int>("iterations", 'n', "passes per configuration, the fastest is reported", false, 3);
+    cmd.add<float>("seconds", 0, "length of the synthetic audio used when no input can be read", false, 30.0f);
+    cmd.add<std::string>("output", 'o', "also write the corpus as flac with the first configuration, for other decoders", false, "");
+    cmd.parse_check(argc, argv);
+
+    auto thread_counts = parse_ints(cmd.get<std::string>("threads"));
+    auto block_sizes   = parse_ints(cmd.get<std::string>("block_sizes"));
+    auto iterations    = std::max(1, cmd.get<int>("iterations"));
+    auto output_file   = cmd.get<std::string>("output");
+    if (thread_counts.empty() || block_sizes.empty()) {
+        printf("No thread count or block size given\n");
+        return -1;
+    }
+
+    std::vector<Clip> corpus;
+    for (auto& path : split(cmd.get<std::string>("input"))) {
+        AudioFile<float> file;
+        if (!file.load(path) || file.getNumChannels() < 1 || file.getNumSamplesPerChannel() == 0) {
+            printf("Load %s failed, skipped\n", path.c_str());
+            continue;
+        }
+        Clip clip;
+        clip.name = path;
+        clip.sample_rate = static_cast<int>(file.getSampleRate());
+        clip.audio = file.samples[0];
+        corpus.push_back(clip);
+    }
+    if (corpus.empty())
+        corpus.push_back(make_synthetic(cmd.get<float>("seconds")));
+
+    double corpus_seconds = 0;
+    size_t pcm_bytes = 0, wav_bytes = 0;
+    std::vector<std::vector<int16_t>> expected(corpus.size());
+    for (size_t c = 0; c < corpus.size(); c++) {
+        const Clip& clip = corpus[c];
+        expected[c].resize(clip.audio.size());
+        float_to_int16(clip.audio.data(), expected[c].data(), clip.audio.size());
+        corpus_seconds += static_cast<double>(clip.audio.size()) / clip.sample_rate;
+        pcm_bytes += clip.audio.size() * sizeof(int16_t);
+        wav_bytes += WAV_HEADER_SIZE + clip.audio.size() * sizeof(int16_t);
+        printf("%s: %d Hz, %.2f s\n", clip.name.c_str(), clip.sample_rate,
+               static_cast<double>(clip.audio.size()) / clip.sample_rate);
+    }
+    printf("%zu clip(s), %.2f s, %.2f MB as pcm16 wav, streamed in slices of %zu samples\n", corpus.size(),
+           corpus_seconds, wav_bytes / (1024.0 * 1024.0), SLICE_SAMPLES);
+
+    printf("\n%8s %7s %12s %10s %10s %10s %12s %8s\n", "threads", "block", "flac bytes", "ratio", "bits/smp",
+           "MB/s", "x realtime", "check");
+    int failures = 0;
+    bool written = output_file.empty();
+    for (int threads : thread_counts) {
+        for (int block_size : block_sizes) {
+            FlacEncoder encoder(threads, block_size);
+            std::vector<std::vector<uint8_t>> files(corpus.size());
+            double best_ms = 1e30;
+            bool ok = true;
+            for (int i = 0; i < iterations && ok; i++) {
+                double total_ms = 0;
+                for (size_t c = 0; c < corpus.size(); c++) {
+                    const Clip& clip = corpus[c];
+                    std::vector<uint8_t>& file = files[c];
+                    file.clear();
+                    file.reserve(clip.audio.size());
+                    double start = now_ms();
+                    ok = 0 == encoder.Begin(clip.sample_rate, [&file](const uint8_t* data, size_t bytes) {
+                        file.insert(file.end(), data, data + bytes);
+                        return 0;
+                    });
+                    for (size_t offset = 0; ok && offset < clip.audio.size(); offset += SLICE_SAMPLES)
+                        ok = 0 == encoder.Encode(clip.audio.data() + offset,
+                                                 std::min(SLICE_SAMPLES, clip.audio.size() - offset));
+                    ok = ok && 0 == encoder.Finish();
+                    // 与FlacFileSink一样在最后回填文件头
+                    if (ok)
+                        encoder.GetHeader(file.data());
+                    total_ms += now_ms() - start;
+                    if (!ok)
+                        break;
+                }
+                best_ms = std::min(best_ms, total_ms);
+            }
+
+            size_t flac_bytes = 0;
+            std::string error = ok ? "" : "encode failed";
+            for (size_t c = 0; ok && c < corpus.size(); c++) {
+                flac_bytes += files[c].size();
+                ok = verify(files[c], expected[c], corpus[c].sample_rate, error);
+            }
+            if (!ok)
+                failures++;
+            if (ok && !written && corpus.size() == 1) {
+                FILE* fp = fopen(output_file.c_str(), "wb");
+                written = fp && fwrite(files[0].data(), 1, files[0].size(), fp) == files[0].size();
+                if (fp)
+                    fclose(fp);
+                if (!written) {
+                    printf("Write %s failed!\n", output_file.c_str());
+                    written = true;
+                }
+            }
+
+            size_t num_samples = pcm_bytes / sizeof(int16_t);
+            printf("%8d %7d %12zu %10.3f %10.2f %10.1f %12.1f %8s%s%s\n", threads, block_size, flac_bytes,
+                   flac_bytes ? static_cast<double>(wav_bytes) / flac_bytes : 0,
+                   num_samples ? flac_bytes * 8.0 / num_samples : 0, pcm_bytes / (1024.0 * 1024.0) / (best_ms / 1000.0),
+                   corpus_seconds * 1000.0 / best_ms, ok ? "ok" : "FAILED", ok ? "" : ": ", error.c_str());
+        }
+    }
+    printf("\nratio: pcm16 wav size / flac size, MB/s: pcm16 bytes encoded per second (fastest of %d),\n"
+           "check: decoded with a reference decoder (crc, STREAMINFO, md5) and compared with the pcm16 wav samples\n",
+           iterations);
+    if (!output_file.empty() && corpus.size() > 1)
+        printf("--output needs a single input clip, not written\n");
+    if (failures > 0) {
+        printf("%d configuration(s) failed to round-trip\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,318 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// 文本前端微基准：只需要lexicon和tokens，不需要NPU和模型。
+// 对真实语料和合成文本，在几种文本长度下分别测每个CPU阶段的ns/字符和每次调用的堆分配次数：
+//   split_sentence, Lexicon::convert, intersperse, calc_word2pronoun, generate_slices,
+//   以及trie之前convert里的splitEachChar/merge_english(bench/LegacyLexicon.hpp，作为对照)。
+// 最后对整个语料比较按词重叠和按帧重叠(--overlaps)切片时每个输出帧要decode的帧数
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <numeric>
+#include <memory>
+
+#include "cmdline.hpp"
+#include "Lexicon.hpp"
+#include "split_utils.hpp"
+#include "tts_utils.hpp"
+#include "bench/LegacyLexicon.hpp"
+#include "bench/AllocCounter.hpp"
+
+// 防止被测函数的结果被优化掉
+static volatile size_t g_sink;
+
+static std::vector<int> parse_list(const std::string& s) {
+    std::vector<int> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        values.push_back(std::stoi(item));
+    return values;
+}
+
+static std::vector<std::string> split_chars(const std::string& text) {
+    std::vector<std::string> chars;
+    for (size_t i = 0; i < text.size(); ) {
+        size_t len = std::min(utf8_char_len(static_cast<unsigned char>(text[i])), text.size() - i);
+        chars.push_back(text.substr(i, len));
+        i += len;
+    }
+    return chars;
+}
+
+// 循环拼接语料里的字符，直到正好length个字符
+static std::string make_real_text(const std::vector<std::string>& chars, size_t length) {
+    std::string text;
+    for (size_t i = 0; i < length; i++)
+        text += chars[i % chars.size()];
+    return text;
+}
+
+// 语料里的非ASCII字符、英文单词、数字和标点随机混合，固定种子，每次运行结果一样
+static std::string make_synthetic_text(const std::vector<std::string>& chars, size_t length, uint32_t seed) {
+    static const char* const words[] = {"hello", "NPU", "speech", "Edge", "AI", "melo", "tts", "OK"};
+    static const char* const puncts[] = {"，", "。", "！", "？", ",", ".", " ", "、"};
+    std::vector<std::string> cjk;
+    for (auto& c : chars) {
+        if (c.size() > 1)
+            cjk.push_back(c);
+    }
+    if (cjk.empty())
+        cjk.push_back("的");
+
+    std::mt19937 rng(seed);
+    std::string text;
+    size_t n = 0;
+    while (n < length) {
+        uint32_t r = rng() % 100;
+        std::string piece;
+        if (r < 70)
+            piece = cjk[rng() % cjk.size()];
+        else if (r < 82)
+            piece = words[rng() % 8];
+        else if (r < 88)
+            piece = std::to_string(rng() % 1000);
+        else
+            piece = puncts[rng() % 8];
+        size_t piece_chars = utf8_strlen(piece);
+        if (n + piece_chars > length)
+            piece = piece.substr(0, length - n);
+        text += piece;
+        n += utf8_strlen(piece);
+    }
+    return text;
+}
+
+struct CaseResult {
+    size_t calls;
+    double ns_per_char;
+    double allocs_per_call;
+};
+
+// 按MeloTTS里的方式准备切片的输入，encoder输出的每个phone的帧数用固定种子的1~8帧代替
+struct SliceInput {
+    std::vector<int> phones;
+    std::vector<int> word2ph;
+    std::vector<int> pronoun_lens;
+    std::vector<int> word2pronoun;
+};
+
+static SliceInput make_slice_input(const Lexicon& lexicon, const std::string& text, uint32_t seed) {
+    SliceInput in;
+    std::vector<int> tones;
+    lexicon.convert(text, in.phones, tones, in.word2ph);
+    for (int& w : in.word2ph)
+        w *= 2;
+    if (!in.word2ph.empty())
+        in.word2ph[0] += 1;
+    std::mt19937 rng(seed);
+    in.pronoun_lens.resize(in.phones.size() * 2 + 1);
+    for (int& p : in.pronoun_lens)
+        p = 1 + rng() % 8;
+    in.word2pronoun = calc_word2pronoun(in.word2ph, in.pronoun_lens);
+    return in;
+}
+
+// 先跑一次预热，之后重复到处理了至少target_chars个字符
+static CaseResult run_case(const std::function<void()>& fn, size_t chars, size_t target_chars) {
+    fn();
+    size_t calls = std::max<size_t>(1, target_chars / std::max<size_t>(1, chars));
+    size_t allocs_before = alloc_count();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < calls; i++)
+        fn();
+    auto end = std::chrono::steady_clock::now();
+    size_t allocs = alloc_count() - allocs_before;
+
+    CaseResult r;
+    r.calls = calls;
+    r.ns_per_char = std::chrono::duration<double, std::nano>(end - start).count() / calls / std::max<size_t>(1, chars);
+    r.allocs_per_call = static_cast<double>(allocs) / calls;
+    return r;
+}
+
+static void bench_text(const char* corpus, const std::string& text, const std::string& language,
+                       const Lexicon& lexicon, LegacyLexicon* legacy, int dec_len, size_t target_chars) {
+    size_t chars = utf8_strlen(text);
+
+    // 后面几个阶段的输入按MeloTTS里的方式准备好
+    SliceInput in = make_slice_input(lexicon, text, chars);
+    const std::vector<int>& phones = in.phones;
+    const std::vector<int>& word2ph = in.word2ph;
+    const std::vector<int>& pronoun_lens = in.pronoun_lens;
+    const std::vector<int>& word2pronoun = in.word2pronoun;
+    std::vector<std::string> splitted = split_chars(text);
+    int total_frames = std::accumulate(word2pronoun.begin(), word2pronoun.end(), 0);
+    std::vector<SliceBucket> frame_buckets{SliceBucket(dec_len, 1.0)};
+
+    SplitResult sens;
+    std::vector<int> out_phones, out_tones, out_word2ph;
+
+    struct Case {
+        const char* name;
+        std::function<void()> fn;
+    };
+    std::vector<Case> cases = {
+        {"split_sentence", [&]() {
+            split_sentence(text, sens, 10, language);
+            g_sink = sens.size();
+        }},
+        {"Lexicon::convert", [&]() {
+            out_phones.clear();
+            out_tones.clear();
+            out_word2ph.clear();
+            lexicon.convert(text, out_phones, out_tones, out_word2ph);
+            g_sink = out_phones.size();
+        }},
+        {"intersperse", [&]() {
+            g_sink = intersperse(phones, 0).size();
+        }},
+        {"calc_word2pronoun", [&]() {
+            g_sink = calc_word2pronoun(word2ph, pronoun_lens).size();
+        }},
+        {"generate_slices", [&]() {
+            g_sink = generate_slices(word2pronoun, dec_len).first.size();
+        }},
+        {"plan_slices_optimal", [&]() {
+            g_sink = plan_slices_optimal(word2pronoun, dec_len).first.size();
+        }},
+        {"plan_frame_slices", [&]() {
+            g_sink = plan_frame_slices_optimal(total_frames, frame_buckets, 4).size();
+        }},
+    };
+    if (legacy) {
+        cases.push_back({"legacy splitEachChar", [&]() {
+            g_sink = legacy->splitEachChar(text).size();
+        }});
+        cases.push_back({"legacy merge_english", [&]() {
+            g_sink = legacy->merge_english(splitted).size();
+        }});
+    }
+
+    for (auto& c : cases) {
+        CaseResult r = run_case(c.fn, chars, target_chars);
+        printf("%-10s %7zu %-22s %9zu %10.2f %12.2f\n", corpus, chars, c.name, r.calls, r.ns_per_char, r.allocs_per_call);
+    }
+}
+
+// 语料每行按句切分后，比较各种切片方式平均每句的decoder调用数和每个输出帧要decode的帧数
+static void report_slicing(const std::string& corpus, const std::string& language, const Lexicon& lexicon,
+                           int dec_len, const std::vector<int>& overlaps) {
+    std::vector<std::vector<int>> sentences;
+    std::stringstream lines(corpus);
+    std::string line;
+    while (std::getline(lines, line)) {
+        SplitResult sens;
+        split_sentence(line, sens, 10, language);
+        for (size_t n = 0; n < sens.size(); n++) {
+            std::vector<int> word2pronoun = make_slice_input(lexicon, sens.sentence(n), sentences.size()).word2pronoun;
+            if (!word2pronoun.empty())
+                sentences.push_back(word2pronoun);
+        }
+    }
+    if (sentences.empty())
+        return;
+
+    struct Setting {
+        std::string name;
+        std::function<size_t(const std::vector<int>&)> slices;
+    };
+    std::vector<Setting> settings = {
+        {"2 words greedy", [&](const std::vector<int>& w) { return generate_slices(w, dec_len).first.size(); }},
+        {"2 words optimal", [&](const std::vector<int>& w) { return plan_slices_optimal(w, dec_len).first.size(); }},
+    };
+    for (int overlap : overlaps) {
+        if (overlap <= 0 || 2 * overlap >= dec_len)
+            continue;
+        auto total = [](const std::vector<int>& w) { return std::accumulate(w.begin(), w.end(), 0); };
+        std::vector<SliceBucket> buckets{SliceBucket(dec_len, 1.0)};
+        settings.push_back({std::to_string(overlap) + " frames greedy", [=](const std::vector<int>& w) {
+            return generate_frame_slices(total(w), dec_len, overlap).size();
+        }});
+        settings.push_back({std::to_string(overlap) + " frames optimal", [=](const std::vector<int>& w) {
+            return plan_frame_slices_optimal(total(w), buckets, overlap).size();
+        }});
+    }
+
+    printf("\nSlicing %zu sentences, dec_len %d\n", sentences.size(), dec_len);
+    printf("%-22s %14s %18s\n", "overlap", "slices/sent", "decoded/output");
+    for (auto& setting : settings) {
+        size_t slices = 0, frames = 0;
+        for (auto& w : sentences) {
+            slices += setting.slices(w);
+            frames += std::accumulate(w.begin(), w.end(), 0);
+        }
+        printf("%-22s %14.3f %18.3f\n", setting.name.c_str(), static_cast<double>(slices) / sentences.size(),
+               frames ? static_cast<double>(slices) * dec_len / frames : 0);
+    }
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("lexicon", 'l', "lexicon.txt or image from melotts_lexc", false, "../models/lexicon.txt");
+    cmd.add<std::string>("token", 't', "tokens.txt", false, "../models/tokens.txt");
+    cmd.add<std::string>("file", 'f', "real corpus", false, "../model_convert/test_text_zh.txt");
+    cmd.add<std::string>("language", 0, "language for split_sentence, choose from ZH, EN, JP", false, "ZH");
+    cmd.add<std::string>("lengths", 0, "text lengths in characters, comma separated", false, "16,64,256,1024");
+    cmd.add<int>("dec_len", 0, "decoder slice length for generate_slices", false, 128);
+    cmd.add<int>("chars", 'n', "characters processed per case", false, 2000000);
+    cmd.add<std::string>("overlaps", 0, "frame overlaps compared in the slicing report, comma separated", false, "2,4,8,16");
+    cmd.parse_check(argc, argv);
+
+    auto lexicon_file = cmd.get<std::string>("lexicon");
+    auto token_file   = cmd.get<std::string>("token");
+    auto text_file    = cmd.get<std::string>("file");
+    auto language     = cmd.get<std::string>("language");
+    auto lengths      = parse_list(cmd.get<std::string>("lengths"));
+    auto dec_len      = cmd.get<int>("dec_len");
+    size_t target_chars = cmd.get<int>("chars");
+    auto overlaps     = parse_list(cmd.get<std::string>("overlaps"));
+
+    std::ifstream ifs(text_file);
+    if (!ifs.is_open()) {
+        printf("Open %s failed!\n", text_file.c_str());
+        return -1;
+    }
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    std::vector<std::string> chars = split_chars(ss.str());
+    chars.erase(std::remove(chars.begin(), chars.end(), "\n"), chars.end());
+    if (chars.empty()) {
+        printf("No text in %s!\n", text_file.c_str());
+        return -1;
+    }
+
+    Lexicon lexicon(lexicon_file, token_file);
+    if (!lexicon.IsLoaded()) {
+        printf("Load lexicon failed!\n");
+        return -1;
+    }
+    // 旧实现只用来测splitEachChar/merge_english，需要文本词典，传入镜像时跳过
+    std::unique_ptr<LegacyLexicon> legacy;
+    if (!Lexicon::IsImage(lexicon_file))
+        legacy.reset(new LegacyLexicon(lexicon_file, token_file));
+
+    printf("%-10s %7s %-22s %9s %10s %12s\n", "corpus", "chars", "function", "calls", "ns/char", "allocs/call");
+    for (int length : lengths) {
+        if (length <= 0)
+            continue;
+        bench_text("real", make_real_text(chars, length), language, lexicon, legacy.get(), dec_len, target_chars);
+        bench_text("synthetic", make_synthetic_text(chars, length, length), language, lexicon, legacy.get(), dec_len, target_chars);
+    }
+    report_slicing(ss.str(), language, lexicon, dec_len, overlaps);
+
+    return 0;
+}
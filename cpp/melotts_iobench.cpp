@@ -0,0 +1,119 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// decoder输入输出buffer的微基准：对比普通CMM和cached CMM下
+// 打包z_p切片、NPU运行(含cache维护)、读回音频的耗时
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "cmdline.hpp"
+#include "MeloTTS.hpp"
+#include "EngineWrapper.hpp"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+struct IOBenchResult {
+    double copy_ms = 0;
+    double run_ms = 0;
+    double readback_ms = 0;
+};
+
+static int run_bench(const std::string& decoder_file, bool cached_io, int channels, int iterations, IOBenchResult& result) {
+    EngineWrapper decoder(cached_io);
+    if (0 != decoder.Init(decoder_file.c_str())) {
+        printf("Init decoder model failed!\n");
+        return -1;
+    }
+
+    int zp_size = decoder.GetInputSize(0) / sizeof(float);
+    int dec_len = zp_size / channels;
+    int audio_len = decoder.GetOutputSize(0) / sizeof(float);
+    // 模拟encoder输出的z_p，长度为3个dec_len，每次取其中一段
+    int zp_len = dec_len * 3;
+    std::vector<float> zp(channels * zp_len);
+    for (size_t i = 0; i < zp.size(); i++)
+        zp[i] = (i % 97) / 97.0f;
+    std::vector<float> g(decoder.GetInputSize(1) / sizeof(float), 0.1f);
+    std::vector<float> audio(audio_len);
+
+    decoder.SetInput(g.data(), 1);
+
+    for (int it = 0; it < iterations; it++) {
+        int start_col = (it * dec_len / 2) % (zp_len - dec_len);
+        int actual_size = dec_len - (it % 4) * dec_len / 8;
+
+        double start = get_current_time();
+        float* zp_dst = static_cast<float*>(decoder.GetInputPtr(0));
+        for (int n = 0; n < channels; n++) {
+            memcpy(zp_dst + n * dec_len, zp.data() + n * zp_len + start_col, sizeof(float) * actual_size);
+            memset(zp_dst + n * dec_len + actual_size, 0, sizeof(float) * (dec_len - actual_size));
+        }
+        double copied = get_current_time();
+
+        if (0 != decoder.RunSync()) {
+            printf("Run decoder model failed!\n");
+            return -1;
+        }
+        double ran = get_current_time();
+
+        const float* audio_src = static_cast<const float*>(decoder.GetOutputPtr(0));
+        memcpy(audio.data(), audio_src, sizeof(float) * audio_len);
+        double end = get_current_time();
+
+        // 第一次包含冷启动，不计入
+        if (it == 0)
+            continue;
+        result.copy_ms += copied - start;
+        result.run_ms += ran - copied;
+        result.readback_ms += end - ran;
+    }
+
+    int n = std::max(1, iterations - 1);
+    result.copy_ms /= n;
+    result.run_ms /= n;
+    result.readback_ms /= n;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("decoder", 'd', "decoder axmodel", false, "../models/decoder-zh.axmodel");
+    cmd.add<int>("channels", 'c', "z_p channels", false, 192);
+    cmd.add<int>("iterations", 'n', "iterations per mode", false, 100);
+    cmd.parse_check(argc, argv);
+
+    auto decoder_file = cmd.get<std::string>("decoder");
+    auto channels     = cmd.get<int>("channels");
+    auto iterations   = cmd.get<int>("iterations");
+
+    if (0 != MeloTTS::InitSystem())
+        return -1;
+
+    IOBenchResult uncached, cached;
+    if (0 != run_bench(decoder_file, false, channels, iterations, uncached) ||
+        0 != run_bench(decoder_file, true, channels, iterations, cached)) {
+        return -1;
+    }
+
+    printf("\n%-10s %14s %14s %14s\n", "mode", "slice copy", "run+cache", "readback");
+    printf("%-10s %11.3f ms %11.3f ms %11.3f ms\n", "default", uncached.copy_ms, uncached.run_ms, uncached.readback_ms);
+    printf("%-10s %11.3f ms %11.3f ms %11.3f ms\n", "cached", cached.copy_ms, cached.run_ms, cached.readback_ms);
+
+    return 0;
+}
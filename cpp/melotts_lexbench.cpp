@@ -0,0 +1,219 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// Lexicon::convert的benchmark：trie实现与原来逐字查unordered_map的实现对比
+// 指定-i时另外对比文本词典和二进制镜像的加载耗时与常驻内存
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "cmdline.hpp"
+#include "Lexicon.hpp"
+#include "bench/LegacyLexicon.hpp"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static size_t count_chars(const std::string& s) {
+    size_t n = 0;
+    for (unsigned char c : s) {
+        if ((c & 0xC0) != 0x80)
+            n++;
+    }
+    return n;
+}
+
+// 当前进程的常驻内存，单位KB：anon为私有的堆内存，file为文件映射(镜像的页可在进程间共享)
+struct RssInfo {
+    long anon_kb = 0;
+    long file_kb = 0;
+};
+
+static RssInfo get_rss() {
+    RssInfo rss;
+    std::ifstream ifs("/proc/self/status");
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (line.compare(0, 8, "RssAnon:") == 0)
+            rss.anon_kb = std::stol(line.substr(8));
+        else if (line.compare(0, 8, "RssFile:") == 0)
+            rss.file_kb = std::stol(line.substr(8));
+    }
+    return rss;
+}
+
+struct LoadResult {
+    double load_ms;
+    // 加载后、以及把整个文本转换一遍后RSS的增量
+    RssInfo load_rss;
+    RssInfo touched_rss;
+};
+
+// 在子进程里加载，互不影响各自的RSS
+static int measure_load(const std::string& lexicon_file, const std::string& token_file,
+                        const std::vector<std::string>& lines, LoadResult& result) {
+    int fds[2];
+    if (0 != pipe(fds))
+        return -1;
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        close(fds[0]);
+        LoadResult r;
+        auto delta = [](const RssInfo& base) {
+            RssInfo now = get_rss();
+            now.anon_kb -= base.anon_kb;
+            now.file_kb -= base.file_kb;
+            return now;
+        };
+        // 转换用的vector提前分配好，不计入增量
+        std::vector<int> phones, tones, word2ph;
+        phones.reserve(1 << 20);
+        tones.reserve(1 << 20);
+        word2ph.reserve(1 << 20);
+        RssInfo base = get_rss();
+        double start = get_current_time();
+        Lexicon lexicon(lexicon_file, token_file);
+        r.load_ms = get_current_time() - start;
+        r.load_rss = delta(base);
+        for (auto& l : lines) {
+            phones.clear();
+            tones.clear();
+            word2ph.clear();
+            lexicon.convert(l, phones, tones, word2ph);
+        }
+        r.touched_rss = delta(base);
+        ssize_t n = lexicon.IsLoaded() ? write(fds[1], &r, sizeof(r)) : 0;
+        _exit(n == sizeof(r) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t n = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return (n == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+template <typename LEXICON>
+static double bench_convert(LEXICON& lexicon, const std::vector<std::string>& lines, int repeat, size_t& phone_num) {
+    std::vector<int> phones, tones, word2ph;
+    phone_num = 0;
+    double start = get_current_time();
+    for (int r = 0; r < repeat; r++) {
+        for (auto& line : lines) {
+            phones.clear();
+            tones.clear();
+            word2ph.clear();
+            lexicon.convert(line, phones, tones, word2ph);
+            phone_num += phones.size();
+        }
+    }
+    return get_current_time() - start;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("lexicon", 'l', "lexicon.txt", false, "../models/lexicon.txt");
+    cmd.add<std::string>("token", 't', "tokens.txt", false, "../models/tokens.txt");
+    cmd.add<std::string>("file", 'f', "text file, one sentence per line", false, "../model_convert/test_text_zh.txt");
+    cmd.add<int>("repeat", 'n', "times to convert the whole file", false, 2000);
+    cmd.add<std::string>("image", 'i', "lexicon image from melotts_lexc, compare load time and RSS", false, "");
+    cmd.parse_check(argc, argv);
+
+    auto lexicon_file = cmd.get<std::string>("lexicon");
+    auto token_file   = cmd.get<std::string>("token");
+    auto text_file    = cmd.get<std::string>("file");
+    auto repeat       = cmd.get<int>("repeat");
+    auto image_file   = cmd.get<std::string>("image");
+
+    std::vector<std::string> lines;
+    std::ifstream ifs(text_file);
+    if (!ifs.is_open()) {
+        printf("Open %s failed!\n", text_file.c_str());
+        return -1;
+    }
+    std::string line;
+    size_t chars = 0;
+    while (std::getline(ifs, line)) {
+        if (line.empty())
+            continue;
+        chars += count_chars(line);
+        lines.push_back(line);
+    }
+
+    double start = get_current_time();
+    LegacyLexicon legacy(lexicon_file, token_file);
+    double legacy_load_ms = get_current_time() - start;
+
+    start = get_current_time();
+    Lexicon lexicon(lexicon_file, token_file);
+    double load_ms = get_current_time() - start;
+
+    // 词典里没有多字词条时两者结果应完全一致，有词组时trie会按最长匹配合并
+    size_t diff = 0;
+    for (auto& l : lines) {
+        std::vector<int> p0, t0, w0, p1, t1, w1;
+        legacy.convert(l, p0, t0, w0);
+        lexicon.convert(l, p1, t1, w1);
+        if (p0 != p1 || t0 != t1 || w0 != w1)
+            diff++;
+    }
+
+    size_t legacy_phones, phones;
+    double legacy_ms = bench_convert(legacy, lines, repeat, legacy_phones);
+    double ms = bench_convert(lexicon, lines, repeat, phones);
+    double total_chars = static_cast<double>(chars) * repeat;
+
+    printf("lexicon entries: %zu, text: %zu lines %zu chars x %d\n", lexicon.EntryCount(), lines.size(), chars, repeat);
+    printf("lines with different output: %zu\n", diff);
+    printf("%-8s load %9.2f ms  convert %9.2f ms  %8.2f Mchars/s  %zu phones\n",
+           "legacy", legacy_load_ms, legacy_ms, total_chars / legacy_ms / 1000.0, legacy_phones);
+    printf("%-8s load %9.2f ms  convert %9.2f ms  %8.2f Mchars/s  %zu phones\n",
+           "trie", load_ms, ms, total_chars / ms / 1000.0, phones);
+    printf("speedup: %.2fx\n", legacy_ms / ms);
+
+    if (!image_file.empty()) {
+        Lexicon image(image_file, "");
+        if (!image.IsLoaded()) {
+            printf("Load %s failed!\n", image_file.c_str());
+            return -1;
+        }
+        size_t image_phones;
+        double image_ms = bench_convert(image, lines, repeat, image_phones);
+        printf("%-8s               convert %9.2f ms  %8.2f Mchars/s  %zu phones\n",
+               "mmap", image_ms, total_chars / image_ms / 1000.0, image_phones);
+
+        LoadResult text_load, image_load;
+        if (0 != measure_load(lexicon_file, token_file, lines, text_load) ||
+            0 != measure_load(image_file, "", lines, image_load)) {
+            printf("measure load failed!\n");
+            return -1;
+        }
+        printf("\nRSS increase, anon(private) / file(shared):\n");
+        printf("%-8s %12s %22s %22s\n", "loader", "load", "after load", "after convert");
+        auto print_load = [](const char* name, const LoadResult& r) {
+            printf("%-8s %9.3f ms %8ld / %8ld KB %8ld / %8ld KB\n", name, r.load_ms,
+                   r.load_rss.anon_kb, r.load_rss.file_kb, r.touched_rss.anon_kb, r.touched_rss.file_kb);
+        };
+        print_load("text", text_load);
+        print_load("mmap", image_load);
+    }
+
+    return 0;
+}
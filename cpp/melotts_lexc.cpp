@@ -0,0 +1,85 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// 把lexicon.txt和tokens.txt编译成二进制词典镜像，运行时Lexicon直接mmap，不再解析文本
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sys/time.h>
+
+#include "cmdline.hpp"
+#include "Lexicon.hpp"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("lexicon", 'l', "lexicon.txt", false, "../models/lexicon.txt");
+    cmd.add<std::string>("token", 't', "tokens.txt", false, "../models/tokens.txt");
+    cmd.add<std::string>("output", 'o', "output lexicon image", false, "../models/lexicon.bin");
+    cmd.parse_check(argc, argv);
+
+    auto lexicon_file = cmd.get<std::string>("lexicon");
+    auto token_file   = cmd.get<std::string>("token");
+    auto output_file  = cmd.get<std::string>("output");
+
+    double start = get_current_time();
+    Lexicon lexicon(lexicon_file, token_file);
+    if (!lexicon.IsLoaded()) {
+        printf("Load lexicon failed!\n");
+        return -1;
+    }
+    double load_ms = get_current_time() - start;
+
+    if (0 != lexicon.Save(output_file)) {
+        printf("Save lexicon image failed!\n");
+        return -1;
+    }
+
+    start = get_current_time();
+    Lexicon image(output_file, "");
+    if (!image.IsLoaded()) {
+        printf("Load lexicon image failed!\n");
+        return -1;
+    }
+    double map_ms = get_current_time() - start;
+
+    // 逐个词条比较文本加载和镜像加载的结果
+    std::ifstream ifs(lexicon_file);
+    std::string line;
+    size_t words = 0, diff = 0;
+    while (std::getline(ifs, line)) {
+        std::string word = line.substr(0, line.find(' '));
+        std::vector<int> p0, t0, w0, p1, t1, w1;
+        lexicon.convert(word, p0, t0, w0);
+        image.convert(word, p1, t1, w1);
+        if (p0 != p1 || t0 != t1 || w0 != w1) {
+            if (diff < 10)
+                printf("mismatch: %s\n", word.c_str());
+            diff++;
+        }
+        words++;
+    }
+    if (diff > 0) {
+        printf("%zu of %zu words mismatch!\n", diff, words);
+        return -1;
+    }
+
+    printf("entries: %zu, verified %zu words\n", lexicon.EntryCount(), words);
+    printf("text load: %.2f ms, image load: %.3f ms\n", load_ms, map_ms);
+    printf("saved to %s\n", output_file.c_str());
+    return 0;
+}
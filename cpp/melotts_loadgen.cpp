@@ -0,0 +1,322 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// melotts_server的压测客户端：多个keep-alive连接并发发送/tts请求，统计吞吐和延迟分位数
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <sys/time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "cmdline.hpp"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static std::string url_encode(const std::string& s) {
+    static const char* hex = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : s) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += c;
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 0xF];
+        }
+    }
+    return out;
+}
+
+struct Target {
+    std::string host;
+    int port;
+    std::string unix_path;
+};
+
+static int connect_target(const Target& target) {
+    int fd;
+    if (!target.unix_path.empty()) {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, target.unix_path.c_str(), sizeof(addr.sun_path) - 1);
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(target.port);
+        inet_pton(AF_INET, target.host.c_str(), &addr.sin_addr);
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    }
+    return fd;
+}
+
+struct RequestResult {
+    bool ok;
+    double latency_ms;
+    double first_byte_ms;
+    size_t body_bytes;
+};
+
+// 发一个请求并读完响应，支持Content-Length和chunked两种响应
+static RequestResult do_request(int fd, const std::string& request, bool& keep_alive) {
+    RequestResult result{false, 0, 0, 0};
+    double start = get_current_time();
+    keep_alive = false;
+
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return result;
+        sent += n;
+    }
+
+    std::string buffer;
+    char tmp[64 * 1024];
+    auto fill = [&]() -> bool {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0)
+            return false;
+        if (result.first_byte_ms == 0)
+            result.first_byte_ms = get_current_time() - start;
+        buffer.append(tmp, n);
+        return true;
+    };
+
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (!fill())
+            return result;
+    }
+    std::string header = buffer.substr(0, header_end);
+    buffer.erase(0, header_end + 4);
+    std::string lower = header;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+        [](unsigned char c){ return std::tolower(c); });
+    int status = atoi(header.c_str() + header.find(' ') + 1);
+    keep_alive = lower.find("connection: close") == std::string::npos;
+
+    if (lower.find("transfer-encoding: chunked") != std::string::npos) {
+        while (true) {
+            size_t eol;
+            while ((eol = buffer.find("\r\n")) == std::string::npos) {
+                if (!fill())
+                    return result;
+            }
+            size_t chunk = strtoul(buffer.c_str(), nullptr, 16);
+            while (buffer.size() < eol + 2 + chunk + 2) {
+                if (!fill())
+                    return result;
+            }
+            buffer.erase(0, eol + 2 + chunk + 2);
+            result.body_bytes += chunk;
+            if (chunk == 0)
+                break;
+        }
+    } else {
+        size_t pos = lower.find("content-length:");
+        size_t length = pos == std::string::npos ? 0 : strtoul(lower.c_str() + pos + 15, nullptr, 10);
+        while (buffer.size() < length) {
+            if (!fill())
+                return result;
+        }
+        result.body_bytes = length;
+    }
+
+    result.latency_ms = get_current_time() - start;
+    result.ok = status == 200;
+    return result;
+}
+
+static double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+    return sorted[idx];
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("host", 0, "server address", false, "127.0.0.1");
+    cmd.add<int>("port", 'p', "server port", false, 8000);
+    cmd.add<std::string>("unix", 0, "connect to unix domain socket instead of tcp", false, "");
+    cmd.add<int>("concurrency", 'c', "concurrent connections", false, 4);
+    cmd.add<int>("requests", 'n', "total requests", false, 100);
+    cmd.add<int>("warmup", 0, "warmup requests per connection, not counted", false, 1);
+    cmd.add<std::string>("sentence", 's', "sentence to synthesize", false, "爱芯元智半导体股份有限公司，致力于打造世界领先的人工智能感知与边缘计算芯片。");
+    cmd.add<std::string>("file", 'f', "text file, one sentence per line, used round robin", false, "");
+    cmd.add<std::string>("format", 0, "response format, wav or pcm", false, "wav");
+    cmd.add<float>("speed", 0, "speak speed", false, 0.8f);
+    cmd.parse_check(argc, argv);
+
+    Target target;
+    target.host      = cmd.get<std::string>("host");
+    target.port      = cmd.get<int>("port");
+    target.unix_path = cmd.get<std::string>("unix");
+    auto concurrency = cmd.get<int>("concurrency");
+    auto total       = cmd.get<int>("requests");
+    auto warmup      = cmd.get<int>("warmup");
+    auto format      = cmd.get<std::string>("format");
+    auto speed       = cmd.get<float>("speed");
+
+    std::vector<std::string> sentences;
+    auto text_file = cmd.get<std::string>("file");
+    if (!text_file.empty()) {
+        std::ifstream ifs(text_file);
+        if (!ifs.is_open()) {
+            printf("Open %s failed!\n", text_file.c_str());
+            return -1;
+        }
+        std::string line;
+        while (std::getline(ifs, line)) {
+            if (!line.empty())
+                sentences.push_back(line);
+        }
+    } else {
+        sentences.push_back(cmd.get<std::string>("sentence"));
+    }
+    if (sentences.empty()) {
+        printf("No sentence to send\n");
+        return -1;
+    }
+
+    std::string host_header = target.unix_path.empty() ? target.host + ":" + std::to_string(target.port) : "localhost";
+    std::vector<std::string> requests;
+    for (auto& s : sentences) {
+        std::string body = "sentence=" + url_encode(s) + "&format=" + format + "&speed=" + std::to_string(speed);
+        std::string req = "POST /tts HTTP/1.1\r\n";
+        req += "Host: " + host_header + "\r\n";
+        req += "Content-Type: application/x-www-form-urlencoded\r\n";
+        req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        req += "\r\n";
+        req += body;
+        requests.push_back(req);
+    }
+
+    std::atomic<int> next_request(0);
+    std::mutex result_mutex;
+    std::condition_variable warmed_cv;
+    int warmed = 0;
+    double start = 0;
+    std::vector<RequestResult> results;
+    results.reserve(total);
+
+    auto worker = [&](int id) {
+        int fd = -1;
+        bool keep_alive = false;
+        auto run_one = [&](const std::string& req) -> RequestResult {
+            if (fd < 0 || !keep_alive) {
+                if (fd >= 0)
+                    close(fd);
+                fd = connect_target(target);
+                if (fd < 0)
+                    return RequestResult{false, 0, 0, 0};
+            }
+            auto r = do_request(fd, req, keep_alive);
+            if (!r.ok) {
+                close(fd);
+                fd = -1;
+            }
+            return r;
+        };
+
+        for (int i = 0; i < warmup; i++)
+            run_one(requests[(id + i) % requests.size()]);
+
+        // 所有连接都warmup完成后才开始计时
+        {
+            std::unique_lock<std::mutex> lock(result_mutex);
+            if (++warmed == concurrency) {
+                start = get_current_time();
+                warmed_cv.notify_all();
+            } else {
+                warmed_cv.wait(lock, [&]() { return warmed == concurrency; });
+            }
+        }
+
+        while (true) {
+            int n = next_request++;
+            if (n >= total)
+                break;
+            auto r = run_one(requests[n % requests.size()]);
+            std::lock_guard<std::mutex> lock(result_mutex);
+            results.push_back(r);
+        }
+        if (fd >= 0)
+            close(fd);
+    };
+
+    printf("Sending %d requests over %d connections to %s\n", total, concurrency,
+           target.unix_path.empty() ? host_header.c_str() : target.unix_path.c_str());
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < concurrency; i++)
+        threads.emplace_back(worker, i);
+    for (auto& t : threads)
+        t.join();
+    double wall_ms = get_current_time() - start;
+
+    std::vector<double> latency, first_byte;
+    size_t errors = 0, bytes = 0;
+    for (auto& r : results) {
+        if (!r.ok) {
+            errors++;
+            continue;
+        }
+        latency.push_back(r.latency_ms);
+        first_byte.push_back(r.first_byte_ms);
+        bytes += r.body_bytes;
+    }
+    std::sort(latency.begin(), latency.end());
+    std::sort(first_byte.begin(), first_byte.end());
+
+    printf("\nRequests: %zu ok, %zu failed, wall %.2f ms\n", latency.size(), errors, wall_ms);
+    printf("Throughput: %.2f requests/s, %.2f MB/s\n",
+           latency.size() * 1000.0 / wall_ms, bytes / 1024.0 / 1024.0 * 1000.0 / wall_ms);
+    printf("Latency(ms):     p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           percentile(latency, 50), percentile(latency, 90), percentile(latency, 99),
+           latency.empty() ? 0 : latency.back());
+    printf("First byte(ms):  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+           percentile(first_byte, 50), percentile(first_byte, 90), percentile(first_byte, 99),
+           first_byte.empty() ? 0 : first_byte.back());
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// 重采样微基准：不需要模型。对decoder输出的44.1kHz转到每个目标采样率
+//   吞吐：按decoder切片大小流式处理，每个输出采样的耗时和实时倍数
+//   频响：通带内正弦的增益(纹波)和残差，降采样时阻带正弦混叠到输出的电平
+//   正确性：与双精度直接插零-滤波-抽取的参考实现比较，以及分片流式与整段一次处理的输出一致
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+#include "cmdline.hpp"
+#include "Resampler.hpp"
+
+static const int IN_RATE = 44100;
+// decoder一片输出的采样数(dec_len 128 * 512)
+static const size_t SLICE_SAMPLES = 128 * 512;
+static const double TWO_PI = 6.283185307179586;
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<int> parse_rates(const std::string& s) {
+    std::vector<int> rates;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int rate = atoi(item.c_str());
+        if (rate > 0)
+            rates.push_back(rate);
+    }
+    return rates;
+}
+
+static std::vector<float> make_tone(double freq, size_t num) {
+    std::vector<float> audio(num);
+    for (size_t i = 0; i < num; i++)
+        audio[i] = static_cast<float>(0.5 * std::sin(TWO_PI * freq * i / IN_RATE));
+    return audio;
+}
+
+static std::vector<float> resample(int out_rate, const std::vector<float>& in, size_t chunk) {
+    Resampler resampler;
+    std::vector<float> out;
+    if (0 != resampler.Init(IN_RATE, out_rate))
+        return out;
+    for (size_t offset = 0; offset < in.size(); offset += chunk)
+        resampler.Process(in.data() + offset, std::min(chunk, in.size() - offset), out);
+    resampler.Flush(out);
+    return out;
+}
+
+struct ToneFit {
+    double amplitude;
+    double residual_rms;
+    double rms;
+};
+
+// 在输出中间一段按最小二乘拟合频率为freq的正弦，开头结尾各丢掉10%避开滤波器的过渡
+static ToneFit fit_tone(const std::vector<float>& y, double freq, int rate) {
+    size_t begin = y.size() / 10, end = y.size() - y.size() / 10;
+    double w = TWO_PI * freq / rate;
+    double cc = 0, ss = 0, cs = 0, yc = 0, ys = 0, yy = 0;
+    for (size_t i = begin; i < end; i++) {
+        double c = std::cos(w * i), s = std::sin(w * i);
+        cc += c * c;
+        ss += s * s;
+        cs += c * s;
+        yc += y[i] * c;
+        ys += y[i] * s;
+        yy += static_cast<double>(y[i]) * y[i];
+    }
+    double det = cc * ss - cs * cs;
+    double a = det != 0 ? (yc * ss - ys * cs) / det : 0;
+    double b = det != 0 ? (ys * cc - yc * cs) / det : 0;
+    double res = 0;
+    for (size_t i = begin; i < end; i++) {
+        double e = y[i] - a * std::cos(w * i) - b * std::sin(w * i);
+        res += e * e;
+    }
+    size_t n = end > begin ? end - begin : 1;
+    ToneFit fit = {std::sqrt(a * a + b * b), std::sqrt(res / n), std::sqrt(yy / n)};
+    return fit;
+}
+
+static double to_db(double ratio) {
+    return 20 * std::log10(std::max(ratio, 1e-12));
+}
+
+// 参考实现：把滤波器组还原成原型滤波器，在上采样后的时刻直接对插零序列做卷积，双精度累加
+static std::vector<double> reference(const Resampler::FilterBank& bank, const std::vector<float>& in) {
+    const int64_t len = static_cast<int64_t>(bank.up) * bank.taps;
+    std::vector<double> h(len);
+    for (int p = 0; p < bank.up; p++) {
+        for (int k = 0; k < bank.taps; k++)
+            h[p + k * bank.up] = bank.coeffs[p * bank.taps + (bank.taps - 1 - k)];
+    }
+    const int64_t num = static_cast<int64_t>(in.size());
+    const int64_t total = (num * bank.up + bank.down - 1) / bank.down;
+    std::vector<double> out(total);
+    for (int64_t m = 0; m < total; m++) {
+        int64_t t = m * bank.down + bank.delay;
+        double sum = 0;
+        for (int64_t i = t - len + 1; i <= t; i++) {
+            if (i < 0 || i % bank.up != 0 || i / bank.up >= num)
+                continue;
+            sum += h[t - i] * in[i / bank.up];
+        }
+        out[m] = sum;
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("rates", 0, "comma separated output sample rates", false, "8000,16000,22050,24000,48000");
+    cmd.add<float>("seconds", 0, "audio length in seconds for the throughput test", false, 60.0f);
+    cmd.add<int>("iterations", 'n', "passes per rate for the throughput test", false, 3);
+    cmd.parse_check(argc, argv);
+
+    auto rates      = parse_rates(cmd.get<std::string>("rates"));
+    auto seconds    = cmd.get<float>("seconds");
+    auto iterations = std::max(1, cmd.get<int>("iterations"));
+
+    // 语音频段的几个正弦加一点噪声
+    std::vector<float> audio(static_cast<size_t>(seconds * IN_RATE));
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> noise(-0.02f, 0.02f);
+    for (size_t i = 0; i < audio.size(); i++) {
+        double t = static_cast<double>(i) / IN_RATE;
+        audio[i] = static_cast<float>(0.4 * std::sin(TWO_PI * 180 * t) + 0.2 * std::sin(TWO_PI * 1250 * t) +
+                                      0.1 * std::sin(TWO_PI * 5300 * t)) + noise(rng);
+    }
+
+    printf("%.1f s of %d Hz audio, streamed in slices of %zu samples\n", seconds, IN_RATE, SLICE_SAMPLES);
+    printf("\n%8s %9s %6s %10s %12s %12s %10s %10s %12s %12s\n", "rate", "L/M", "taps", "design ms",
+           "ns/out", "x realtime", "ripple dB", "resid dB", "stopband dB", "ref err dB");
+    int failures = 0;
+    for (int rate : rates) {
+        double design_start = now_ms();
+        auto bank = Resampler::GetBank(IN_RATE, rate);
+        double design_ms = now_ms() - design_start;
+        if (!bank)
+            continue;
+
+        // 吞吐
+        double best_ms = 1e30;
+        size_t out_num = 0;
+        for (int i = 0; i < iterations; i++) {
+            double start = now_ms();
+            out_num = resample(rate, audio, SLICE_SAMPLES).size();
+            best_ms = std::min(best_ms, now_ms() - start);
+        }
+
+        // 通带：较低奈奎斯特频率的2%~91%，增益偏离0dB的最大值即纹波，残差包括镜像和舍入误差
+        const double nyquist = std::min(IN_RATE, rate) / 2.0;
+        const size_t tone_len = IN_RATE / 2;
+        double ripple = 0, residual = -300;
+        for (int k = 0; k <= 20; k++) {
+            double freq = nyquist * (0.02 + 0.89 * k / 20);
+            ToneFit fit = fit_tone(resample(rate, make_tone(freq, tone_len), SLICE_SAMPLES), freq, rate);
+            ripple = std::max(ripple, std::fabs(to_db(fit.amplitude / 0.5)));
+            residual = std::max(residual, to_db(fit.residual_rms / (0.5 / std::sqrt(2.0))));
+        }
+
+        // 阻带：降采样时输出奈奎斯特频率以上的正弦不应该混叠进输出
+        double stopband = 0;
+        if (rate < IN_RATE) {
+            stopband = -300;
+            for (int k = 0; k <= 20; k++) {
+                double freq = nyquist + (IN_RATE / 2.0 - nyquist) * k / 21;
+                ToneFit fit = fit_tone(resample(rate, make_tone(freq, tone_len), SLICE_SAMPLES), freq, rate);
+                stopband = std::max(stopband, to_db(fit.rms / (0.5 / std::sqrt(2.0))));
+            }
+        }
+
+        // 与参考实现比较，输入用随机长度分片流式处理
+        std::vector<float> ref_in(audio.begin(), audio.begin() + std::min<size_t>(audio.size(), 4410));
+        std::vector<double> ref = reference(*bank, ref_in);
+        Resampler resampler;
+        resampler.Init(IN_RATE, rate);
+        std::vector<float> streamed;
+        std::uniform_int_distribution<size_t> chunk_dist(1, 700);
+        for (size_t offset = 0; offset < ref_in.size();) {
+            size_t n = std::min(chunk_dist(rng), ref_in.size() - offset);
+            resampler.Process(ref_in.data() + offset, n, streamed);
+            offset += n;
+        }
+        resampler.Flush(streamed);
+        double ref_err = 0;
+        bool ok = streamed.size() == ref.size();
+        for (size_t i = 0; ok && i < ref.size(); i++)
+            ref_err = std::max(ref_err, std::fabs(streamed[i] - ref[i]));
+
+        // 分片流式和整段一次处理逐个采样相同
+        std::vector<float> whole = resample(rate, audio, audio.size());
+        std::vector<float> sliced = resample(rate, audio, SLICE_SAMPLES);
+        ok = ok && whole == sliced && whole.size() == out_num &&
+             static_cast<int64_t>(whole.size()) == (static_cast<int64_t>(audio.size()) * bank->up + bank->down - 1) / bank->down;
+        if (!ok)
+            failures++;
+
+        char ratio[32], stop[32] = "-";
+        snprintf(ratio, sizeof(ratio), "%d/%d", bank->up, bank->down);
+        if (rate < IN_RATE)
+            snprintf(stop, sizeof(stop), "%.1f", stopband);
+        printf("%8d %9s %6d %10.2f %12.2f %12.1f %10.4f %10.1f %12s %12.1f%s\n", rate, ratio, bank->taps, design_ms,
+               best_ms * 1e6 / out_num, seconds * 1000.0 / best_ms, ripple, residual, stop, to_db(ref_err / 0.5),
+               ok ? "" : "  MISMATCH");
+    }
+    printf("\nripple: max |gain| of passband tones, resid: passband residual after removing the tone,\n"
+           "stopband: loudest tone above the output nyquist, ref err: max error vs. double reference\n");
+    if (failures > 0) {
+        printf("%d rate(s) differ from the reference or between streamed and whole-buffer output\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,331 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+#include <stdio.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <csignal>
+#include <cstdlib>
+
+#include "cmdline.hpp"
+#include "MeloTTS.hpp"
+#include "Resampler.hpp"
+#include "Profiler.hpp"
+#include "BoundedQueue.hpp"
+#include "server/HttpServer.hpp"
+
+static HttpServer* g_server = nullptr;
+
+// 请求可选的输出采样率范围
+static const int MIN_SAMPLE_RATE = 8000;
+static const int MAX_SAMPLE_RATE = 192000;
+
+static void handle_signal(int sig) {
+    if (g_server)
+        g_server->Stop();
+}
+
+// 把音频编码后攒成完整的WAV
+class WavBufferSink : public AudioSink {
+public:
+    WavBufferSink(std::string& buffer, WavSampleFormat format) : AudioSink(format), m_buffer(buffer) {}
+
+    int Open(int sample_rate) override {
+        m_sample_rate = sample_rate;
+        m_num_samples = 0;
+        m_header_size = wav_header_size(m_format);
+        m_buffer.assign(m_header_size, 0);
+        ResetEncoder(sample_rate, true);
+        return 0;
+    }
+
+    int Write(const float* samples, size_t num) override {
+        m_num_samples += num;
+        return EncodeSamples(samples, num, [this](const uint8_t* data, size_t bytes) {
+            m_buffer.append(reinterpret_cast<const char*>(data), bytes);
+            return 0;
+        }) < 0 ? -1 : 0;
+    }
+
+    int Close() override {
+        FinishEncoder([this](const uint8_t* data, size_t bytes) {
+            m_buffer.append(reinterpret_cast<const char*>(data), bytes);
+            return 0;
+        });
+        size_t data_bytes = m_buffer.size() - m_header_size;
+        // data块按偶数字节对齐
+        if (data_bytes & 1)
+            m_buffer.push_back(0);
+        make_wav_header(reinterpret_cast<uint8_t*>(&m_buffer[0]), m_sample_rate, data_bytes, m_format, m_num_samples);
+        return 0;
+    }
+
+private:
+    std::string& m_buffer;
+    int m_sample_rate;
+    size_t m_header_size;
+    uint32_t m_num_samples;
+};
+
+// 裸流的Content-Type
+static std::string raw_content_type(WavSampleFormat format, int sample_rate) {
+    std::string rate = "; rate=" + std::to_string(sample_rate) + "; channels=1";
+    switch (format) {
+    case WAV_MULAW:
+        return "audio/PCMU" + rate;
+    case WAV_ALAW:
+        return "audio/PCMA" + rate;
+    case WAV_IMA_ADPCM:
+        return "audio/x-ima-adpcm" + rate;
+    case WAV_FLOAT32:
+        return "application/octet-stream";
+    default:
+        return "audio/L16" + rate;
+    }
+}
+
+// 每段音频编码后作为一个HTTP chunk立即发出
+class HttpChunkSink : public AudioSink {
+public:
+    HttpChunkSink(HttpResponseWriter& writer, WavSampleFormat format) : AudioSink(format), m_writer(writer) {}
+
+    int Open(int sample_rate) override {
+        ResetEncoder(sample_rate, false);
+        return m_writer.BeginChunked(200, raw_content_type(m_format, sample_rate));
+    }
+
+    int Write(const float* samples, size_t num) override {
+        return EncodeSamples(samples, num, [this](const uint8_t* data, size_t bytes) {
+            return m_writer.WriteChunk(data, bytes);
+        }) < 0 ? -1 : 0;
+    }
+
+    int Close() override {
+        if (FinishEncoder([this](const uint8_t* data, size_t bytes) { return m_writer.WriteChunk(data, bytes); }) < 0)
+            return -1;
+        return m_writer.EndChunked();
+    }
+
+private:
+    HttpResponseWriter& m_writer;
+};
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("encoder", 'e', "encoder onnx", false, "");
+    cmd.add<std::string>("decoder", 'd', "decoder axmodel, or onnx for cpu backend; comma separated models with different dec_len are dispatched per slice", false, "");
+    cmd.add<std::string>("lexicon", 'l', "lexicon.txt", false, "../models/lexicon.txt");
+    cmd.add<std::string>("token", 't', "tokens.txt", false, "../models/tokens.txt");
+    cmd.add<std::string>("g", 0, "g.bin", false, "");
+    cmd.add<std::string>("language", 0, "language, choose from ZH, EN, JP", false, "ZH");
+    cmd.add<std::string>("backend", 0, "decoder backend, choose from npu, cpu, mock", false, "npu");
+
+    cmd.add<std::string>("host", 0, "listen address", false, "0.0.0.0");
+    cmd.add<int>("port", 'p', "listen port", false, 8000);
+    cmd.add<std::string>("unix", 0, "listen on unix domain socket instead of tcp", false, "");
+    cmd.add<int>("workers", 0, "connection worker threads", false, 4);
+    cmd.add<int>("engines", 0, "resident MeloTTS instances, each holds its own models", false, 1);
+    cmd.add<int>("pipeline_depth", 0, "max encoded sentences waiting for decoder", false, 2);
+    cmd.add<int>("decoder_depth", 0, "decoder slices in flight, 1 runs slices synchronously", false, 2);
+    cmd.add("cached_io", 0, "use cached CMM for npu decoder io");
+    cmd.add<std::string>("slice_planner", 0, "decoder slicing, choose from greedy, optimal", false, "greedy");
+    cmd.add<int>("stitch_overlap", 0, "slice z_p by frames with this many overlapped frames and crossfade them, 0 overlaps two whole words", false, 0);
+    cmd.add<std::string>("crossfade", 0, "crossfade curve for --stitch_overlap, choose from power, linear", false, "power");
+    cmd.add<int>("encoder_threads", 0, "sentences encoded concurrently by the encoder pool", false, 1);
+    cmd.add("io_binding", 0, "bind encoder inputs and outputs to preallocated buffers");
+    cmd.add("no_encoder_cache", 0, "do not load or save the optimized encoder next to the onnx");
+    cmd.add<int>("intra_op_threads", 0, "onnxruntime global intra-op threads", false, 1);
+    cmd.add<int>("inter_op_threads", 0, "onnxruntime global inter-op threads", false, 1);
+    cmd.add<std::string>("profile", 0, "collect per-stage latency, write json here on SIGUSR1 and exit", false, "");
+    cmd.parse_check(argc, argv);
+
+    MeloTTSConfig config;
+    config.encoder_file   = cmd.get<std::string>("encoder");
+    config.decoder_file   = cmd.get<std::string>("decoder");
+    config.lexicon_file   = cmd.get<std::string>("lexicon");
+    config.token_file     = cmd.get<std::string>("token");
+    config.g_file         = cmd.get<std::string>("g");
+    config.backend        = cmd.get<std::string>("backend");
+    config.language       = cmd.get<std::string>("language");
+    config.decoder_depth  = cmd.get<int>("decoder_depth");
+    config.decoder_cached_io = cmd.exist("cached_io");
+    config.slice_planner = cmd.get<std::string>("slice_planner");
+    config.stitch_overlap = cmd.get<int>("stitch_overlap");
+    config.crossfade = cmd.get<std::string>("crossfade");
+    config.encoder_threads = cmd.get<int>("encoder_threads");
+    config.encoder_io_binding = cmd.exist("io_binding");
+    config.encoder_cache = !cmd.exist("no_encoder_cache");
+    config.intra_op_threads = cmd.get<int>("intra_op_threads");
+    config.inter_op_threads = cmd.get<int>("inter_op_threads");
+    config.pipeline_depth = cmd.get<int>("pipeline_depth");
+    config.ResolveDefaultPaths();
+
+    auto host        = cmd.get<std::string>("host");
+    auto port        = cmd.get<int>("port");
+    auto unix_path   = cmd.get<std::string>("unix");
+    auto num_workers = cmd.get<int>("workers");
+    auto num_engines = cmd.get<int>("engines");
+    auto profile_file = cmd.get<std::string>("profile");
+
+    printf("encoder: %s\n", config.encoder_file.c_str());
+    printf("decoder: %s\n", config.decoder_file.c_str());
+    printf("lexicon: %s\n", config.lexicon_file.c_str());
+    printf("token: %s\n", config.token_file.c_str());
+    printf("g: %s\n", config.g_file.c_str());
+    printf("language: %s\n", config.language.c_str());
+    printf("backend: %s\n", config.backend.c_str());
+    printf("workers: %d\n", num_workers);
+    printf("engines: %d\n", num_engines);
+    printf("encoder_threads: %d (intra %d, inter %d)\n", config.encoder_threads, config.intra_op_threads, config.inter_op_threads);
+
+    // 模型常驻内存，请求到来时从池中取一个空闲的引擎
+    std::vector<std::unique_ptr<MeloTTS>> engines;
+    BoundedQueue<MeloTTS*> engine_pool(num_engines);
+    for (int i = 0; i < num_engines; i++) {
+        engines.emplace_back(new MeloTTS());
+        if (0 != engines.back()->Init(config)) {
+            printf("Init MeloTTS[%d] failed!\n", i);
+            return -1;
+        }
+        MeloTTS* engine = engines.back().get();
+        engine_pool.Push(std::move(engine));
+    }
+
+    HttpServer server;
+    int ret = unix_path.empty() ? server.ListenTcp(host, port) : server.ListenUnix(unix_path);
+    if (0 != ret) {
+        printf("Listen failed!\n");
+        return -1;
+    }
+    g_server = &server;
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    if (!profile_file.empty()) {
+        if (!Profiler::IsCompiled())
+            printf("Profiler is not compiled in, ignore --profile\n");
+        else if (0 == Profiler::DumpOnSignal(SIGUSR1, profile_file))
+            Profiler::SetEnabled(true);
+    }
+
+    auto handler = [&](const HttpRequest& request, HttpResponseWriter& writer) {
+        if (request.path == "/health") {
+            writer.SendJson(200, "{\"status\": \"ok\", \"engines\": " + std::to_string(num_engines) + "}");
+            return;
+        }
+        if (request.path != "/tts") {
+            writer.SendJson(404, "{\"error\": \"not found\"}");
+            return;
+        }
+        if (request.method != "POST" && request.method != "GET") {
+            writer.SendJson(405, "{\"error\": \"method not allowed\"}");
+            return;
+        }
+
+        // 参数可以放在query、表单或JSON里
+        auto params = parse_form(request.query);
+        std::string content_type = request.GetHeader("content-type");
+        if (content_type.find("application/json") != std::string::npos) {
+            if (!parse_flat_json(request.body, params)) {
+                writer.SendJson(400, "{\"error\": \"Failed to parse body\"}");
+                return;
+            }
+        } else if (!request.body.empty()) {
+            for (auto& kv : parse_form(request.body))
+                params[kv.first] = kv.second;
+        }
+
+        std::string sentence = params["sentence"];
+        if (sentence.empty()) {
+            writer.SendJson(400, "{\"error\": \"Field 'sentence' is required\"}");
+            return;
+        }
+        if (!params["language"].empty() && params["language"] != config.language) {
+            writer.SendJson(400, "{\"error\": \"server is loaded with language " + json_escape(config.language) + "\"}");
+            return;
+        }
+
+        SynthesizeOptions options;
+        int sample_rate = 44100;
+        char* endp = nullptr;
+        if (!params["speed"].empty()) {
+            options.speed = strtof(params["speed"].c_str(), &endp);
+            if (*endp != '\0' || options.speed <= 0) {
+                writer.SendJson(400, "{\"error\": \"speed must be float\"}");
+                return;
+            }
+        }
+        if (!params["sample_rate"].empty()) {
+            sample_rate = strtol(params["sample_rate"].c_str(), &endp, 10);
+            if (*endp != '\0' || sample_rate <= 0) {
+                writer.SendJson(400, "{\"error\": \"sample_rate must be int\"}");
+                return;
+            }
+            if (sample_rate < MIN_SAMPLE_RATE || sample_rate > MAX_SAMPLE_RATE ||
+                !Resampler::GetBank(44100, sample_rate)) {
+                writer.SendJson(400, "{\"error\": \"unsupported sample_rate\"}");
+                return;
+            }
+        }
+        options.sample_rate = sample_rate;
+        std::string format = params["format"].empty() ? "wav" : params["format"];
+        if (format != "wav" && format != "pcm") {
+            writer.SendJson(400, "{\"error\": \"format must be wav or pcm\"}");
+            return;
+        }
+        WavSampleFormat encoding = WAV_PCM16;
+        if (!params["encoding"].empty() && !parse_wav_format(params["encoding"], encoding)) {
+            writer.SendJson(400, "{\"error\": \"encoding must be pcm16, float32, mulaw, alaw or ima_adpcm\"}");
+            return;
+        }
+
+        printf("Request: sentence=%s format=%s encoding=%s\n", sentence.c_str(), format.c_str(), wav_format_name(encoding));
+
+        MeloTTS* engine = nullptr;
+        if (!engine_pool.Pop(engine)) {
+            writer.SendJson(503, "{\"error\": \"server is shutting down\"}");
+            return;
+        }
+
+        if (format == "pcm") {
+            // 头部一旦发出就无法再返回错误码，失败时直接断开连接
+            HttpChunkSink sink(writer, encoding);
+            if (0 != sink.Open(sample_rate) ||
+                0 != engine->Synthesize(sentence, options, &sink) ||
+                0 != sink.Close()) {
+                writer.SetKeepAlive(false);
+            }
+        } else {
+            std::string wav;
+            WavBufferSink sink(wav, encoding);
+            sink.Open(sample_rate);
+            int synth_ret = engine->Synthesize(sentence, options, &sink);
+            sink.Close();
+            if (0 != synth_ret) {
+                writer.SendJson(500, "{\"error\": \"TTS failed\"}");
+            } else {
+                writer.Send(200, "audio/wav", wav, {{"Content-Disposition", "attachment; filename=\"tts.wav\""}});
+            }
+        }
+
+        engine_pool.Push(std::move(engine));
+    };
+
+    if (unix_path.empty())
+        printf("TTS Server started at http://%s:%d\n", host.c_str(), port);
+    else
+        printf("TTS Server started at unix:%s\n", unix_path.c_str());
+    server.Run(num_workers, handler);
+    engine_pool.Close();
+    printf("TTS Server stopped\n");
+    if (Profiler::IsEnabled() && 0 == Profiler::DumpJson(profile_file))
+        printf("Profile written to %s\n", profile_file.c_str());
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// 分句的benchmark：单次扫描的实现与原来多次replace_all的实现对比输出和吞吐
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <random>
+#include <sys/time.h>
+
+#include "cmdline.hpp"
+#include "split_utils.hpp"
+#include "bench/LegacySplit.hpp"
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int read_lines(const std::string& filename, std::vector<std::string>& lines) {
+    std::ifstream ifs(filename);
+    if (!ifs.is_open()) {
+        printf("Open %s failed!\n", filename.c_str());
+        return -1;
+    }
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (!line.empty())
+            lines.push_back(line);
+    }
+    return 0;
+}
+
+// 原来的实现按字节删除«»，会破坏含0xC2/0xAB/0xBB字节的其他字符，这类输入不比较拉丁语系的结果
+static bool latin_comparable(const std::string& text) {
+    for (unsigned char c : text) {
+        if (c == 0xC2 || c == 0xAB || c == 0xBB)
+            return false;
+    }
+    return true;
+}
+
+// 随机拼接标点、空白和中英文片段，覆盖各种边界情况
+static std::string make_fuzz_text(std::mt19937& rng, const std::vector<std::string>& lines) {
+    static const std::vector<std::string> pieces{
+        "。", "！", "？", "；", "，", ".", ",", "!", "?", ";", " ", "  ", "   ", "\n", "\t", "\r", " \n ",
+        "“", "”", "‘", "’", "«", "»", "<", ">", "(", ")", "[", "]", "\"", "'",
+        "a", "ab", "word", "Hello", "人", "工智能", "技术", "é", "ñ", "x y z", "1.5", "...",
+    };
+    std::string text;
+    int count = rng() % 24;
+    for (int i = 0; i < count; i++) {
+        if (rng() % 16 == 0 && !lines.empty()) {
+            const std::string& line = lines[rng() % lines.size()];
+            text += line.substr(0, rng() % (line.size() + 1));
+        } else {
+            text += pieces[rng() % pieces.size()];
+        }
+    }
+    return text;
+}
+
+static bool same(const std::vector<std::string>& expect, const SplitResult& result) {
+    if (expect.size() != result.size())
+        return false;
+    for (size_t i = 0; i < expect.size(); i++) {
+        if (expect[i].size() != result.spans[i].size ||
+            0 != expect[i].compare(0, expect[i].size(), result.data(i), result.spans[i].size))
+            return false;
+    }
+    return true;
+}
+
+// 逐个输入比较两种语言模式的结果，返回不一致的个数
+static size_t check(const std::vector<std::string>& inputs, size_t& compared) {
+    SplitResult result;
+    size_t diff = 0;
+    for (auto& text : inputs) {
+        for (const char* lang : {"ZH", "EN"}) {
+            if (lang[0] == 'E' && !latin_comparable(text))
+                continue;
+            auto expect = legacy_split_utils::split_sentence(text, 10, lang);
+            split_sentence(text, result, 10, lang);
+            compared++;
+            if (!same(expect, result)) {
+                if (diff < 5) {
+                    printf("mismatch (%s): [%s]\n", lang, text.c_str());
+                    for (auto& s : expect)
+                        printf("  legacy: [%s]\n", s.c_str());
+                    for (size_t i = 0; i < result.size(); i++)
+                        printf("  new:    [%s]\n", result.sentence(i).c_str());
+                }
+                diff++;
+            }
+        }
+    }
+    return diff;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<std::string>("zh", 0, "chinese text file", false, "../model_convert/test_text_zh.txt");
+    cmd.add<std::string>("en", 0, "english text file", false, "../model_convert/test_text_en.txt");
+    cmd.add<int>("size", 's', "corpus size in MB", false, 8);
+    cmd.add<int>("chunk", 'c', "chunk size in KB, the legacy splitter is too slow for a whole document", false, 64);
+    cmd.add<int>("fuzz", 0, "random inputs for the output check", false, 20000);
+    cmd.parse_check(argc, argv);
+
+    auto size_mb  = cmd.get<int>("size");
+    auto chunk_kb = cmd.get<int>("chunk");
+    auto fuzz     = cmd.get<int>("fuzz");
+
+    std::vector<std::string> zh_lines, en_lines;
+    if (0 != read_lines(cmd.get<std::string>("zh"), zh_lines) ||
+        0 != read_lines(cmd.get<std::string>("en"), en_lines))
+        return -1;
+
+    // 输出一致性
+    std::vector<std::string> inputs(zh_lines);
+    inputs.insert(inputs.end(), en_lines.begin(), en_lines.end());
+    std::vector<std::string> all_lines(inputs);
+    std::mt19937 rng(12345);
+    for (int i = 0; i < fuzz; i++)
+        inputs.push_back(make_fuzz_text(rng, all_lines));
+    size_t compared = 0;
+    size_t diff = check(inputs, compared);
+    printf("output check: %zu inputs, %zu mismatches\n", compared, diff);
+
+    // 吞吐：把语料重复拼成size MB的文档，按chunk切开分别调用，新实现另外测整篇一次调用
+    for (const char* lang : {"ZH", "EN"}) {
+        const std::vector<std::string>& lines = lang[0] == 'Z' ? zh_lines : en_lines;
+        if (lines.empty())
+            continue;
+        std::string doc;
+        size_t target = static_cast<size_t>(size_mb) << 20;
+        for (size_t i = 0; doc.size() < target; i++)
+            doc += lines[i % lines.size()] + "\n";
+
+        std::vector<std::string> chunks;
+        size_t chunk_size = static_cast<size_t>(chunk_kb) << 10;
+        for (size_t pos = 0; pos < doc.size(); ) {
+            size_t end = std::min(doc.size(), pos + chunk_size);
+            end = doc.find('\n', end);
+            end = end == std::string::npos ? doc.size() : end + 1;
+            chunks.push_back(doc.substr(pos, end - pos));
+            pos = end;
+        }
+
+        double mb = doc.size() / 1048576.0;
+        size_t legacy_sens = 0, chunk_sens = 0;
+        double start = get_current_time();
+        for (auto& c : chunks)
+            legacy_sens += legacy_split_utils::split_sentence(c, 10, lang).size();
+        double legacy_ms = get_current_time() - start;
+
+        SplitResult result;
+        start = get_current_time();
+        for (auto& c : chunks) {
+            split_sentence(c, result, 10, lang);
+            chunk_sens += result.size();
+        }
+        double chunk_ms = get_current_time() - start;
+
+        start = get_current_time();
+        split_sentence(doc, result, 10, lang);
+        double doc_ms = get_current_time() - start;
+
+        printf("\n%s: %.2f MB, %zu chunks\n", lang, mb, chunks.size());
+        printf("%-14s %9.2f ms %9.2f MB/s %9zu sentences\n", "legacy chunks", legacy_ms, mb / legacy_ms * 1000.0, legacy_sens);
+        printf("%-14s %9.2f ms %9.2f MB/s %9zu sentences\n", "scan chunks", chunk_ms, mb / chunk_ms * 1000.0, chunk_sens);
+        printf("%-14s %9.2f ms %9.2f MB/s %9zu sentences\n", "scan document", doc_ms, mb / doc_ms * 1000.0, result.size());
+        printf("speedup: %.2fx\n", legacy_ms / chunk_ms);
+    }
+
+    return diff == 0 ? 0 : -1;
+}
@@ -0,0 +1,323 @@
+/**************************************************************************************************
+ *
+ * Copyright (c) 2019-2023 Axera Semiconductor (Ningbo) Co., Ltd. All Rights Reserved.
+ *
+ * This source file is the property of Axera Semiconductor (Ningbo) Co., Ltd. and
+ * may not be copied or distributed in any isomorphic form without the prior
+ * written consent of Axera Semiconductor (Ningbo) Co., Ltd.
+ *
+ **************************************************************************************************/
+// WAV保存微基准：不需要模型。对一段合成的float音频比较
+//   AudioFile::save(melotts原来的保存方式，先拷贝成vector<vector<float>>再逐个采样转换)
+//   WavFileSink一次写入整段 / 按decoder切片大小分块写入 / 32bit float
+// 每种方式的耗时、写入速度、堆分配次数和额外占用的堆峰值，以及float转int16的标量和SIMD实现；
+// 最后比较G.711和IMA-ADPCM编码(原采样率和重采样到8kHz)的速度、文件大小和解码后的信噪比
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+
+#include "cmdline.hpp"
+#include "AudioSink.hpp"
+#include "AudioFile.h"
+#include "audio_utils.hpp"
+#include "AudioCodec.hpp"
+#include "Resampler.hpp"
+#include "bench/AllocCounter.hpp"
+
+// decoder一片输出的采样数(dec_len 128 * 512)
+static const size_t SLICE_SAMPLES = 128 * 512;
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 几个正弦叠加再加一点噪声，少量采样超出[-1, 1]用来覆盖限幅
+static std::vector<float> make_audio(size_t num, int sample_rate) {
+    std::vector<float> audio(num);
+    std::mt19937 rng(num);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    const double two_pi = 6.283185307179586;
+    for (size_t i = 0; i < num; i++) {
+        double t = static_cast<double>(i) / sample_rate;
+        audio[i] = static_cast<float>(0.6 * std::sin(two_pi * 220 * t) + 0.4 * std::sin(two_pi * 1375 * t) +
+                                      0.15 * std::sin(two_pi * 3.1 * t)) + noise(rng);
+    }
+    return audio;
+}
+
+struct CaseResult {
+    double mean_ms;
+    double min_ms;
+    double allocs;
+    size_t peak_bytes;
+};
+
+// 每次调用前后统计分配次数和堆峰值
+static CaseResult run_case(const std::function<bool()>& fn, int iterations) {
+    CaseResult r = {0, std::numeric_limits<double>::max(), 0, 0};
+    for (int i = 0; i < iterations; i++) {
+        size_t live = alloc_live_bytes();
+        size_t allocs = alloc_count();
+        alloc_reset_peak();
+        double start = now_ms();
+        if (!fn()) {
+            printf("Save failed!\n");
+            exit(-1);
+        }
+        double ms = now_ms() - start;
+        r.mean_ms += ms / iterations;
+        r.min_ms = std::min(r.min_ms, ms);
+        r.allocs += static_cast<double>(alloc_count() - allocs) / iterations;
+        r.peak_bytes = std::max(r.peak_bytes, alloc_peak_bytes() - live);
+    }
+    return r;
+}
+
+// 用AudioFile读回文件，与原始音频比较，int16允许半个量化步长的误差
+static double max_error(const std::string& file, const std::vector<float>& audio, bool pcm16) {
+    AudioFile<float> loaded;
+    loaded.shouldLogErrorsToConsole(false);
+    if (!loaded.load(file) || loaded.getNumChannels() != 1 || loaded.samples[0].size() != audio.size())
+        return std::numeric_limits<double>::infinity();
+    double err = 0;
+    for (size_t i = 0; i < audio.size(); i++) {
+        float expected = pcm16 ? std::min(std::max(audio[i], -1.0f), 1.0f) : audio[i];
+        // AudioFile读16bit时除以32768
+        float actual = pcm16 ? loaded.samples[0][i] * 32768.0f / 32767.0f : loaded.samples[0][i];
+        err = std::max(err, static_cast<double>(std::fabs(actual - expected)));
+    }
+    return err;
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+    uint8_t buf[65536];
+    size_t n;
+    data.clear();
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(fp);
+    return true;
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+struct CodecCheck {
+    bool ok;
+    double snr_db;
+};
+
+// 按头解析写出的WAV并解码，与float_to_int16量化后的参考比较：
+// 奇数长度的data后面要有填充字节；pcm16和G.711要与逐位计算的参考实现逐字节一致，IMA-ADPCM要与一次编码整段的结果一致
+static CodecCheck check_codec(const std::vector<uint8_t>& file, const std::vector<float>& audio, int sample_rate,
+                              WavSampleFormat format) {
+    CodecCheck result = {false, 0};
+    const size_t header_size = wav_header_size(format);
+    if (file.size() < header_size || memcmp(file.data(), "RIFF", 4) != 0 ||
+        memcmp(file.data() + header_size - 8, "data", 4) != 0)
+        return result;
+    uint8_t expected_header[WAV_MAX_HEADER_SIZE];
+    const uint32_t data_bytes = get_u32(file.data() + header_size - 4);
+    make_wav_header(expected_header, sample_rate, data_bytes, format, audio.size());
+    if (memcmp(expected_header, file.data(), header_size) != 0 || file.size() != header_size + data_bytes + (data_bytes & 1))
+        return result;
+    const uint8_t* data = file.data() + header_size;
+
+    std::vector<int16_t> ref(audio.size()), decoded;
+    float_to_int16(audio.data(), ref.data(), audio.size());
+    bool exact = true;
+    if (format == WAV_PCM16) {
+        exact = data_bytes == audio.size() * 2 && memcmp(data, ref.data(), data_bytes) == 0;
+        decoded = ref;
+    } else if (format == WAV_MULAW || format == WAV_ALAW) {
+        exact = data_bytes == audio.size();
+        for (size_t i = 0; exact && i < audio.size(); i++) {
+            uint8_t code = format == WAV_MULAW ? linear_to_ulaw(ref[i]) : linear_to_alaw(ref[i]);
+            exact = data[i] == code;
+            decoded.push_back(format == WAV_MULAW ? ulaw_to_linear(code) : alaw_to_linear(code));
+        }
+    } else if (format == WAV_IMA_ADPCM) {
+        int samples_per_block = ImaAdpcmEncoder::SamplesPerBlock(ImaAdpcmEncoder::BlockAlign(sample_rate));
+        ImaAdpcmEncoder encoder(samples_per_block);
+        std::vector<uint8_t> whole;
+        encoder.Encode(ref.data(), ref.size(), whole);
+        encoder.Finish(whole);
+        exact = whole.size() == data_bytes && memcmp(whole.data(), data, data_bytes) == 0;
+        ima_adpcm_decode(data, data_bytes, samples_per_block, decoded);
+        exact = exact && decoded.size() >= audio.size();
+    }
+    if (!exact)
+        return result;
+
+    double signal = 0, noise = 0;
+    for (size_t i = 0; i < audio.size(); i++) {
+        double e = static_cast<double>(decoded[i]) - ref[i];
+        signal += static_cast<double>(ref[i]) * ref[i];
+        noise += e * e;
+    }
+    result.ok = true;
+    result.snr_db = noise > 0 ? 10 * std::log10(signal / noise) : std::numeric_limits<double>::infinity();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    cmdline::parser cmd;
+    cmd.add<float>("seconds", 0, "audio length in seconds", false, 60.0f);
+    cmd.add<int>("sample_rate", 0, "sample rate", false, 44100);
+    cmd.add<int>("iterations", 'n', "saves per case", false, 5);
+    cmd.add<std::string>("dir", 0, "directory for the output wav files", false, "/tmp");
+    cmd.parse_check(argc, argv);
+
+    auto seconds     = cmd.get<float>("seconds");
+    auto sample_rate = cmd.get<int>("sample_rate");
+    auto iterations  = std::max(1, cmd.get<int>("iterations"));
+    auto dir         = cmd.get<std::string>("dir");
+
+    std::vector<float> audio = make_audio(static_cast<size_t>(seconds * sample_rate), sample_rate);
+    const double audio_mb = audio.size() * sizeof(float) / 1048576.0;
+    printf("%.1f s of %d Hz audio, %zu samples (%.2f MB float)\n", seconds, sample_rate, audio.size(), audio_mb);
+
+    const std::string audiofile_path = dir + "/melotts_wavbench_audiofile.wav";
+    const std::string pcm16_path = dir + "/melotts_wavbench_pcm16.wav";
+    const std::string stream_path = dir + "/melotts_wavbench_stream.wav";
+    const std::string float32_path = dir + "/melotts_wavbench_float32.wav";
+
+    auto sink_save = [&](const std::string& path, WavSampleFormat format, size_t chunk) {
+        WavFileSink sink(path, format, false);
+        if (0 != sink.Open(sample_rate))
+            return false;
+        for (size_t offset = 0; offset < audio.size(); offset += chunk) {
+            if (0 != sink.Write(audio.data() + offset, std::min(chunk, audio.size() - offset)))
+                return false;
+        }
+        return 0 == sink.Close();
+    };
+
+    struct Case {
+        const char* name;
+        std::string path;
+        bool pcm16;
+        std::function<bool()> fn;
+    };
+    std::vector<Case> cases = {
+        {"AudioFile::save", audiofile_path, true, [&]() {
+            AudioFile<float> audio_file;
+            std::vector<std::vector<float> > audio_samples{audio};
+            audio_file.setAudioBuffer(audio_samples);
+            audio_file.setSampleRate(sample_rate);
+            return audio_file.save(audiofile_path);
+        }},
+        {"WavFileSink pcm16", pcm16_path, true, [&]() { return sink_save(pcm16_path, WAV_PCM16, audio.size()); }},
+        {"WavFileSink pcm16 slices", stream_path, true, [&]() { return sink_save(stream_path, WAV_PCM16, SLICE_SAMPLES); }},
+        {"WavFileSink float32", float32_path, false, [&]() { return sink_save(float32_path, WAV_FLOAT32, audio.size()); }},
+    };
+
+    printf("\n%-26s %10s %10s %10s %10s %14s %12s\n", "writer", "mean ms", "min ms", "MB/s", "allocs", "peak heap MB", "max error");
+    for (auto& c : cases) {
+        CaseResult r = run_case(c.fn, iterations);
+        printf("%-26s %10.2f %10.2f %10.1f %10.1f %14.2f %12.2e\n", c.name, r.mean_ms, r.min_ms,
+               r.min_ms > 0 ? audio_mb / (r.min_ms / 1000.0) : 0, r.allocs, r.peak_bytes / 1048576.0,
+               max_error(c.path, audio, c.pcm16));
+    }
+
+    // 只比较转换本身
+    std::vector<int16_t> pcm(audio.size());
+    struct Convert {
+        const char* name;
+        std::function<void()> fn;
+    };
+    std::vector<Convert> converts = {
+        {"scalar (AudioSink before)", [&]() {
+            for (size_t i = 0; i < audio.size(); i++) {
+                float s = std::min(std::max(audio[i], -1.0f), 1.0f);
+                pcm[i] = static_cast<int16_t>(s * 32767.);
+            }
+        }},
+        {"float_to_int16", [&]() { float_to_int16(audio.data(), pcm.data(), audio.size()); }},
+    };
+    std::vector<uint8_t> codes(audio.size());
+    std::vector<uint8_t> adpcm;
+    std::vector<Convert> encodes = {
+        {"mulaw bitwise", [&]() {
+            float_to_int16(audio.data(), pcm.data(), audio.size());
+            for (size_t i = 0; i < audio.size(); i++)
+                codes[i] = linear_to_ulaw(pcm[i]);
+        }},
+        {"float_to_ulaw (table)", [&]() { float_to_ulaw(audio.data(), codes.data(), audio.size()); }},
+        {"float_to_alaw (table)", [&]() { float_to_alaw(audio.data(), codes.data(), audio.size()); }},
+        {"ima_adpcm", [&]() {
+            ImaAdpcmEncoder encoder(ImaAdpcmEncoder::SamplesPerBlock(ImaAdpcmEncoder::BlockAlign(sample_rate)));
+            adpcm.clear();
+            float_to_int16(audio.data(), pcm.data(), audio.size());
+            encoder.Encode(pcm.data(), pcm.size(), adpcm);
+            encoder.Finish(adpcm);
+        }},
+    };
+    converts.insert(converts.end(), encodes.begin(), encodes.end());
+    printf("\n%-26s %10s\n", "float -> int16", "ns/sample");
+    for (auto& c : converts) {
+        CaseResult r = run_case([&]() { c.fn(); return true; }, iterations);
+        printf("%-26s %10.3f\n", c.name, r.min_ms * 1e6 / audio.size());
+    }
+
+    for (auto& c : cases)
+        remove(c.path.c_str());
+
+    // 电话线路编码：按decoder切片流式写WAV，大小与原采样率的pcm16 / float32比较
+    std::vector<float> audio_8k;
+    Resampler resampler;
+    if (sample_rate != 8000 && 0 == resampler.Init(sample_rate, 8000)) {
+        resampler.Process(audio.data(), audio.size(), audio_8k);
+        resampler.Flush(audio_8k);
+    }
+    const double pcm16_bytes = audio.size() * sizeof(int16_t), float32_bytes = audio.size() * sizeof(float);
+    const std::string codec_path = dir + "/melotts_wavbench_codec.wav";
+    const WavSampleFormat formats[] = {WAV_PCM16, WAV_MULAW, WAV_ALAW, WAV_IMA_ADPCM};
+    int failures = 0;
+    printf("\n%-26s %10s %12s %10s %10s %10s %8s\n", "codec", "ns/sample", "KB/audio s", "vs pcm16", "vs float",
+           "SNR dB", "check");
+    for (int rate : {sample_rate, 8000}) {
+        const std::vector<float>& input = rate == sample_rate ? audio : audio_8k;
+        if (input.empty())
+            continue;
+        for (WavSampleFormat format : formats) {
+            CaseResult r = run_case([&]() {
+                WavFileSink sink(codec_path, format, false);
+                if (0 != sink.Open(rate))
+                    return false;
+                for (size_t offset = 0; offset < input.size(); offset += SLICE_SAMPLES) {
+                    if (0 != sink.Write(input.data() + offset, std::min(SLICE_SAMPLES, input.size() - offset)))
+                        return false;
+                }
+                return 0 == sink.Close();
+            }, iterations);
+            std::vector<uint8_t> file;
+            CodecCheck check = {false, 0};
+            if (read_file(codec_path, file))
+                check = check_codec(file, input, rate, format);
+            if (!check.ok)
+                failures++;
+            std::string name = std::string(wav_format_name(format)) + " " + std::to_string(rate) + " Hz";
+            printf("%-26s %10.2f %12.1f %9.2fx %9.2fx %10.1f %8s\n", name.c_str(), r.min_ms * 1e6 / input.size(),
+                   file.size() / 1024.0 / seconds, pcm16_bytes / file.size(), float32_bytes / file.size(),
+                   check.snr_db, check.ok ? "ok" : "MISMATCH");
+        }
+    }
+    remove(codec_path.c_str());
+    if (failures > 0) {
+        printf("%d codec output(s) do not match the reference\n", failures);
+        return 1;
+    }
+    return 0;
+}
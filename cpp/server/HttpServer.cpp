@@ -0,0 +1,583 @@
+#include "HttpServer.hpp"
+#include "BoundedQueue.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
+#include <cctype>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// 请求头和请求体的上限，超过直接断开
+#define HTTP_MAX_HEADER_SIZE    (64 * 1024)
+#define HTTP_MAX_BODY_SIZE      (1024 * 1024)
+// keep-alive连接空闲超时
+#define HTTP_IDLE_TIMEOUT_SEC   30
+
+static double now_ms() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static std::string to_lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+        [](unsigned char c){ return std::tolower(c); });
+    return s;
+}
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t");
+    if (b == std::string::npos)
+        return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+std::string HttpRequest::GetHeader(const std::string& key) const {
+    auto it = headers.find(to_lower(key));
+    return it == headers.end() ? "" : it->second;
+}
+
+bool HttpRequest::KeepAlive() const {
+    std::string conn = to_lower(GetHeader("connection"));
+    if (version == "HTTP/1.0")
+        return conn == "keep-alive";
+    return conn != "close";
+}
+
+std::string HttpResponseWriter::StatusLine(int status) {
+    const char* reason = "OK";
+    switch (status) {
+        case 200: reason = "OK"; break;
+        case 400: reason = "Bad Request"; break;
+        case 404: reason = "Not Found"; break;
+        case 405: reason = "Method Not Allowed"; break;
+        case 413: reason = "Payload Too Large"; break;
+        case 500: reason = "Internal Server Error"; break;
+        case 503: reason = "Service Unavailable"; break;
+        default: reason = "Unknown"; break;
+    }
+    return "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+}
+
+int HttpResponseWriter::WriteAll(const void* data, size_t size) {
+    if (m_failed)
+        return -1;
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = send(m_fd, p, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            m_failed = true;
+            return -1;
+        }
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
+
+int HttpResponseWriter::Send(int status, const std::string& content_type, const std::string& body,
+                             const std::vector<std::pair<std::string, std::string>>& extra_headers) {
+    std::string head = StatusLine(status);
+    head += "Content-Type: " + content_type + "\r\n";
+    head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    head += m_keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    for (auto& h : extra_headers)
+        head += h.first + ": " + h.second + "\r\n";
+    head += "\r\n";
+    if (0 != WriteAll(head.data(), head.size()))
+        return -1;
+    return WriteAll(body.data(), body.size());
+}
+
+int HttpResponseWriter::BeginChunked(int status, const std::string& content_type) {
+    std::string head = StatusLine(status);
+    head += "Content-Type: " + content_type + "\r\n";
+    head += "Transfer-Encoding: chunked\r\n";
+    head += m_keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    head += "\r\n";
+    m_chunked = true;
+    return WriteAll(head.data(), head.size());
+}
+
+int HttpResponseWriter::WriteChunk(const void* data, size_t size) {
+    if (!m_chunked || size == 0)
+        return m_chunked ? 0 : -1;
+    char len[32];
+    int n = snprintf(len, sizeof(len), "%zx\r\n", size);
+    if (0 != WriteAll(len, n))
+        return -1;
+    if (0 != WriteAll(data, size))
+        return -1;
+    return WriteAll("\r\n", 2);
+}
+
+int HttpResponseWriter::EndChunked() {
+    if (!m_chunked)
+        return -1;
+    m_chunked = false;
+    return WriteAll("0\r\n\r\n", 5);
+}
+
+HttpServer::~HttpServer() {
+    if (m_listen_fd >= 0)
+        close(m_listen_fd);
+    if (!m_unix_path.empty())
+        unlink(m_unix_path.c_str());
+}
+
+int HttpServer::ListenTcp(const std::string& host, int port) {
+    m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+        printf("socket failed! errno = %d\n", errno);
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        printf("Invalid host %s\n", host.c_str());
+        return -1;
+    }
+    if (bind(m_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        printf("bind %s:%d failed! errno = %d\n", host.c_str(), port, errno);
+        return -1;
+    }
+    if (listen(m_listen_fd, 128) != 0) {
+        printf("listen failed! errno = %d\n", errno);
+        return -1;
+    }
+    return 0;
+}
+
+int HttpServer::ListenUnix(const std::string& path) {
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+        printf("socket failed! errno = %d\n", errno);
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        printf("Unix socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    if (bind(m_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        printf("bind %s failed! errno = %d\n", path.c_str(), errno);
+        return -1;
+    }
+    m_unix_path = path;
+    if (listen(m_listen_fd, 128) != 0) {
+        printf("listen failed! errno = %d\n", errno);
+        return -1;
+    }
+    return 0;
+}
+
+int HttpServer::Run(int num_workers, Handler handler) {
+    if (m_listen_fd < 0)
+        return -1;
+    // 两端都非阻塞：poll线程读空管道时不会卡住，管道满时写端直接返回(已有未处理的唤醒)
+    if (pipe2(m_wake_pipe, O_NONBLOCK) != 0) {
+        printf("pipe failed! errno = %d\n", errno);
+        return -1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    m_running = true;
+
+    // 主线程poll监听socket和空闲的keep-alive连接，有数据的连接交给worker处理一个请求，
+    // 处理完再放回空闲集合，空闲连接不会占住worker
+    BoundedQueue<HttpConnection> ready(num_workers * 4);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < num_workers; i++) {
+        workers.emplace_back([this, &ready, &handler]() {
+            HttpConnection conn;
+            while (ready.Pop(conn)) {
+                if (ServeRequest(conn, handler))
+                    ReturnConnection(std::move(conn));
+                else
+                    close(conn.fd);
+            }
+        });
+    }
+
+    std::vector<struct pollfd> fds;
+    while (m_running) {
+        std::vector<HttpConnection> to_serve;
+        double now = now_ms();
+        fds.clear();
+        fds.push_back({m_listen_fd, POLLIN, 0});
+        fds.push_back({m_wake_pipe[0], POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(m_idle_mutex);
+            for (auto it = m_idle.begin(); it != m_idle.end();) {
+                if (!it->second.buffer.empty()) {
+                    // 已经读到了下一个请求的数据，不用等poll
+                    to_serve.push_back(std::move(it->second));
+                    it = m_idle.erase(it);
+                } else if (now - it->second.last_active > HTTP_IDLE_TIMEOUT_SEC * 1000.0) {
+                    close(it->first);
+                    it = m_idle.erase(it);
+                } else {
+                    fds.push_back({it->first, POLLIN, 0});
+                    ++it;
+                }
+            }
+        }
+        for (auto& conn : to_serve)
+            ready.Push(std::move(conn));
+        if (!to_serve.empty())
+            continue;
+
+        int n = poll(fds.data(), fds.size(), 1000);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            printf("poll failed! errno = %d\n", errno);
+            break;
+        }
+        if (n == 0 || !m_running)
+            continue;
+
+        if (fds[1].revents & POLLIN) {
+            char tmp[64];
+            while (read(m_wake_pipe[0], tmp, sizeof(tmp)) > 0) {}
+        }
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (fds[i].revents == 0)
+                continue;
+            HttpConnection conn;
+            {
+                std::lock_guard<std::mutex> lock(m_idle_mutex);
+                auto it = m_idle.find(fds[i].fd);
+                if (it == m_idle.end())
+                    continue;
+                conn = std::move(it->second);
+                m_idle.erase(it);
+            }
+            // 对端关闭时也交给worker，recv返回0后自然关闭
+            ready.Push(std::move(conn));
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(m_listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno != EINTR && errno != EAGAIN && m_running)
+                    printf("accept failed! errno = %d\n", errno);
+                continue;
+            }
+            int opt = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+            // 单个请求读取超时，避免慢客户端占住worker
+            struct timeval tv;
+            tv.tv_sec = HTTP_IDLE_TIMEOUT_SEC;
+            tv.tv_usec = 0;
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            HttpConnection conn;
+            conn.fd = fd;
+            ready.Push(std::move(conn));
+        }
+    }
+
+    ready.Close();
+    for (auto& t : workers)
+        t.join();
+
+    std::lock_guard<std::mutex> lock(m_idle_mutex);
+    for (auto& kv : m_idle)
+        close(kv.first);
+    m_idle.clear();
+    close(m_wake_pipe[0]);
+    close(m_wake_pipe[1]);
+    return 0;
+}
+
+void HttpServer::Stop() {
+    m_running = false;
+    if (m_listen_fd >= 0)
+        shutdown(m_listen_fd, SHUT_RDWR);
+}
+
+void HttpServer::ReturnConnection(HttpConnection&& conn) {
+    conn.last_active = now_ms();
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        int fd = conn.fd;
+        m_idle[fd] = std::move(conn);
+    }
+    // 唤醒poll，把这个连接加入监听
+    char c = 0;
+    if (write(m_wake_pipe[1], &c, 1) < 0) {}
+}
+
+bool HttpServer::ServeRequest(HttpConnection& conn, Handler& handler) {
+    int fd = conn.fd;
+    std::string& buffer = conn.buffer;
+    char tmp[16 * 1024];
+
+    // 读到完整的请求头
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (buffer.size() > HTTP_MAX_HEADER_SIZE)
+            return false;
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buffer.append(tmp, n);
+    }
+
+    HttpRequest request;
+    size_t line_end = buffer.find("\r\n");
+    std::string request_line = buffer.substr(0, line_end);
+    size_t sp1 = request_line.find(' ');
+    size_t sp2 = request_line.rfind(' ');
+    if (sp1 == std::string::npos || sp2 == sp1)
+        return false;
+    request.method = request_line.substr(0, sp1);
+    std::string target = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+    request.version = request_line.substr(sp2 + 1);
+    size_t q = target.find('?');
+    request.path = target.substr(0, q);
+    if (q != std::string::npos)
+        request.query = target.substr(q + 1);
+
+    size_t pos = line_end + 2;
+    while (pos < header_end) {
+        size_t eol = buffer.find("\r\n", pos);
+        std::string line = buffer.substr(pos, eol - pos);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos)
+            request.headers[to_lower(trim(line.substr(0, colon)))] = trim(line.substr(colon + 1));
+        pos = eol + 2;
+    }
+    buffer.erase(0, header_end + 4);
+
+    HttpResponseWriter writer(fd);
+    writer.SetKeepAlive(request.KeepAlive() && m_running);
+
+    size_t content_length = strtoul(request.GetHeader("content-length").c_str(), nullptr, 10);
+    if (content_length > HTTP_MAX_BODY_SIZE) {
+        writer.SetKeepAlive(false);
+        writer.SendJson(413, "{\"error\": \"body too large\"}");
+        return false;
+    }
+    while (buffer.size() < content_length) {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buffer.append(tmp, n);
+    }
+    request.body = buffer.substr(0, content_length);
+    buffer.erase(0, content_length);
+
+    handler(request, writer);
+    return writer.KeepAlive();
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static std::string url_decode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() && hex_value(s[i + 1]) >= 0 && hex_value(s[i + 2]) >= 0) {
+            out += static_cast<char>(hex_value(s[i + 1]) * 16 + hex_value(s[i + 2]));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+std::map<std::string, std::string> parse_form(const std::string& text) {
+    std::map<std::string, std::string> result;
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t amp = text.find('&', pos);
+        if (amp == std::string::npos)
+            amp = text.size();
+        std::string pair = text.substr(pos, amp - pos);
+        if (!pair.empty()) {
+            size_t eq = pair.find('=');
+            if (eq == std::string::npos)
+                result[url_decode(pair)] = "";
+            else
+                result[url_decode(pair.substr(0, eq))] = url_decode(pair.substr(eq + 1));
+        }
+        pos = amp + 1;
+    }
+    return result;
+}
+
+static void append_utf8(std::string& out, unsigned int cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+static bool parse_json_string(const std::string& text, size_t& i, std::string& out) {
+    // text[i] == '"'
+    i++;
+    while (i < text.size()) {
+        char c = text[i++];
+        if (c == '"')
+            return true;
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (i >= text.size())
+            return false;
+        char e = text[i++];
+        switch (e) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (i + 4 > text.size())
+                    return false;
+                unsigned int cp = strtoul(text.substr(i, 4).c_str(), nullptr, 16);
+                i += 4;
+                // UTF-16代理对
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 6 <= text.size() && text[i] == '\\' && text[i + 1] == 'u') {
+                    unsigned int lo = strtoul(text.substr(i + 2, 4).c_str(), nullptr, 16);
+                    i += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+bool parse_flat_json(const std::string& text, std::map<std::string, std::string>& result) {
+    size_t i = 0;
+    auto skip_ws = [&]() {
+        while (i < text.size() && isspace(static_cast<unsigned char>(text[i])))
+            i++;
+    };
+
+    skip_ws();
+    if (i >= text.size() || text[i] != '{')
+        return false;
+    i++;
+    skip_ws();
+    if (i < text.size() && text[i] == '}')
+        return true;
+
+    while (i < text.size()) {
+        skip_ws();
+        if (i >= text.size() || text[i] != '"')
+            return false;
+        std::string key, value;
+        if (!parse_json_string(text, i, key))
+            return false;
+        skip_ws();
+        if (i >= text.size() || text[i] != ':')
+            return false;
+        i++;
+        skip_ws();
+        if (i >= text.size())
+            return false;
+        if (text[i] == '"') {
+            if (!parse_json_string(text, i, value))
+                return false;
+        } else {
+            size_t b = i;
+            while (i < text.size() && text[i] != ',' && text[i] != '}' && !isspace(static_cast<unsigned char>(text[i])))
+                i++;
+            value = text.substr(b, i - b);
+            if (value.empty() || value[0] == '{' || value[0] == '[')
+                return false;
+        }
+        result[key] = value;
+        skip_ws();
+        if (i < text.size() && text[i] == ',') {
+            i++;
+            continue;
+        }
+        if (i < text.size() && text[i] == '}')
+            return true;
+        return false;
+    }
+    return false;
+}
+
+std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+// 最小HTTP/1.1实现，只覆盖TTS服务需要的部分：
+// Content-Length请求体、keep-alive、定长响应和chunked响应
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;
+    std::string version;
+    // key统一转成小写
+    std::map<std::string, std::string> headers;
+    std::string body;
+
+    std::string GetHeader(const std::string& key) const;
+    bool KeepAlive() const;
+};
+
+class HttpResponseWriter {
+public:
+    explicit HttpResponseWriter(int fd) : m_fd(fd), m_keep_alive(true), m_chunked(false), m_failed(false) {}
+
+    // 一次性发送完整响应
+    int Send(int status, const std::string& content_type, const std::string& body,
+             const std::vector<std::pair<std::string, std::string>>& extra_headers = {});
+
+    int SendJson(int status, const std::string& json) {
+        return Send(status, "application/json; charset=utf-8", json);
+    }
+
+    // chunked响应：BeginChunked之后可多次WriteChunk，最后EndChunked
+    int BeginChunked(int status, const std::string& content_type);
+    int WriteChunk(const void* data, size_t size);
+    int EndChunked();
+
+    void SetKeepAlive(bool keep_alive) { m_keep_alive = keep_alive; }
+    bool KeepAlive() const { return m_keep_alive && !m_failed; }
+
+private:
+    int WriteAll(const void* data, size_t size);
+    std::string StatusLine(int status);
+
+    int m_fd;
+    bool m_keep_alive;
+    bool m_chunked;
+    bool m_failed;
+};
+
+// 一个客户端连接以及已读取但尚未处理的数据
+struct HttpConnection {
+    int fd = -1;
+    std::string buffer;
+    double last_active = 0;
+};
+
+class HttpServer {
+public:
+    typedef std::function<void(const HttpRequest& request, HttpResponseWriter& writer)> Handler;
+
+    HttpServer() : m_listen_fd(-1), m_running(false), m_wake_pipe{-1, -1} {}
+    ~HttpServer();
+
+    int ListenTcp(const std::string& host, int port);
+
+    // Unix domain socket，path已存在时会先删除
+    int ListenUnix(const std::string& path);
+
+    // 阻塞运行，num_workers个线程并发处理请求，直到Stop
+    int Run(int num_workers, Handler handler);
+
+    void Stop();
+
+private:
+    // 读取并处理一个请求，返回false表示连接需要关闭
+    bool ServeRequest(HttpConnection& conn, Handler& handler);
+
+    // keep-alive连接处理完一个请求后放回空闲集合，由poll线程继续监听
+    void ReturnConnection(HttpConnection&& conn);
+
+    int m_listen_fd;
+    std::string m_unix_path;
+    std::atomic<bool> m_running;
+    int m_wake_pipe[2];
+    std::mutex m_idle_mutex;
+    std::map<int, HttpConnection> m_idle;
+};
+
+// 解析application/x-www-form-urlencoded或URL query
+std::map<std::string, std::string> parse_form(const std::string& text);
+
+// 解析只有一层、值为字符串/数字/布尔的JSON对象，数字和布尔按原文保留
+bool parse_flat_json(const std::string& text, std::map<std::string, std::string>& result);
+
+// 转义后放进JSON字符串
+std::string json_escape(const std::string& text);
@@ -0,0 +1,232 @@
+#include "AudioCodec.hpp"
+#include "audio_utils.hpp"
+
+#include <algorithm>
+
+// float先量化成int16再查表，每次转换的采样数
+static const size_t CODEC_CHUNK_SAMPLES = 256;
+
+static const int16_t SEG_UEND[8] = {0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF};
+static const int16_t SEG_AEND[8] = {0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF};
+static const int ULAW_BIAS = 0x84;
+static const int ULAW_CLIP = 8159;
+
+static int search_segment(int value, const int16_t* table) {
+    for (int i = 0; i < 8; i++) {
+        if (value <= table[i])
+            return i;
+    }
+    return 8;
+}
+
+uint8_t linear_to_ulaw(int16_t pcm) {
+    int value = pcm >> 2;
+    int mask = 0xFF;
+    if (value < 0) {
+        value = -value;
+        mask = 0x7F;
+    }
+    value = std::min(value, ULAW_CLIP) + (ULAW_BIAS >> 2);
+    int seg = search_segment(value, SEG_UEND);
+    if (seg >= 8)
+        return static_cast<uint8_t>(0x7F ^ mask);
+    return static_cast<uint8_t>(((seg << 4) | ((value >> (seg + 1)) & 0xF)) ^ mask);
+}
+
+uint8_t linear_to_alaw(int16_t pcm) {
+    int value = pcm >> 3;
+    int mask = 0xD5;
+    if (value < 0) {
+        value = -value - 1;
+        mask = 0x55;
+    }
+    int seg = search_segment(value, SEG_AEND);
+    if (seg >= 8)
+        return static_cast<uint8_t>(0x7F ^ mask);
+    int code = seg << 4;
+    code |= seg < 2 ? (value >> 1) & 0xF : (value >> seg) & 0xF;
+    return static_cast<uint8_t>(code ^ mask);
+}
+
+int16_t ulaw_to_linear(uint8_t code) {
+    code = ~code;
+    int t = ((code & 0xF) << 3) + ULAW_BIAS;
+    t <<= (code & 0x70) >> 4;
+    return static_cast<int16_t>((code & 0x80) ? ULAW_BIAS - t : t - ULAW_BIAS);
+}
+
+int16_t alaw_to_linear(uint8_t code) {
+    code ^= 0x55;
+    int t = (code & 0xF) << 4;
+    int seg = (code & 0x70) >> 4;
+    if (seg == 0)
+        t += 8;
+    else if (seg == 1)
+        t += 0x108;
+    else
+        t = (t + 0x108) << (seg - 1);
+    return static_cast<int16_t>((code & 0x80) ? t : -t);
+}
+
+// 按量化后int16的高14位(μ-law)、高13位(A-law)索引
+struct G711Tables {
+    uint8_t ulaw[1 << 14];
+    uint8_t alaw[1 << 13];
+
+    G711Tables() {
+        for (int i = 0; i < (1 << 14); i++)
+            ulaw[i] = linear_to_ulaw(static_cast<int16_t>((i - (1 << 13)) * 4));
+        for (int i = 0; i < (1 << 13); i++)
+            alaw[i] = linear_to_alaw(static_cast<int16_t>((i - (1 << 12)) * 8));
+    }
+};
+
+static const G711Tables& g711_tables() {
+    static const G711Tables tables;
+    return tables;
+}
+
+void float_to_ulaw(const float* src, uint8_t* dst, size_t n) {
+    const uint8_t* table = g711_tables().ulaw + (1 << 13);
+    int16_t pcm[CODEC_CHUNK_SAMPLES];
+    for (size_t offset = 0; offset < n; offset += CODEC_CHUNK_SAMPLES) {
+        size_t m = std::min(n - offset, CODEC_CHUNK_SAMPLES);
+        float_to_int16(src + offset, pcm, m);
+        for (size_t k = 0; k < m; k++)
+            dst[offset + k] = table[pcm[k] >> 2];
+    }
+}
+
+void float_to_alaw(const float* src, uint8_t* dst, size_t n) {
+    const uint8_t* table = g711_tables().alaw + (1 << 12);
+    int16_t pcm[CODEC_CHUNK_SAMPLES];
+    for (size_t offset = 0; offset < n; offset += CODEC_CHUNK_SAMPLES) {
+        size_t m = std::min(n - offset, CODEC_CHUNK_SAMPLES);
+        float_to_int16(src + offset, pcm, m);
+        for (size_t k = 0; k < m; k++)
+            dst[offset + k] = table[pcm[k] >> 3];
+    }
+}
+
+static const int IMA_INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const int IMA_STEP_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+// 按4bit码更新预测值和步长索引，编码和解码共用，保证两边状态一致
+static inline void ima_update(int code, int& predictor, int& index) {
+    const int step = IMA_STEP_TABLE[index];
+    int diff = (step >> 3) + (-((code >> 2) & 1) & step) + (-((code >> 1) & 1) & (step >> 1)) +
+               (-(code & 1) & (step >> 2));
+    const int sign = -((code >> 3) & 1);
+    predictor += (diff ^ sign) - sign;
+    predictor = std::min(std::max(predictor, -32768), 32767);
+    index = std::min(std::max(index + IMA_INDEX_TABLE[code], 0), 88);
+}
+
+ImaAdpcmEncoder::ImaAdpcmEncoder(int samples_per_block) :
+        m_samples_per_block(samples_per_block) {
+    Reset();
+}
+
+void ImaAdpcmEncoder::Reset() {
+    m_predictor = 0;
+    m_index = 0;
+    m_block_pos = 0;
+    m_nibble = -1;
+}
+
+int ImaAdpcmEncoder::BlockAlign(int sample_rate) {
+    return 256 * std::max(1, sample_rate / 11025);
+}
+
+int ImaAdpcmEncoder::EncodeSample(int sample) {
+    // 逐位逼近，写成无分支的形式，语音信号上分支几乎无法预测
+    const int step = IMA_STEP_TABLE[m_index];
+    int diff = sample - m_predictor;
+    const int sign = diff >> 31;
+    diff = (diff ^ sign) - sign;
+    int code = sign & 8;
+    int bit = -(diff >= step);
+    code |= bit & 4;
+    diff -= bit & step;
+    bit = -(diff >= (step >> 1));
+    code |= bit & 2;
+    diff -= bit & (step >> 1);
+    code |= -(diff >= (step >> 2)) & 1;
+    ima_update(code, m_predictor, m_index);
+    return code;
+}
+
+void ImaAdpcmEncoder::Encode(const int16_t* pcm, size_t n, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + n / 2 + 8);
+    for (size_t k = 0; k < n; k++) {
+        if (m_samples_per_block > 0 && m_block_pos == 0) {
+            // 块头：首个采样原样保存，作为本块的预测起点
+            m_predictor = pcm[k];
+            out.push_back(static_cast<uint8_t>(pcm[k] & 0xFF));
+            out.push_back(static_cast<uint8_t>((pcm[k] >> 8) & 0xFF));
+            out.push_back(static_cast<uint8_t>(m_index));
+            out.push_back(0);
+        } else {
+            int code = EncodeSample(pcm[k]);
+            if (m_nibble < 0) {
+                m_nibble = code;
+            } else {
+                out.push_back(static_cast<uint8_t>(m_nibble | (code << 4)));
+                m_nibble = -1;
+            }
+        }
+        if (m_samples_per_block > 0 && ++m_block_pos == m_samples_per_block)
+            m_block_pos = 0;
+    }
+}
+
+void ImaAdpcmEncoder::Finish(std::vector<uint8_t>& out) {
+    const int16_t zero = 0;
+    while (m_samples_per_block > 0 && m_block_pos != 0)
+        Encode(&zero, 1, out);
+    if (m_nibble >= 0)
+        out.push_back(static_cast<uint8_t>(m_nibble));
+    Reset();
+}
+
+void ima_adpcm_decode(const uint8_t* data, size_t bytes, int samples_per_block, std::vector<int16_t>& out) {
+    int predictor = 0, index = 0;
+    auto decode = [&](int code) {
+        ima_update(code, predictor, index);
+        out.push_back(static_cast<int16_t>(predictor));
+    };
+    if (samples_per_block <= 0) {
+        for (size_t i = 0; i < bytes; i++) {
+            decode(data[i] & 0xF);
+            decode(data[i] >> 4);
+        }
+        return;
+    }
+
+    const size_t block_align = 4 + (samples_per_block - 1) / 2;
+    for (size_t offset = 0; offset + 4 <= bytes; offset += block_align) {
+        const uint8_t* block = data + offset;
+        predictor = static_cast<int16_t>(block[0] | (block[1] << 8));
+        index = std::min<int>(block[2], 88);
+        out.push_back(static_cast<int16_t>(predictor));
+        size_t end = std::min(bytes, offset + block_align);
+        for (size_t i = offset + 4; i < end; i++) {
+            decode(data[i] & 0xF);
+            decode(data[i] >> 4);
+        }
+    }
+}
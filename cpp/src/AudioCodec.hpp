@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 电话线路用的压缩编码：G.711 μ-law / A-law(8bit/采样)和IMA-ADPCM(4bit/采样)
+
+// G.711逐位计算的参考实现，与Sun g711.c一致
+uint8_t linear_to_ulaw(int16_t pcm);
+uint8_t linear_to_alaw(int16_t pcm);
+int16_t ulaw_to_linear(uint8_t code);
+int16_t alaw_to_linear(uint8_t code);
+
+// float直接编码成G.711：先按float_to_int16(SIMD)量化，再查表
+// μ-law只用到16bit的高14位，A-law高13位，表分别为16KB和8KB
+void float_to_ulaw(const float* src, uint8_t* dst, size_t n);
+void float_to_alaw(const float* src, uint8_t* dst, size_t n);
+
+// IMA-ADPCM编码，可以按片多次调用Encode，编码状态跨片保留。
+// samples_per_block大于0时按WAV(格式0x11)的块格式输出：每块以4字节块头(首个采样和步长索引)开始，
+// 块头之后每字节两个采样，低4位在前；为0时输出不带块头的连续码流(预测值和步长索引从0开始)
+class ImaAdpcmEncoder {
+public:
+    explicit ImaAdpcmEncoder(int samples_per_block = 0);
+
+    // 开始新的一段
+    void Reset();
+
+    // 编码n个采样，字节追加到out
+    void Encode(const int16_t* pcm, size_t n, std::vector<uint8_t>& out);
+
+    // 一段结束：块格式下最后一块补0到完整一块，连续码流补齐最后半个字节
+    void Finish(std::vector<uint8_t>& out);
+
+    int GetSamplesPerBlock() const { return m_samples_per_block; }
+
+    // WAV常用的块大小：256字节 * max(1, 采样率 / 11025)
+    static int BlockAlign(int sample_rate);
+    static int SamplesPerBlock(int block_align) { return (block_align - 4) * 2 + 1; }
+
+private:
+    int EncodeSample(int sample);
+
+    int m_samples_per_block;
+    int m_predictor;
+    int m_index;
+    // 当前块已编码的采样数
+    int m_block_pos;
+    // 还没凑成一个字节的低4位，-1表示没有
+    int m_nibble;
+};
+
+// 解码IMA-ADPCM，参数含义与ImaAdpcmEncoder相同，用于校验，结果追加到out
+void ima_adpcm_decode(const uint8_t* data, size_t bytes, int samples_per_block, std::vector<int16_t>& out);
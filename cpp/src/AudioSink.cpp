@@ -0,0 +1,385 @@
+#include "AudioSink.hpp"
+#include "audio_utils.hpp"
+#include "AudioCodec.hpp"
+#include "FlacEncoder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+// 转换PCM时每块的采样数，整段写入时中转buffer也只有这么大
+static const size_t PCM_CHUNK_SAMPLES = 16384;
+
+// fd 1同一时间只能交给一个StdoutSink
+static std::atomic<bool> g_stdout_sink_open(false);
+
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static const struct {
+    const char* name;
+    WavSampleFormat format;
+} WAV_FORMAT_NAMES[] = {
+    {"pcm16", WAV_PCM16},
+    {"float32", WAV_FLOAT32},
+    {"mulaw", WAV_MULAW},
+    {"alaw", WAV_ALAW},
+    {"ima_adpcm", WAV_IMA_ADPCM},
+};
+
+bool parse_wav_format(const std::string& name, WavSampleFormat& format) {
+    for (auto& item : WAV_FORMAT_NAMES) {
+        if (name == item.name) {
+            format = item.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* wav_format_name(WavSampleFormat format) {
+    for (auto& item : WAV_FORMAT_NAMES) {
+        if (format == item.format)
+            return item.name;
+    }
+    return "unknown";
+}
+
+size_t wav_header_size(WavSampleFormat format) {
+    switch (format) {
+    case WAV_MULAW:
+    case WAV_ALAW:
+        // fmt块带2字节cbSize，另加12字节fact块
+        return WAV_HEADER_SIZE + 2 + 12;
+    case WAV_IMA_ADPCM:
+        // cbSize和samples per block
+        return WAV_HEADER_SIZE + 4 + 12;
+    default:
+        return WAV_HEADER_SIZE;
+    }
+}
+
+size_t make_wav_header(uint8_t* header, int sample_rate, uint32_t data_bytes, WavSampleFormat format,
+                       uint32_t num_samples) {
+    const uint16_t num_channels = 1;
+    // 1: PCM, 3: IEEE float, 6: A-law, 7: μ-law, 0x11: IMA-ADPCM
+    uint16_t format_tag = 1;
+    uint16_t bits_per_sample = 16;
+    uint16_t block_align = num_channels * 2;
+    uint32_t fmt_size = 16;
+    uint16_t samples_per_block = 0;
+    switch (format) {
+    case WAV_FLOAT32:
+        format_tag = 3;
+        bits_per_sample = 32;
+        block_align = num_channels * 4;
+        break;
+    case WAV_MULAW:
+    case WAV_ALAW:
+        format_tag = format == WAV_MULAW ? 7 : 6;
+        bits_per_sample = 8;
+        block_align = num_channels;
+        fmt_size = 18;
+        break;
+    case WAV_IMA_ADPCM:
+        format_tag = 0x11;
+        bits_per_sample = 4;
+        block_align = ImaAdpcmEncoder::BlockAlign(sample_rate);
+        samples_per_block = ImaAdpcmEncoder::SamplesPerBlock(block_align);
+        fmt_size = 20;
+        break;
+    default:
+        break;
+    }
+    const uint32_t byte_rate = samples_per_block > 0 ?
+            static_cast<uint32_t>(static_cast<uint64_t>(sample_rate) * block_align / samples_per_block) :
+            sample_rate * block_align;
+    const size_t header_size = wav_header_size(format);
+
+    uint8_t* p = header;
+    memcpy(p, "RIFF", 4);
+    // data块长度为奇数时后面有一个填充字节，算在RIFF长度里，不算在data长度里
+    put_u32(p + 4, header_size - 8 + data_bytes + (data_bytes & 1));
+    memcpy(p + 8, "WAVE", 4);
+    memcpy(p + 12, "fmt ", 4);
+    put_u32(p + 16, fmt_size);
+    put_u16(p + 20, format_tag);
+    put_u16(p + 22, num_channels);
+    put_u32(p + 24, sample_rate);
+    put_u32(p + 28, byte_rate);
+    put_u16(p + 32, block_align);
+    put_u16(p + 34, bits_per_sample);
+    p += 36;
+    if (fmt_size > 16) {
+        // cbSize，IMA-ADPCM之后是每块的采样数
+        put_u16(p, fmt_size - 18);
+        if (samples_per_block > 0)
+            put_u16(p + 2, samples_per_block);
+        p += fmt_size - 16;
+        // 压缩格式要有fact块记录采样数
+        memcpy(p, "fact", 4);
+        put_u32(p + 4, 4);
+        put_u32(p + 8, num_samples);
+        p += 12;
+    }
+    memcpy(p, "data", 4);
+    put_u32(p + 4, data_bytes);
+    return header_size;
+}
+
+AudioSink::AudioSink(WavSampleFormat format) : m_format(format) {}
+
+AudioSink::~AudioSink() {}
+
+AudioSink* AudioSink::Create(const std::string& type, const std::string& path, WavSampleFormat format) {
+    if (type == "stdout")
+        return new StdoutSink(format);
+    if (type == "fifo")
+        return new FifoSink(path, format);
+    if (type == "wav")
+        return new WavFileSink(path, format);
+    if (type == "flac")
+        return new FlacFileSink(path);
+    return nullptr;
+}
+
+const int16_t* AudioSink::ToPCM16(const float* samples, size_t num) {
+    if (m_pcm.size() < num)
+        m_pcm.resize(num);
+    float_to_int16(samples, m_pcm.data(), num);
+    return m_pcm.data();
+}
+
+void AudioSink::ResetEncoder(int sample_rate, bool wav) {
+    if (m_format != WAV_IMA_ADPCM)
+        return;
+    int samples_per_block = wav ? ImaAdpcmEncoder::SamplesPerBlock(ImaAdpcmEncoder::BlockAlign(sample_rate)) : 0;
+    m_adpcm.reset(new ImaAdpcmEncoder(samples_per_block));
+}
+
+long AudioSink::EncodeSamples(const float* samples, size_t num, const Output& output) {
+    long bytes = 0;
+    for (size_t offset = 0; offset < num; offset += PCM_CHUNK_SAMPLES) {
+        size_t n = std::min(num - offset, PCM_CHUNK_SAMPLES);
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        switch (m_format) {
+        case WAV_FLOAT32:
+            // WAV是小端，AX650和x86都是小端，float直接写
+            data = reinterpret_cast<const uint8_t*>(samples + offset);
+            size = n * sizeof(float);
+            break;
+        case WAV_MULAW:
+        case WAV_ALAW:
+            m_encoded.resize(n);
+            if (m_format == WAV_MULAW)
+                float_to_ulaw(samples + offset, m_encoded.data(), n);
+            else
+                float_to_alaw(samples + offset, m_encoded.data(), n);
+            data = m_encoded.data();
+            size = n;
+            break;
+        case WAV_IMA_ADPCM:
+            if (!m_adpcm)
+                m_adpcm.reset(new ImaAdpcmEncoder());
+            m_encoded.clear();
+            m_adpcm->Encode(ToPCM16(samples + offset, n), n, m_encoded);
+            data = m_encoded.data();
+            size = m_encoded.size();
+            break;
+        default:
+            data = reinterpret_cast<const uint8_t*>(ToPCM16(samples + offset, n));
+            size = n * sizeof(int16_t);
+            break;
+        }
+        if (size > 0 && 0 != output(data, size))
+            return -1;
+        bytes += size;
+    }
+    return bytes;
+}
+
+long AudioSink::FinishEncoder(const Output& output) {
+    if (m_format != WAV_IMA_ADPCM || !m_adpcm)
+        return 0;
+    m_encoded.clear();
+    m_adpcm->Finish(m_encoded);
+    if (!m_encoded.empty() && 0 != output(m_encoded.data(), m_encoded.size()))
+        return -1;
+    return static_cast<long>(m_encoded.size());
+}
+
+long AudioSink::WriteSamples(FILE* fp, const float* samples, size_t num) {
+    return EncodeSamples(samples, num, [fp](const uint8_t* data, size_t bytes) {
+        return fwrite(data, 1, bytes, fp) == bytes ? 0 : -1;
+    });
+}
+
+long AudioSink::FinishSamples(FILE* fp) {
+    return FinishEncoder([fp](const uint8_t* data, size_t bytes) {
+        return fwrite(data, 1, bytes, fp) == bytes ? 0 : -1;
+    });
+}
+
+int StdoutSink::Open(int sample_rate) {
+    if (m_fp || g_stdout_sink_open.exchange(true)) {
+        fprintf(stderr, "stdout is already used by another audio stream\n");
+        return -1;
+    }
+    // 复制一份stdout给音频，再把fd 1指向stderr，后续printf不会混进音频流
+    fflush(stdout);
+    int audio_fd = dup(STDOUT_FILENO);
+    if (audio_fd < 0) {
+        fprintf(stderr, "dup stdout failed! errno = %d\n", errno);
+        g_stdout_sink_open = false;
+        return -1;
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    m_fp = fdopen(audio_fd, "wb");
+    if (!m_fp) {
+        dup2(audio_fd, STDOUT_FILENO);
+        close(audio_fd);
+        g_stdout_sink_open = false;
+        return -1;
+    }
+    ResetEncoder(sample_rate, false);
+    return 0;
+}
+
+int StdoutSink::Write(const float* samples, size_t num) {
+    if (!m_fp)
+        return -1;
+    if (WriteSamples(m_fp, samples, num) < 0)
+        return -1;
+    fflush(m_fp);
+    return 0;
+}
+
+int StdoutSink::Close() {
+    int ret = 0;
+    if (m_fp) {
+        if (FinishSamples(m_fp) < 0)
+            ret = -1;
+        // fd 1指回原来的stdout
+        fflush(stdout);
+        fflush(m_fp);
+        dup2(fileno(m_fp), STDOUT_FILENO);
+        fclose(m_fp);
+        m_fp = nullptr;
+        g_stdout_sink_open = false;
+    }
+    return ret;
+}
+
+int FifoSink::Open(int sample_rate) {
+    struct stat st;
+    if (stat(m_path.c_str(), &st) != 0) {
+        if (mkfifo(m_path.c_str(), 0666) != 0) {
+            printf("mkfifo %s failed! errno = %d\n", m_path.c_str(), errno);
+            return -1;
+        }
+    } else if (!S_ISFIFO(st.st_mode)) {
+        printf("%s exists and is not a fifo\n", m_path.c_str());
+        return -1;
+    }
+
+    printf("Waiting for reader on %s\n", m_path.c_str());
+    m_fp = fopen(m_path.c_str(), "wb");
+    if (!m_fp) {
+        printf("Open fifo %s failed!\n", m_path.c_str());
+        return -1;
+    }
+    ResetEncoder(sample_rate, false);
+    return 0;
+}
+
+int FifoSink::Write(const float* samples, size_t num) {
+    if (!m_fp)
+        return -1;
+    if (WriteSamples(m_fp, samples, num) < 0)
+        return -1;
+    fflush(m_fp);
+    return 0;
+}
+
+int FifoSink::Close() {
+    int ret = 0;
+    if (m_fp) {
+        if (FinishSamples(m_fp) < 0)
+            ret = -1;
+        fclose(m_fp);
+        m_fp = nullptr;
+    }
+    return ret;
+}
+
+int WavFileSink::Open(int sample_rate) {
+    m_fp = fopen(m_path.c_str(), "wb");
+    if (!m_fp) {
+        printf("Open %s failed!\n", m_path.c_str());
+        return -1;
+    }
+    m_sample_rate = sample_rate;
+    m_data_bytes = 0;
+    m_num_samples = 0;
+    ResetEncoder(sample_rate, true);
+
+    uint8_t header[WAV_MAX_HEADER_SIZE];
+    size_t header_size = make_wav_header(header, sample_rate, 0, m_format);
+    if (fwrite(header, 1, header_size, m_fp) != header_size)
+        return -1;
+    return 0;
+}
+
+int WavFileSink::Write(const float* samples, size_t num) {
+    if (!m_fp)
+        return -1;
+    long bytes = WriteSamples(m_fp, samples, num);
+    if (bytes < 0)
+        return -1;
+    if (m_flush)
+        fflush(m_fp);
+    m_data_bytes += bytes;
+    m_num_samples += num;
+    return 0;
+}
+
+int WavFileSink::Close() {
+    if (!m_fp)
+        return 0;
+
+    int ret = 0;
+    long bytes = FinishSamples(m_fp);
+    if (bytes < 0)
+        ret = -1;
+    else
+        m_data_bytes += bytes;
+    // G.711每个采样一个字节，采样数为奇数时补一个字节，RIFF的块要按偶数字节对齐
+    if (m_data_bytes & 1)
+        fputc(0, m_fp);
+
+    // 回填头里的RIFF、data长度和fact的采样数
+    uint8_t header[WAV_MAX_HEADER_SIZE];
+    size_t header_size = make_wav_header(header, m_sample_rate, m_data_bytes, m_format, m_num_samples);
+    fseek(m_fp, 0, SEEK_SET);
+    fwrite(header, 1, header_size, m_fp);
+
+    if (ferror(m_fp))
+        ret = -1;
+    if (0 != fclose(m_fp))
+        ret = -1;
+    m_fp = nullptr;
+    return ret;
+}
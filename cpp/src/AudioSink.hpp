@@ -0,0 +1,151 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+// 16bit PCM的WAV头长度
+#define WAV_HEADER_SIZE 44
+// WAV头的最大长度(IMA-ADPCM带扩展的fmt块和fact块)
+#define WAV_MAX_HEADER_SIZE 60
+
+// WAV的采样格式，stdout/fifo等裸流也按同样的格式输出
+enum WavSampleFormat {
+    WAV_PCM16,      // 16bit整数PCM
+    WAV_FLOAT32,    // 32bit浮点(IEEE float)，不限幅不量化
+    WAV_MULAW,      // G.711 μ-law，8bit
+    WAV_ALAW,       // G.711 A-law，8bit
+    WAV_IMA_ADPCM,  // IMA-ADPCM，4bit，WAV中按块存放
+};
+
+// 格式名：pcm16 / float32 / mulaw / alaw / ima_adpcm，未知的名字返回false
+bool parse_wav_format(const std::string& name, WavSampleFormat& format);
+const char* wav_format_name(WavSampleFormat format);
+
+// WAV头的长度，G.711和IMA-ADPCM带fact块
+size_t wav_header_size(WavSampleFormat format);
+
+// 生成单声道WAV头，返回头的长度；num_samples写入fact块，只有非PCM格式用到。
+// data_bytes为奇数时RIFF长度包含data后面的填充字节，填充字节由调用者写入
+size_t make_wav_header(uint8_t* header, int sample_rate, uint32_t data_bytes, WavSampleFormat format = WAV_PCM16,
+                       uint32_t num_samples = 0);
+
+class ImaAdpcmEncoder;
+
+// 流式输出：decoder每输出一段裁剪后的音频就交给sink，不再等整段合成结束
+// 默认以单声道16bit PCM输出，限幅后就近取整(float_to_int16)，也可以编码成G.711或IMA-ADPCM
+class AudioSink {
+public:
+    explicit AudioSink(WavSampleFormat format = WAV_PCM16);
+    virtual ~AudioSink();
+
+    virtual int Open(int sample_rate) = 0;
+
+    virtual int Write(const float* samples, size_t num) = 0;
+
+    virtual int Close() = 0;
+
+    // 创建内置sink，type可选 stdout / fifo / wav / flac，stdout和fifo按format输出不带头的裸流，flac忽略format
+    static AudioSink* Create(const std::string& type, const std::string& path, WavSampleFormat format = WAV_PCM16);
+
+protected:
+    typedef std::function<int(const uint8_t* data, size_t bytes)> Output;
+
+    // float转16bit PCM，结果放在m_pcm中
+    const int16_t* ToPCM16(const float* samples, size_t num);
+
+    // 开始新的一段，IMA-ADPCM在wav为true时按WAV的块格式编码，否则输出连续码流
+    void ResetEncoder(int sample_rate, bool wav);
+
+    // 分块编码成m_format交给output，中转buffer不超过一块，output返回非0时中止；
+    // 返回编码后的字节数，失败返回-1
+    long EncodeSamples(const float* samples, size_t num, const Output& output);
+
+    // 一段结束，输出IMA-ADPCM编码器中剩下的部分，返回字节数，失败返回-1
+    long FinishEncoder(const Output& output);
+
+    // 编码后写入fp
+    long WriteSamples(FILE* fp, const float* samples, size_t num);
+    long FinishSamples(FILE* fp);
+
+    WavSampleFormat m_format;
+    std::vector<int16_t> m_pcm;
+    std::vector<uint8_t> m_encoded;
+    std::unique_ptr<ImaAdpcmEncoder> m_adpcm;
+};
+
+// 将音频回调包装成sink，方便调用者直接接收每段float音频
+class CallbackSink : public AudioSink {
+public:
+    typedef std::function<int(const float* samples, size_t num)> Callback;
+
+    explicit CallbackSink(Callback callback) : m_callback(callback) {}
+
+    int Open(int sample_rate) override { return 0; }
+
+    int Write(const float* samples, size_t num) override {
+        return m_callback(samples, num);
+    }
+
+    int Close() override { return 0; }
+
+private:
+    Callback m_callback;
+};
+
+// 裸PCM写到标准输出，例如 ./melotts --stream stdout | aplay -f S16_LE -r 44100 -c 1
+// Open时会把原stdout留给音频，printf日志改到stderr，Close时恢复。同一时间只能打开一个
+class StdoutSink : public AudioSink {
+public:
+    explicit StdoutSink(WavSampleFormat format = WAV_PCM16) : AudioSink(format), m_fp(nullptr) {}
+    ~StdoutSink() { Close(); }
+
+    int Open(int sample_rate) override;
+    int Write(const float* samples, size_t num) override;
+    int Close() override;
+
+private:
+    FILE* m_fp;
+};
+
+// 裸PCM写到命名管道，管道不存在时自动创建，Open会阻塞到读端打开
+class FifoSink : public AudioSink {
+public:
+    explicit FifoSink(const std::string& path, WavSampleFormat format = WAV_PCM16) :
+            AudioSink(format), m_path(path), m_fp(nullptr) {}
+    ~FifoSink() { Close(); }
+
+    int Open(int sample_rate) override;
+    int Write(const float* samples, size_t num) override;
+    int Close() override;
+
+private:
+    std::string m_path;
+    FILE* m_fp;
+};
+
+// 分块写WAV文件：先写长度为0的头，边合成边追加data，Close时回填头里的长度。
+// 整段音频也直接Write一次，不需要先拷贝成AudioFile的buffer
+class WavFileSink : public AudioSink {
+public:
+    explicit WavFileSink(const std::string& path, WavSampleFormat format = WAV_PCM16, bool flush = true) :
+            AudioSink(format), m_path(path), m_flush(flush), m_fp(nullptr), m_sample_rate(0), m_data_bytes(0),
+            m_num_samples(0) {}
+    ~WavFileSink() { Close(); }
+
+    int Open(int sample_rate) override;
+    int Write(const float* samples, size_t num) override;
+    int Close() override;
+
+private:
+    std::string m_path;
+    // 每次Write后fflush，边写边读文件时才需要
+    bool m_flush;
+    FILE* m_fp;
+    int m_sample_rate;
+    uint32_t m_data_bytes;
+    uint32_t m_num_samples;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <sys/time.h>
+
+// 定长阻塞队列，用于连接流水线的前后两级
+// Push在队列满时阻塞，Pop在队列空时阻塞；Close之后Push失败，Pop取完剩余元素后返回false
+// 同时统计两端因为等待而阻塞的时间，用于检查流水线是否真正重叠
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) :
+            m_capacity(capacity > 0 ? capacity : 1),
+            m_closed(false),
+            m_push_wait_ms(0),
+            m_pop_wait_ms(0) {}
+
+    bool Push(T&& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_queue.size() >= m_capacity && !m_closed) {
+            double start = now_ms();
+            m_not_full.wait(lock, [this]() { return m_queue.size() < m_capacity || m_closed; });
+            m_push_wait_ms += now_ms() - start;
+        }
+        if (m_closed)
+            return false;
+        m_queue.push_back(std::move(item));
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_queue.empty() && !m_closed) {
+            double start = now_ms();
+            m_not_empty.wait(lock, [this]() { return !m_queue.empty() || m_closed; });
+            m_pop_wait_ms += now_ms() - start;
+        }
+        if (m_queue.empty())
+            return false;
+        item = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_not_full.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_not_full.notify_all();
+        m_not_empty.notify_all();
+    }
+
+    // 生产者在Push上阻塞的总时间(ms)
+    double PushWaitMs() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_push_wait_ms;
+    }
+
+    // 消费者在Pop上阻塞的总时间(ms)
+    double PopWaitMs() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pop_wait_ms;
+    }
+
+private:
+    static double now_ms() {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+    }
+
+    size_t m_capacity;
+    bool m_closed;
+    double m_push_wait_ms, m_pop_wait_ms;
+    std::deque<T> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_not_full, m_not_empty;
+};
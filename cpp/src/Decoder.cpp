@@ -0,0 +1,91 @@
+#include "Decoder.hpp"
+#include "OnnxDecoder.hpp"
+#include "MockDecoder.hpp"
+#include "Profiler.hpp"
+
+#include <cstring>
+#include <sys/time.h>
+
+#ifdef MELOTTS_USE_NPU
+#include "EngineWrapper.hpp"
+#endif
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+int Decoder::SetPersistentInput(const void* pInput, int index) {
+    if (index < 0 || !pInput)
+        return -1;
+    if ((int)m_persistent.size() <= index)
+        m_persistent.resize(index + 1);
+
+    PersistentInput& input = m_persistent[index];
+    size_t size = GetInputSize(index);
+    if (input.version != 0 && input.data.size() == size && 0 == memcmp(input.data.data(), pInput, size))
+        return 0;
+
+    const uint8_t* src = static_cast<const uint8_t*>(pInput);
+    input.data.assign(src, src + size);
+    input.version++;
+    return 0;
+}
+
+int Decoder::SyncPersistentInputs(int slot) {
+    if (slot < 0)
+        return -1;
+    if ((int)m_slot_versions.size() <= slot)
+        m_slot_versions.resize(slot + 1);
+
+    auto& versions = m_slot_versions[slot];
+    versions.resize(m_persistent.size(), 0);
+    for (size_t i = 0; i < m_persistent.size(); i++) {
+        PersistentInput& input = m_persistent[i];
+        if (input.version == 0)
+            continue;
+        if (versions[i] == input.version) {
+            m_copy_stats.skipped++;
+            m_copy_stats.skipped_bytes += input.data.size();
+            continue;
+        }
+        if (0 != SetInput(input.data.data(), i, slot))
+            return -1;
+        versions[i] = input.version;
+        m_copy_stats.uploads++;
+        m_copy_stats.upload_bytes += input.data.size();
+    }
+    return 0;
+}
+
+int Decoder::Submit(int slot) {
+    if (slot != 0)
+        return -1;
+    double start = get_current_time();
+    // RunSync里会同步slot 0的常驻输入
+    m_sync_ret = RunSync();
+    double run_ms = get_current_time() - start;
+    m_run_ms += run_ms;
+    PROFILE_RECORD_MS(PROFILE_DECODER_RUN, run_ms);
+    return 0;
+}
+
+int Decoder::Wait(int& slot) {
+    slot = 0;
+    return m_sync_ret;
+}
+
+Decoder* Decoder::Create(const std::string& backend, bool cached_io) {
+#ifdef MELOTTS_USE_NPU
+    if (backend == "npu")
+        return new EngineWrapper(cached_io);
+#endif
+    if (backend == "cpu")
+        return new OnnxDecoder();
+    if (backend == "mock")
+        return new MockDecoder();
+    return nullptr;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// 指向后端输入输出buffer的视图，直接读写可以省掉SetInput/GetOutput的拷贝
+template <typename T>
+struct TensorView {
+    T* data;
+    // 元素个数
+    size_t size;
+
+    T& operator[](size_t i) const { return data[i]; }
+    bool empty() const { return data == nullptr; }
+};
+
+// decoder后端接口，输入输出约定与decoder.axmodel一致：
+//   input 0: z_p，[1, C, dec_len] float，长度不足dec_len的部分补0
+//   input 1: g，[1, 256, 1] float
+//   output 0: audio，[1, 1, dec_len * 512] float
+// GetInputSize/GetOutputSize返回字节数，SetInput/GetOutput按该大小整块拷贝
+//
+// 除了RunSync，还可以用Submit/Wait异步提交：后端准备GetDepth()组输入输出(slot)，
+// Submit(slot)之后到Wait返回该slot之前不能改动它的输入输出，Wait按提交顺序返回。
+// 默认实现只有一组slot，Submit里直接RunSync
+//
+// 常驻输入(比如说话人g)用SetPersistentInput设置一次，运行前只有内容变过的slot才会重新拷贝
+
+// 常驻输入的拷贝统计
+struct InputCopyStats {
+    size_t uploads = 0;
+    size_t upload_bytes = 0;
+    // 内容没变、跳过的拷贝
+    size_t skipped = 0;
+    size_t skipped_bytes = 0;
+};
+
+class Decoder {
+public:
+    Decoder() : m_run_ms(0), m_sync_ret(0) {}
+    virtual ~Decoder() {}
+
+    virtual int Init(const std::string& model_file) = 0;
+
+    virtual int SetInput(void* pInput, int index, int slot = 0) = 0;
+
+    virtual int RunSync() = 0;
+
+    virtual int GetOutput(void* pOutput, int index, int slot = 0) = 0;
+
+    // 设置可同时在飞的slot数，需在Init之后调用，不支持时返回-1
+    virtual int SetDepth(int depth) { return depth == 1 ? 0 : -1; }
+    virtual int GetDepth() const { return 1; }
+
+    virtual int Submit(int slot);
+
+    // 等待最早提交的一组完成，返回该组的推理结果
+    virtual int Wait(int& slot);
+
+    // 设置常驻输入，内容与上次相同时什么都不做，否则所有slot标记为脏，在下次运行前拷贝
+    int SetPersistentInput(const void* pInput, int index);
+
+    const InputCopyStats& GetInputCopyStats() const { return m_copy_stats; }
+    void ResetInputCopyStats() { m_copy_stats = InputCopyStats(); }
+
+    // Submit累计的推理耗时，用于统计NPU占用率
+    virtual double GetRunMs() const { return m_run_ms; }
+    virtual void ResetRunMs() { m_run_ms = 0; }
+
+    virtual int GetInputSize(int index) = 0;
+    virtual int GetOutputSize(int index) = 0;
+
+    // 输入输出buffer的地址，不支持时返回nullptr，只能用SetInput/GetOutput
+    virtual void* GetInputPtr(int index, int slot = 0) { return nullptr; }
+    virtual void* GetOutputPtr(int index, int slot = 0) { return nullptr; }
+
+    template <typename T>
+    TensorView<T> GetInputView(int index, int slot = 0) {
+        return TensorView<T>{static_cast<T*>(GetInputPtr(index, slot)), GetInputSize(index) / sizeof(T)};
+    }
+
+    template <typename T>
+    TensorView<T> GetOutputView(int index, int slot = 0) {
+        return TensorView<T>{static_cast<T*>(GetOutputPtr(index, slot)), GetOutputSize(index) / sizeof(T)};
+    }
+
+    virtual int Release() = 0;
+
+    // backend: npu(AX_ENGINE跑axmodel)、cpu(onnxruntime跑onnx)或mock(不跑模型，见MockDecoder)，不支持的返回nullptr
+    // cached_io只对npu有效，输入输出用cached CMM
+    static Decoder* Create(const std::string& backend, bool cached_io = false);
+
+protected:
+    // 把该slot上过期的常驻输入拷贝进去，后端在每次运行前调用
+    int SyncPersistentInputs(int slot);
+
+    double m_run_ms;
+
+private:
+    struct PersistentInput {
+        std::vector<uint8_t> data;
+        // 0表示不是常驻输入
+        uint32_t version = 0;
+    };
+
+    int m_sync_ret;
+    std::vector<PersistentInput> m_persistent;
+    // 每个slot上各输入已经拷贝的版本
+    std::vector<std::vector<uint32_t>> m_slot_versions;
+    InputCopyStats m_copy_stats;
+};
@@ -0,0 +1,75 @@
+#include "EncoderPool.hpp"
+
+#include <cstdio>
+
+#include "OnnxWrapper.hpp"
+
+EncoderPool::EncoderPool() :
+        m_stop(false) {}
+
+EncoderPool::~EncoderPool() {
+    Release();
+}
+
+int EncoderPool::Init(const std::string& model_file, int pool_size, int max_phone_len, bool use_cache) {
+    if (pool_size < 1) {
+        printf("Invalid encoder pool size %d!\n", pool_size);
+        return -1;
+    }
+
+    m_encoder.reset(new OnnxWrapper());
+    if (0 != m_encoder->Init(model_file, use_cache)) {
+        printf("encoder init failed!\n");
+        return -1;
+    }
+
+    for (int i = 0; max_phone_len > 0 && i < pool_size; i++) {
+        m_bindings.emplace_back(new EncoderBinding());
+        if (0 != m_encoder->InitBinding(*m_bindings.back(), max_phone_len)) {
+            printf("Init encoder io binding failed!\n");
+            return -1;
+        }
+    }
+
+    m_stop = false;
+    for (int i = 0; i < pool_size; i++)
+        m_workers.emplace_back(&EncoderPool::WorkerLoop, this, m_bindings.empty() ? nullptr : m_bindings[i].get());
+    return 0;
+}
+
+void EncoderPool::Submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_cond.notify_one();
+}
+
+void EncoderPool::Release() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+    m_bindings.clear();
+    m_encoder.reset();
+}
+
+void EncoderPool::WorkerLoop(EncoderBinding* binding) {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+            // 退出前把剩下的task做完，调用方可能在等结果
+            if (m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task(*m_encoder, binding);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+class OnnxWrapper;
+struct EncoderBinding;
+
+// encoder池：pool_size个工作线程共用一个encoder session并发推理不同的句子，
+// 模型权重只加载一份；session使用OrtEnv的全局线程池
+class EncoderPool {
+public:
+    // binding为当前工作线程专用的绑定IO上下文，没有开启io_binding时为nullptr
+    typedef std::function<void(OnnxWrapper&, EncoderBinding*)> Task;
+
+    EncoderPool();
+    ~EncoderPool();
+
+    // max_phone_len > 0时每个工作线程预分配一份EncoderBinding，use_cache见OnnxWrapper::Init
+    int Init(const std::string& model_file, int pool_size, int max_phone_len = 0, bool use_cache = false);
+
+    // task在某个空闲的工作线程上执行，按提交顺序开始
+    void Submit(Task task);
+
+    int GetPoolSize() const { return static_cast<int>(m_workers.size()); }
+
+    OnnxWrapper& GetEncoder() { return *m_encoder; }
+
+    // 等待已提交的task执行完，停止工作线程
+    void Release();
+
+private:
+    EncoderPool(const EncoderPool&) = delete;
+    EncoderPool& operator=(const EncoderPool&) = delete;
+
+    void WorkerLoop(EncoderBinding* binding);
+
+    std::unique_ptr<OnnxWrapper> m_encoder;
+    std::vector<std::unique_ptr<EncoderBinding>> m_bindings;
+    std::vector<std::thread> m_workers;
+    std::deque<Task> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop;
+};
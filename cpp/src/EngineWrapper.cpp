@@ -9,8 +9,10 @@
  **************************************************************************************************/
 #include "EngineWrapper.hpp"
 #include "utils/io.hpp"
+#include "Profiler.hpp"
 
 #include <cstdlib>
+#include <sys/time.h>
 
 static const char *strAlgoModelType[AX_ENGINE_MODEL_TYPE_BUTT] = {"3.6T", "7.2T", "10.8T"};
 
@@ -224,21 +226,28 @@ int EngineWrapper::Init(const char* strModelPath, uint32_t nNpuType)
 
     // 6. prepare io
     // AX_U32 nIoDepth = (stCtx.vecOutputBufferFlag.size() == 0) ? 1 : stCtx.vecOutputBufferFlag.size();
-    ret = utils::prepare_io(strModelPath, m_io_info, m_io, utils::IO_BUFFER_STRATEGY_DEFAULT);
+    m_io.resize(1);
+    ret = utils::prepare_io(strModelPath, m_io_info, m_io[0],
+                            m_cached_io ? utils::IO_BUFFER_STRATEGY_CACHED : utils::IO_BUFFER_STRATEGY_DEFAULT);
     if (0 != ret) {
         printf("prepare io failed!\n");
-        utils::free_io(m_io);
+        utils::free_io(m_io[0]);
+        m_io.clear();
         return deinit_handle();
     }
 
+    m_model_path = strModelPath;
     m_handle = handle;
+    m_depth = 1;
     m_hasInit = true;
 
     return 0;
 }
 
-int EngineWrapper::SetInput(void* pInput, int index) {
-    return utils::push_io_input(pInput, index, m_io);
+int EngineWrapper::SetInput(void* pInput, int index, int slot) {
+    if (slot < 0 || slot >= m_depth)
+        return -1;
+    return utils::push_io_input(pInput, index, m_io[slot]);
 }
 
 int EngineWrapper::RunSync()
@@ -246,34 +255,171 @@ int EngineWrapper::RunSync()
     if (!m_hasInit)
         return -1;
 
+    if (0 != SyncPersistentInputs(0))
+        return -1;
+
     // 7.3 run & benchmark
-    auto ret = AX_ENGINE_RunSync(m_handle, &m_io);
+    return RunSlot(0);
+}
+
+AX_S32 EngineWrapper::RunSlot(int slot)
+{
+    // CPU写入的输入还在cache里，先刷回内存NPU才能看到
+    if (m_cached_io)
+        utils::cache_io_flush(m_io[slot]);
+
+    auto ret = AX_ENGINE_RunSync(m_handle, &m_io[slot]);
     if (0 != ret) {
         printf("AX_ENGINE_RunSync failed. ret=0x%x\n", ret);
         return ret;
     }
 
+    // NPU直接写内存，CPU读之前作废cache中的旧数据
+    if (m_cached_io)
+        utils::cache_io_invalidate(m_io[slot]);
+
     return 0;
 }
 
-int EngineWrapper::GetOutput(void* pOutput, int index) {
-    return utils::push_io_output(pOutput, index, m_io);
+int EngineWrapper::GetOutput(void* pOutput, int index, int slot) {
+    if (slot < 0 || slot >= m_depth)
+        return -1;
+    return utils::push_io_output(pOutput, index, m_io[slot]);
 }
 
 int EngineWrapper::GetInputSize(int index) {
-    return m_io.pInputs[index].nSize;
+    return m_io[0].pInputs[index].nSize;
 }
 
 int EngineWrapper::GetOutputSize(int index) {
-    return m_io.pOutputs[index].nSize;
+    return m_io[0].pOutputs[index].nSize;
+}
+
+void* EngineWrapper::GetInputPtr(int index, int slot) {
+    if (slot < 0 || slot >= m_depth || index < 0 || index >= m_input_num)
+        return nullptr;
+    return m_io[slot].pInputs[index].pVirAddr;
+}
+
+void* EngineWrapper::GetOutputPtr(int index, int slot) {
+    if (slot < 0 || slot >= m_depth || index < 0 || index >= m_output_num)
+        return nullptr;
+    return m_io[slot].pOutputs[index].pVirAddr;
+}
+
+int EngineWrapper::SetDepth(int depth) {
+    if (!m_hasInit || depth < 1)
+        return -1;
+
+    StopAsync();
+    for (size_t i = 1; i < m_io.size(); i++) {
+        utils::free_io(m_io[i]);
+    }
+    m_io.resize(1);
+    m_depth = 1;
+
+    for (int i = 1; i < depth; i++) {
+        AX_ENGINE_IO_T io;
+        if (0 != utils::prepare_io(m_model_path, m_io_info, io,
+                                   m_cached_io ? utils::IO_BUFFER_STRATEGY_CACHED : utils::IO_BUFFER_STRATEGY_DEFAULT)) {
+            printf("prepare io for slot %d failed!\n", i);
+            for (size_t n = 1; n < m_io.size(); n++) {
+                utils::free_io(m_io[n]);
+            }
+            m_io.resize(1);
+            return -1;
+        }
+        m_io.push_back(io);
+    }
+    m_depth = depth;
+
+    if (m_depth > 1) {
+        m_async_stop = false;
+        m_async_thread = std::thread(&EngineWrapper::AsyncLoop, this);
+    }
+    return 0;
+}
+
+int EngineWrapper::Submit(int slot) {
+    if (m_depth == 1)
+        return Decoder::Submit(slot);
+    if (!m_hasInit || slot < 0 || slot >= m_depth)
+        return -1;
+    if (0 != SyncPersistentInputs(slot))
+        return -1;
+
+    std::lock_guard<std::mutex> lock(m_async_mutex);
+    m_submitted.push_back(slot);
+    m_submit_cv.notify_one();
+    return 0;
+}
+
+int EngineWrapper::Wait(int& slot) {
+    if (m_depth == 1)
+        return Decoder::Wait(slot);
+
+    std::unique_lock<std::mutex> lock(m_async_mutex);
+    m_done_cv.wait(lock, [this]() { return !m_done.empty(); });
+    slot = m_done.front().first;
+    int ret = m_done.front().second;
+    m_done.pop_front();
+    return ret;
+}
+
+// 后台线程：NPU同一时刻只跑一组，按提交顺序逐个RunSync
+void EngineWrapper::AsyncLoop() {
+    while (true) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(m_async_mutex);
+            m_submit_cv.wait(lock, [this]() { return m_async_stop || !m_submitted.empty(); });
+            if (m_submitted.empty())
+                break;
+            slot = m_submitted.front();
+            m_submitted.pop_front();
+        }
+
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        double start = tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+        auto ret = RunSlot(slot);
+        gettimeofday(&tv, NULL);
+        double end = tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        m_run_ms += end - start;
+        PROFILE_RECORD_MS(PROFILE_DECODER_RUN, end - start);
+        m_done.emplace_back(slot, ret);
+        m_done_cv.notify_one();
+    }
+}
+
+// 已提交的会先跑完再退出
+void EngineWrapper::StopAsync() {
+    if (!m_async_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        m_async_stop = true;
+        m_submit_cv.notify_one();
+    }
+    m_async_thread.join();
+    m_submitted.clear();
+    m_done.clear();
 }
 
 int EngineWrapper::Release()
 {
+    StopAsync();
     if (m_handle) {
-        utils::free_io(m_io);
+        for (auto& io : m_io) {
+            utils::free_io(io);
+        }
+        m_io.clear();
         AX_ENGINE_DestroyHandle(m_handle);
         m_handle = nullptr;
     }
+    m_depth = 1;
+    m_hasInit = false;
     return 0;
 }
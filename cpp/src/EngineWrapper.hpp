@@ -15,15 +15,22 @@
 #include <cstring>
 #include <array>
 #include <cstdint>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "ax_engine_api.h"
+#include "Decoder.hpp"
 
 
-class EngineWrapper {
+class EngineWrapper : public Decoder {
 public:
-    EngineWrapper() :
+    // cached_io: 输入输出用cached CMM，CPU读写走cache，运行前后由EngineWrapper做flush/invalidate
+    explicit EngineWrapper(bool cached_io = false) :
             m_hasInit(false),
-            m_handle(nullptr) {}
+            m_handle(nullptr),
+            m_cached_io(cached_io) {}
 
     ~EngineWrapper() {
         Release();
@@ -31,21 +38,56 @@ public:
 
     int Init(const char* strModelPath, uint32_t nNpuType = 0);
 
-    int SetInput(void* pInput, int index);
+    int Init(const std::string& model_file) override {
+        return Init(model_file.c_str());
+    }
+
+    int SetInput(void* pInput, int index, int slot = 0) override;
+
+    int RunSync() override;
+
+    int GetOutput(void* pOutput, int index, int slot = 0) override;
 
-    int RunSync();
+    // 每个slot一组独立的CMM输入输出，depth > 1时由后台线程按提交顺序RunSync，
+    // CPU准备下一组输入、取上一组输出的同时NPU在跑当前这组
+    int SetDepth(int depth) override;
+    int GetDepth() const override { return m_depth; }
 
-    int GetOutput(void* pOutput, int index);
+    int Submit(int slot) override;
+    int Wait(int& slot) override;
 
-    int GetInputSize(int index);
-    int GetOutputSize(int index);
+    int GetInputSize(int index) override;
+    int GetOutputSize(int index) override;
 
-    int Release();
+    // 直接返回CMM buffer的虚拟地址
+    void* GetInputPtr(int index, int slot = 0) override;
+    void* GetOutputPtr(int index, int slot = 0) override;
+
+    int Release() override;
+
+    bool IsCachedIO() const { return m_cached_io; }
 
 protected:
+    // 在指定slot上RunSync，cached模式下负责cache维护
+    AX_S32 RunSlot(int slot);
+    void AsyncLoop();
+    void StopAsync();
+
     bool m_hasInit;
     AX_ENGINE_HANDLE m_handle;
+    bool m_cached_io;
+    std::string m_model_path;
     AX_ENGINE_IO_INFO_T *m_io_info{};
-    AX_ENGINE_IO_T m_io{};
+    // m_io[0]同时用于RunSync
+    std::vector<AX_ENGINE_IO_T> m_io;
     int m_input_num{}, m_output_num{};
+
+    int m_depth{1};
+    std::thread m_async_thread;
+    std::mutex m_async_mutex;
+    std::condition_variable m_submit_cv, m_done_cv;
+    std::deque<int> m_submitted;
+    // 完成的slot和RunSync返回值
+    std::deque<std::pair<int, int>> m_done;
+    bool m_async_stop{false};
 };
\ No newline at end of file
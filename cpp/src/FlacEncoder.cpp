@@ -0,0 +1,622 @@
+#include "FlacEncoder.hpp"
+#include "audio_utils.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+// 每个线程一批编码的帧数
+static const int FRAMES_PER_THREAD = 4;
+// float转int16时每块的采样数
+static const size_t CONVERT_CHUNK_SAMPLES = 16384;
+static const int MAX_FIXED_ORDER = 4;
+static const int MAX_PARTITION_ORDER = 8;
+// 4bit的Rice参数，15保留给escape
+static const int MAX_RICE_PARAM = 14;
+
+// ---------------------------------------------------------------- MD5
+
+static const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static const int MD5_SHIFT[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+Md5::Md5() : m_bytes(0) {
+    m_state[0] = 0x67452301;
+    m_state[1] = 0xefcdab89;
+    m_state[2] = 0x98badcfe;
+    m_state[3] = 0x10325476;
+}
+
+void Md5::Transform(const uint8_t block[64]) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++)
+        w[i] = block[i * 4] | (block[i * 4 + 1] << 8) | (block[i * 4 + 2] << 16) | (static_cast<uint32_t>(block[i * 4 + 3]) << 24);
+    uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+    for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) & 15;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) & 15;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) & 15;
+        }
+        uint32_t t = a + f + MD5_K[i] + w[g];
+        a = d;
+        d = c;
+        c = b;
+        b += (t << MD5_SHIFT[i]) | (t >> (32 - MD5_SHIFT[i]));
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+}
+
+void Md5::Update(const void* data, size_t bytes) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t used = m_bytes & 63;
+    m_bytes += bytes;
+    if (used > 0) {
+        size_t n = std::min(bytes, 64 - used);
+        memcpy(m_buffer + used, p, n);
+        p += n;
+        bytes -= n;
+        if (used + n < 64)
+            return;
+        Transform(m_buffer);
+    }
+    for (; bytes >= 64; p += 64, bytes -= 64)
+        Transform(p);
+    memcpy(m_buffer, p, bytes);
+}
+
+void Md5::Final(uint8_t digest[16]) {
+    uint64_t bits = m_bytes * 8;
+    uint8_t pad[72] = {0x80};
+    size_t used = m_bytes & 63;
+    size_t pad_len = used < 56 ? 56 - used : 120 - used;
+    for (int i = 0; i < 8; i++)
+        pad[pad_len + i] = static_cast<uint8_t>(bits >> (8 * i));
+    Update(pad, pad_len + 8);
+    for (int i = 0; i < 16; i++)
+        digest[i] = static_cast<uint8_t>(m_state[i / 4] >> (8 * (i % 4)));
+}
+
+// ---------------------------------------------------------------- 比特流
+
+struct FlacCrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    FlacCrcTables() {
+        for (int i = 0; i < 256; i++) {
+            unsigned c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+            crc8[i] = static_cast<uint8_t>(c);
+            c = i << 8;
+            for (int k = 0; k < 8; k++)
+                c = (c & 0x8000) ? (c << 1) ^ 0x8005 : c << 1;
+            crc16[i] = static_cast<uint16_t>(c);
+        }
+    }
+};
+
+static const FlacCrcTables& crc_tables() {
+    static const FlacCrcTables tables;
+    return tables;
+}
+
+static uint8_t crc8(const uint8_t* data, size_t n) {
+    const FlacCrcTables& t = crc_tables();
+    uint8_t crc = 0;
+    for (size_t i = 0; i < n; i++)
+        crc = t.crc8[crc ^ data[i]];
+    return crc;
+}
+
+static uint16_t crc16(const uint8_t* data, size_t n) {
+    const FlacCrcTables& t = crc_tables();
+    uint16_t crc = 0;
+    for (size_t i = 0; i < n; i++)
+        crc = static_cast<uint16_t>((crc << 8) ^ t.crc16[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+// 高位在前的比特写入，满8位追加一个字节
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out), m_acc(0), m_bits(0) {}
+
+    // value < 2^bits，bits <= 32
+    void Put(uint32_t value, int bits) {
+        m_acc = (m_acc << bits) | value;
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_out.push_back(static_cast<uint8_t>(m_acc >> m_bits));
+        }
+    }
+
+    void PutSigned(int32_t value, int bits) {
+        Put(static_cast<uint32_t>(value) & ((1u << bits) - 1), bits);
+    }
+
+    // 一元码写商(q个0和一个1)，再写k位余数
+    void PutRice(uint32_t u, int k) {
+        uint32_t q = u >> k;
+        uint32_t low = (1u << k) | (u & ((1u << k) - 1));
+        if (q + 1 + k <= 32) {
+            Put(low, q + 1 + k);
+            return;
+        }
+        for (; q > 0; q -= std::min(q, 32u))
+            Put(0, std::min(q, 32u));
+        Put(low, k + 1);
+    }
+
+    void Align() {
+        if (m_bits > 0)
+            Put(0, 8 - m_bits);
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_acc;
+    int m_bits;
+};
+
+// ---------------------------------------------------------------- 帧
+
+// 每个线程的临时buffer
+struct FlacScratch {
+    std::vector<uint32_t> residual;
+    // 最细分区的残差之和
+    std::vector<uint64_t> sums;
+    std::vector<int> params;
+};
+
+static uint32_t zigzag(int32_t r) {
+    return (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+}
+
+// 估计比特数count * (k + 1) + sum >> k最少的Rice参数
+static int rice_param(uint64_t sum, uint32_t count, uint64_t& bits) {
+    int best = 0;
+    bits = std::numeric_limits<uint64_t>::max();
+    for (int k = 0; k <= MAX_RICE_PARAM; k++) {
+        uint64_t b = static_cast<uint64_t>(count) * (k + 1) + (sum >> k);
+        if (b < bits) {
+            bits = b;
+            best = k;
+        }
+    }
+    return best;
+}
+
+// 标准定义的块大小编码，不能直接表示的在帧头末尾另写8/16位
+static int block_size_code(int n, int& extra_bits) {
+    extra_bits = 0;
+    if (n == 192)
+        return 1;
+    for (int j = 0; j < 4; j++) {
+        if (n == 576 << j)
+            return 2 + j;
+    }
+    for (int j = 0; j < 8; j++) {
+        if (n == 256 << j)
+            return 8 + j;
+    }
+    extra_bits = n <= 256 ? 8 : 16;
+    return n <= 256 ? 6 : 7;
+}
+
+static int sample_rate_code(int rate, int& extra_bits) {
+    static const int RATES[] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    extra_bits = 0;
+    for (int i = 1; i < 12; i++) {
+        if (rate == RATES[i])
+            return i;
+    }
+    if (rate < 65536) {
+        extra_bits = 16;
+        return 13;
+    }
+    // 从STREAMINFO读
+    return 0;
+}
+
+// 编码一帧：帧头、一个子帧、CRC16
+static void encode_frame(const int16_t* x, int n, uint64_t frame_number, int sample_rate, FlacScratch& s,
+                         std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(n * sizeof(int16_t) + 32);
+    BitWriter bw(out);
+
+    int bs_extra, sr_extra;
+    int bs_code = block_size_code(n, bs_extra);
+    int sr_code = sample_rate_code(sample_rate, sr_extra);
+    // 同步码，固定块大小
+    bw.Put(0xFFF8, 16);
+    bw.Put(bs_code, 4);
+    bw.Put(sr_code, 4);
+    // 单声道，16bit
+    bw.Put(0, 4);
+    bw.Put(4, 3);
+    bw.Put(0, 1);
+    // 帧号按UTF-8的方式编码
+    if (frame_number < 0x80) {
+        bw.Put(static_cast<uint32_t>(frame_number), 8);
+    } else {
+        int bytes = 2;
+        while (bytes < 7 && frame_number >= (1ull << (5 * bytes + 1)))
+            bytes++;
+        bw.Put(((0xFF00u >> bytes) & 0xFF) | static_cast<uint32_t>(frame_number >> (6 * (bytes - 1))), 8);
+        for (int i = bytes - 2; i >= 0; i--)
+            bw.Put(0x80 | ((frame_number >> (6 * i)) & 0x3F), 8);
+    }
+    if (bs_extra > 0)
+        bw.Put(n - 1, bs_extra);
+    if (sr_extra > 0)
+        bw.Put(sample_rate, sr_extra);
+    bw.Put(crc8(out.data(), out.size()), 8);
+
+    bool constant = std::all_of(x + 1, x + n, [x](int16_t v) { return v == x[0]; });
+    if (constant) {
+        // CONSTANT子帧
+        bw.Put(0, 8);
+        bw.PutSigned(x[0], 16);
+    } else {
+        // 按残差绝对值之和选预测阶数，各阶都从第MAX_FIXED_ORDER个采样开始统计
+        int order = 0;
+        if (n > MAX_FIXED_ORDER) {
+            uint64_t sums[MAX_FIXED_ORDER + 1] = {0};
+            for (int i = MAX_FIXED_ORDER; i < n; i++) {
+                int32_t a = x[i], b = x[i - 1], c = x[i - 2], d = x[i - 3], e = x[i - 4];
+                sums[0] += std::abs(a);
+                sums[1] += std::abs(a - b);
+                sums[2] += std::abs(a - 2 * b + c);
+                sums[3] += std::abs(a - 3 * b + 3 * c - d);
+                sums[4] += std::abs(a - 4 * b + 6 * c - 4 * d + e);
+            }
+            for (int k = 1; k <= MAX_FIXED_ORDER; k++) {
+                if (sums[k] < sums[order])
+                    order = k;
+            }
+        }
+
+        s.residual.resize(n);
+        uint32_t* u = s.residual.data();
+        for (int i = order; i < n; i++) {
+            int32_t a = x[i];
+            int32_t r;
+            switch (order) {
+            case 0: r = a; break;
+            case 1: r = a - x[i - 1]; break;
+            case 2: r = a - 2 * x[i - 1] + x[i - 2]; break;
+            case 3: r = a - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+            default: r = a - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+            }
+            u[i] = zigzag(r);
+        }
+
+        // 最细的分区：块大小能整除，且第一个分区扣掉预热采样后不为空
+        int max_p = 0;
+        while (max_p < MAX_PARTITION_ORDER && n % (2 << max_p) == 0 && (n >> (max_p + 1)) > order)
+            max_p++;
+        const int parts = 1 << max_p;
+        const int part_len = n >> max_p;
+        s.sums.assign(parts, 0);
+        for (int j = 0; j < parts; j++) {
+            uint64_t sum = 0;
+            for (int i = std::max(j * part_len, order); i < (j + 1) * part_len; i++)
+                sum += u[i];
+            s.sums[j] = sum;
+        }
+
+        // 从细到粗合并相邻分区，选估计比特数最少的分区数
+        uint64_t best_bits = std::numeric_limits<uint64_t>::max();
+        int best_p = 0;
+        std::vector<int>& params = s.params;
+        params.resize(parts);
+        std::vector<uint64_t> level_sums(s.sums);
+        std::vector<int> level_params(parts);
+        for (int p = max_p; p >= 0; p--) {
+            const int count = 1 << p;
+            if (p < max_p) {
+                for (int j = 0; j < count; j++)
+                    level_sums[j] = level_sums[2 * j] + level_sums[2 * j + 1];
+            }
+            uint64_t bits = 2 + 4;
+            for (int j = 0; j < count; j++) {
+                uint64_t part_bits;
+                uint32_t samples = (n >> p) - (j == 0 ? order : 0);
+                level_params[j] = rice_param(level_sums[j], samples, part_bits);
+                bits += 4 + part_bits;
+            }
+            if (bits < best_bits) {
+                best_bits = bits;
+                best_p = p;
+                std::copy(level_params.begin(), level_params.begin() + count, params.begin());
+            }
+        }
+
+        if (16ull * order + best_bits < 16ull * n) {
+            // FIXED子帧
+            // 填充位、类型001xxx(xxx为阶数)、wasted bits标志
+            bw.Put(8 | order, 7);
+            bw.Put(0, 1);
+            for (int i = 0; i < order; i++)
+                bw.PutSigned(x[i], 16);
+            bw.Put(0, 2);
+            bw.Put(best_p, 4);
+            const int len = n >> best_p;
+            for (int j = 0; j < (1 << best_p); j++) {
+                const int k = params[j];
+                bw.Put(k, 4);
+                for (int i = std::max(j * len, order); i < (j + 1) * len; i++)
+                    bw.PutRice(u[i], k);
+            }
+        } else {
+            // VERBATIM子帧，类型000001
+            bw.Put(1 << 1, 8);
+            for (int i = 0; i < n; i++)
+                bw.PutSigned(x[i], 16);
+        }
+    }
+    bw.Align();
+    bw.Put(crc16(out.data(), out.size()), 16);
+}
+
+// ---------------------------------------------------------------- 编码器
+
+FlacEncoder::FlacEncoder(int threads, int block_size) :
+        m_threads(std::max(1, threads)),
+        m_block_size(std::min(std::max(block_size, 16), 65535)),
+        m_sample_rate(0),
+        m_failed(false),
+        m_frame_number(0),
+        m_total_samples(0),
+        m_min_frame_bytes(0),
+        m_max_frame_bytes(0),
+        m_num_jobs(0),
+        m_batch_offset(0),
+        m_batch_samples(0),
+        m_next_job(0),
+        m_generation(0),
+        m_active(0),
+        m_stop(false) {
+    memset(m_digest, 0, sizeof(m_digest));
+    for (int i = 0; i < m_threads; i++)
+        m_scratch.emplace_back(new FlacScratch());
+    for (int i = 1; i < m_threads; i++)
+        m_workers.emplace_back(&FlacEncoder::WorkerLoop, this, i);
+}
+
+FlacEncoder::~FlacEncoder() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_work_cond.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+int FlacEncoder::Begin(int sample_rate, const Output& output) {
+    if (sample_rate <= 0 || sample_rate >= (1 << 20)) {
+        printf("Unsupported flac sample rate %d\n", sample_rate);
+        return -1;
+    }
+    m_sample_rate = sample_rate;
+    m_output = output;
+    m_failed = false;
+    m_pcm.clear();
+    m_frame_number = 0;
+    m_total_samples = 0;
+    m_min_frame_bytes = 0;
+    m_max_frame_bytes = 0;
+    m_md5 = Md5();
+    memset(m_digest, 0, sizeof(m_digest));
+
+    uint8_t header[FLAC_HEADER_SIZE];
+    GetHeader(header);
+    if (0 != m_output(header, sizeof(header))) {
+        m_failed = true;
+        return -1;
+    }
+    return 0;
+}
+
+void FlacEncoder::GetHeader(uint8_t header[FLAC_HEADER_SIZE]) const {
+    std::vector<uint8_t> info;
+    info.reserve(34);
+    BitWriter bw(info);
+    bw.Put(m_block_size, 16);
+    bw.Put(m_block_size, 16);
+    bw.Put(m_min_frame_bytes, 24);
+    bw.Put(m_max_frame_bytes, 24);
+    bw.Put(m_sample_rate, 20);
+    // 单声道，16bit
+    bw.Put(0, 3);
+    bw.Put(15, 5);
+    bw.Put(static_cast<uint32_t>(m_total_samples >> 32) & 0xF, 4);
+    bw.Put(static_cast<uint32_t>(m_total_samples), 32);
+
+    memcpy(header, "fLaC", 4);
+    // 最后一个metadata块，类型0(STREAMINFO)，长度34
+    header[4] = 0x80;
+    header[5] = 0;
+    header[6] = 0;
+    header[7] = 34;
+    memcpy(header + 8, info.data(), 18);
+    memcpy(header + 26, m_digest, 16);
+}
+
+int FlacEncoder::Encode(const float* samples, size_t num) {
+    for (size_t offset = 0; offset < num; offset += CONVERT_CHUNK_SAMPLES) {
+        size_t n = std::min(num - offset, CONVERT_CHUNK_SAMPLES);
+        m_convert.resize(n);
+        float_to_int16(samples + offset, m_convert.data(), n);
+        if (0 != Encode(m_convert.data(), n))
+            return -1;
+    }
+    return 0;
+}
+
+int FlacEncoder::Encode(const int16_t* pcm, size_t num) {
+    if (m_failed || !m_output)
+        return -1;
+    // WAV一样是小端，AX650和x86都是小端
+    m_md5.Update(pcm, num * sizeof(int16_t));
+    m_pcm.insert(m_pcm.end(), pcm, pcm + num);
+
+    const size_t batch_frames = static_cast<size_t>(m_threads) * FRAMES_PER_THREAD;
+    const size_t batch_samples = batch_frames * m_block_size;
+    size_t consumed = 0;
+    while (m_pcm.size() - consumed >= batch_samples) {
+        if (0 != EncodeFrames(consumed, batch_frames, batch_samples))
+            return -1;
+        consumed += batch_samples;
+    }
+    m_pcm.erase(m_pcm.begin(), m_pcm.begin() + consumed);
+    return 0;
+}
+
+int FlacEncoder::Finish() {
+    if (m_failed || !m_output)
+        return -1;
+    size_t rest = m_pcm.size();
+    if (rest > 0 && 0 != EncodeFrames(0, (rest + m_block_size - 1) / m_block_size, rest))
+        return -1;
+    m_pcm.clear();
+    m_md5.Final(m_digest);
+    return 0;
+}
+
+int FlacEncoder::EncodeFrames(size_t offset, size_t num_frames, size_t num_samples) {
+    if (m_frames.size() < num_frames)
+        m_frames.resize(num_frames);
+    m_batch_offset = offset;
+    m_batch_samples = num_samples;
+    m_num_jobs = num_frames;
+    m_next_job = 0;
+    if (m_workers.empty() || num_frames == 1) {
+        EncodeJobs(0);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active = m_workers.size();
+            m_generation++;
+        }
+        m_work_cond.notify_all();
+        EncodeJobs(0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cond.wait(lock, [this]() { return m_active == 0; });
+    }
+
+    for (size_t i = 0; i < num_frames; i++) {
+        const std::vector<uint8_t>& frame = m_frames[i];
+        if (0 != m_output(frame.data(), frame.size())) {
+            m_failed = true;
+            return -1;
+        }
+        uint32_t bytes = static_cast<uint32_t>(frame.size());
+        m_min_frame_bytes = m_min_frame_bytes == 0 ? bytes : std::min(m_min_frame_bytes, bytes);
+        m_max_frame_bytes = std::max(m_max_frame_bytes, bytes);
+    }
+    m_frame_number += num_frames;
+    m_total_samples += num_samples;
+    return 0;
+}
+
+void FlacEncoder::EncodeJobs(size_t scratch) {
+    for (;;) {
+        size_t job = m_next_job++;
+        if (job >= m_num_jobs)
+            break;
+        size_t start = job * m_block_size;
+        int n = static_cast<int>(std::min<size_t>(m_block_size, m_batch_samples - start));
+        encode_frame(m_pcm.data() + m_batch_offset + start, n, m_frame_number + job, m_sample_rate,
+                     *m_scratch[scratch], m_frames[job]);
+    }
+}
+
+void FlacEncoder::WorkerLoop(size_t scratch) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_cond.wait(lock, [this, seen]() { return m_stop || m_generation != seen; });
+            if (m_stop)
+                return;
+            seen = m_generation;
+        }
+        EncodeJobs(scratch);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_active == 0)
+            m_done_cond.notify_one();
+    }
+}
+
+int FlacFileSink::Open(int sample_rate) {
+    m_fp = fopen(m_path.c_str(), "wb");
+    if (!m_fp) {
+        printf("Open %s failed!\n", m_path.c_str());
+        return -1;
+    }
+    m_encoder.reset(new FlacEncoder(m_threads));
+    FILE* fp = m_fp;
+    return m_encoder->Begin(sample_rate, [fp](const uint8_t* data, size_t bytes) {
+        return fwrite(data, 1, bytes, fp) == bytes ? 0 : -1;
+    });
+}
+
+int FlacFileSink::Write(const float* samples, size_t num) {
+    if (!m_fp || !m_encoder)
+        return -1;
+    return m_encoder->Encode(samples, num);
+}
+
+int FlacFileSink::Close() {
+    if (!m_fp)
+        return 0;
+
+    int ret = m_encoder ? m_encoder->Finish() : -1;
+    if (0 == ret) {
+        // 回填总采样数、帧大小范围和MD5
+        uint8_t header[FLAC_HEADER_SIZE];
+        m_encoder->GetHeader(header);
+        fseek(m_fp, 0, SEEK_SET);
+        fwrite(header, 1, sizeof(header), m_fp);
+    }
+    if (ferror(m_fp))
+        ret = -1;
+    if (0 != fclose(m_fp))
+        ret = -1;
+    m_fp = nullptr;
+    m_encoder.reset();
+    return ret;
+}
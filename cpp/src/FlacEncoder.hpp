@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+#include "AudioSink.hpp"
+
+// "fLaC"加上STREAMINFO块
+#define FLAC_HEADER_SIZE 42
+
+// MD5，FLAC的STREAMINFO里记录解码后PCM的MD5
+class Md5 {
+public:
+    Md5();
+    void Update(const void* data, size_t bytes);
+    void Final(uint8_t digest[16]);
+
+private:
+    void Transform(const uint8_t block[64]);
+
+    uint32_t m_state[4];
+    uint64_t m_bytes;
+    uint8_t m_buffer[64];
+};
+
+struct FlacScratch;
+
+// 轻量FLAC编码器：单声道16bit，固定块大小。每块在CONSTANT / FIXED(0~4阶预测) / VERBATIM子帧中
+// 选估计比特数最少的，FIXED的残差按分区Rice编码，分区数也按估计比特数选。
+// PCM与WAV一样由float_to_int16量化，解码结果与16bit WAV逐采样相同。
+// 可以按片多次调用Encode，攒够一批块后由threads个线程并行编码，按帧号顺序交给output
+class FlacEncoder {
+public:
+    typedef std::function<int(const uint8_t* data, size_t bytes)> Output;
+
+    explicit FlacEncoder(int threads = 1, int block_size = 4096);
+    ~FlacEncoder();
+
+    // 开始一个流，输出文件头，其中总采样数、帧大小范围和MD5还未知(为0)
+    int Begin(int sample_rate, const Output& output);
+
+    int Encode(const float* samples, size_t num);
+    int Encode(const int16_t* pcm, size_t num);
+
+    // 编码剩余的采样，之后GetHeader可以取得完整的文件头
+    int Finish();
+
+    void GetHeader(uint8_t header[FLAC_HEADER_SIZE]) const;
+
+    uint64_t GetTotalSamples() const { return m_total_samples; }
+
+private:
+    FlacEncoder(const FlacEncoder&) = delete;
+    FlacEncoder& operator=(const FlacEncoder&) = delete;
+
+    // 并行编码m_pcm从offset开始num_samples个采样，共num_frames帧，最后一帧可以不满一块，然后按顺序输出
+    int EncodeFrames(size_t offset, size_t num_frames, size_t num_samples);
+    void EncodeJobs(size_t scratch);
+    void WorkerLoop(size_t scratch);
+
+    int m_threads;
+    int m_block_size;
+    int m_sample_rate;
+    Output m_output;
+    bool m_failed;
+
+    std::vector<int16_t> m_pcm;
+    std::vector<int16_t> m_convert;
+    std::vector<std::vector<uint8_t>> m_frames;
+    // 每个线程一份残差等临时buffer，0给调用线程
+    std::vector<std::unique_ptr<FlacScratch>> m_scratch;
+    uint64_t m_frame_number;
+    uint64_t m_total_samples;
+    uint32_t m_min_frame_bytes;
+    uint32_t m_max_frame_bytes;
+    Md5 m_md5;
+    uint8_t m_digest[16];
+
+    // 本批的帧，工作线程用m_next_job领取
+    size_t m_num_jobs;
+    size_t m_batch_offset;
+    size_t m_batch_samples;
+    std::atomic<size_t> m_next_job;
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_work_cond;
+    std::condition_variable m_done_cond;
+    uint64_t m_generation;
+    size_t m_active;
+    bool m_stop;
+};
+
+// 边合成边写FLAC文件，Close时回填文件头
+class FlacFileSink : public AudioSink {
+public:
+    explicit FlacFileSink(const std::string& path, int threads = 1) :
+            m_path(path), m_threads(threads), m_fp(nullptr) {}
+    ~FlacFileSink() { Close(); }
+
+    int Open(int sample_rate) override;
+    int Write(const float* samples, size_t num) override;
+    int Close() override;
+
+private:
+    std::string m_path;
+    int m_threads;
+    FILE* m_fp;
+    std::unique_ptr<FlacEncoder> m_encoder;
+};
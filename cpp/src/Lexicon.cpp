@@ -0,0 +1,484 @@
+#include "Lexicon.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static std::vector<std::string> split(const std::string &s, char delim) {
+    std::vector<std::string> result;
+    std::stringstream ss (s);
+    std::string item;
+    while (getline (ss, item, delim)) {
+        result.push_back (item);
+    }
+    return result;
+}
+
+// 解码一个UTF-8字符，字节长度的判断与原来逐字切分一致；
+// 非法或截断的序列映射到0x110000以上，不会和正常字符冲突
+static inline uint32_t decode_utf8(const char* s, size_t n, size_t i, size_t& len) {
+    unsigned char c = s[i];
+    uint32_t cp;
+    if ((c & 0x80) == 0x00) {
+        len = 1;
+        return c;
+    } else if ((c & 0xE0) == 0xC0) {
+        len = 2;
+        cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        len = 3;
+        cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        len = 4;
+        cp = c & 0x07;
+    } else {
+        len = 1;
+        return 0x110000 + c;
+    }
+    if (i + len > n) {
+        len = n - i;
+        return 0x120000 + c;
+    }
+    for (size_t k = 1; k < len; k++)
+        cp = (cp << 6) | (static_cast<unsigned char>(s[i + k]) & 0x3F);
+    return cp;
+}
+
+static inline bool is_ascii_letter(uint32_t cp) {
+    return (cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z');
+}
+
+// 全角标点按半角查
+static inline uint32_t map_punctuation(uint32_t cp) {
+    switch (cp) {
+        case 0xFF0C: return ',';   // ，
+        case 0x3002: return '.';   // 。
+        case 0xFF01: return '!';   // ！
+        case 0xFF1F: return '?';   // ？
+        default: return cp;
+    }
+}
+
+// 二进制镜像：文件头 + 各段数组，段按64字节对齐，小端
+// 格式有变化时增加LEXICON_IMAGE_VERSION，旧镜像需要用melotts_lexc重新编译
+static const char LEXICON_IMAGE_MAGIC[8] = {'M', 'E', 'L', 'O', 'L', 'E', 'X', '\0'};
+static const uint32_t LEXICON_IMAGE_VERSION = 1;
+static const uint32_t LEXICON_IMAGE_BYTE_ORDER = 0x01020304;
+static const uint32_t ROOT_TABLE_SIZE = 0x10000;
+static const size_t LEXICON_IMAGE_ALIGN = 64;
+
+struct LexiconImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t node_count;
+    uint32_t edge_count;
+    uint32_t root_table_size;
+    uint32_t entry_count;
+    uint32_t phone_count;
+    int32_t unknown_entry;
+    uint32_t reserved;
+    uint64_t nodes_offset;
+    uint64_t edge_keys_offset;
+    uint64_t edge_nodes_offset;
+    uint64_t root_table_offset;
+    uint64_t entries_offset;
+    uint64_t phones_offset;
+    uint64_t tones_offset;
+    uint64_t file_size;
+};
+
+static_assert(sizeof(int) == sizeof(int32_t), "phone/tone arenas are stored as int32");
+
+static inline uint64_t align_up(uint64_t v) {
+    return (v + LEXICON_IMAGE_ALIGN - 1) / LEXICON_IMAGE_ALIGN * LEXICON_IMAGE_ALIGN;
+}
+
+Lexicon::Lexicon(const std::string& lexicon_filename, const std::string& tokens_filename) :
+        m_nodes(nullptr),
+        m_edge_keys(nullptr),
+        m_edge_nodes(nullptr),
+        m_root_table(nullptr),
+        m_entries(nullptr),
+        m_phones(nullptr),
+        m_tones(nullptr),
+        m_node_count(0),
+        m_edge_count(0),
+        m_entry_count(0),
+        m_phone_count(0),
+        m_unknown_entry(-1),
+        m_map_addr(nullptr),
+        m_map_size(0) {
+    int ret = IsImage(lexicon_filename) ? LoadImage(lexicon_filename) : LoadText(lexicon_filename, tokens_filename);
+    if (0 != ret) {
+        m_nodes = nullptr;
+        m_entry_count = 0;
+    }
+}
+
+Lexicon::~Lexicon() {
+    if (m_map_addr)
+        munmap(m_map_addr, m_map_size);
+}
+
+bool Lexicon::IsImage(const std::string& filename) {
+    char magic[sizeof(LEXICON_IMAGE_MAGIC)];
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs.read(magic, sizeof(magic)))
+        return false;
+    return 0 == memcmp(magic, LEXICON_IMAGE_MAGIC, sizeof(magic));
+}
+
+int Lexicon::LoadText(const std::string& lexicon_filename, const std::string& tokens_filename) {
+    m_node_buf.push_back(Node{0, 0, -1});
+
+    std::unordered_map<std::string, int> tokens;
+    std::ifstream ifs(tokens_filename);
+    if (!ifs.is_open()) {
+        printf("Open %s failed!\n", tokens_filename.c_str());
+        return -1;
+    }
+
+    std::string line;
+    while ( std::getline(ifs, line) ) {
+        auto splitted_line = split(line, ' ');
+        tokens.insert({splitted_line[0], std::stoi(splitted_line[1])});
+    }
+    ifs.close();
+
+    ifs.open(lexicon_filename);
+    if (!ifs.is_open()) {
+        printf("Open %s failed!\n", lexicon_filename.c_str());
+        return -1;
+    }
+    std::vector<int> phones, tones;
+    while ( std::getline(ifs, line) ) {
+        auto splitted_line = split(line, ' ');
+        std::string word_or_phrase = splitted_line[0];
+        size_t phone_tone_len = splitted_line.size() - 1;
+        size_t half_len = phone_tone_len / 2;
+        phones.clear();
+        tones.clear();
+        for (size_t i = 0; i < phone_tone_len; i++) {
+            auto phone_or_tone = splitted_line[i + 1];
+            if (i < half_len) {
+                phones.push_back(tokens[phone_or_tone]);
+            } else {
+                tones.push_back(std::stoi(phone_or_tone));
+            }
+        }
+
+        Insert(word_or_phrase, phones, tones, false);
+    }
+
+    auto alias = [this](const std::string& word, const std::string& target) {
+        int32_t entry = Find(target);
+        if (entry < 0)
+            return;
+        const Entry e = m_entry_buf[entry];
+        std::vector<int> p(m_phone_buf.begin() + e.offset, m_phone_buf.begin() + e.offset + e.size);
+        std::vector<int> t(m_tone_buf.begin() + e.offset, m_tone_buf.begin() + e.offset + e.size);
+        Insert(word, p, t, true);
+    };
+    alias("呣", "母");
+    alias("嗯", "恩");
+
+    const std::vector<std::string> punctuation{"!", "?", "…", ",", ".", "'", "-"};
+    for (auto p : punctuation) {
+        int i = tokens[p];
+        int tone = 0;
+        Insert(p, std::vector<int>{i}, std::vector<int>{tone}, true);
+    }
+    m_unknown_entry = Insert(" ", std::vector<int>{tokens["_"]}, std::vector<int>{0}, true);
+
+    Build();
+
+    m_nodes = m_node_buf.data();
+    m_edge_keys = m_edge_key_buf.data();
+    m_edge_nodes = m_edge_node_buf.data();
+    m_root_table = m_root_table_buf.data();
+    m_entries = m_entry_buf.data();
+    m_phones = m_phone_buf.data();
+    m_tones = m_tone_buf.data();
+    m_node_count = m_node_buf.size();
+    m_edge_count = m_edge_key_buf.size();
+    m_entry_count = m_entry_buf.size();
+    m_phone_count = m_phone_buf.size();
+    return 0;
+}
+
+int Lexicon::LoadImage(const std::string& image_filename) {
+    int fd = open(image_filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        printf("Open %s failed!\n", image_filename.c_str());
+        return -1;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || st.st_size < static_cast<off_t>(sizeof(LexiconImageHeader))) {
+        printf("Invalid lexicon image %s!\n", image_filename.c_str());
+        close(fd);
+        return -1;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        printf("mmap %s failed!\n", image_filename.c_str());
+        return -1;
+    }
+    m_map_addr = addr;
+    m_map_size = st.st_size;
+
+    // 只检查文件头和各段范围，不逐个校验节点，加载与词典大小无关
+    const char* base = static_cast<const char*>(addr);
+    const LexiconImageHeader* h = reinterpret_cast<const LexiconImageHeader*>(base);
+    auto section_ok = [&](uint64_t offset, uint64_t count, size_t elem_size) {
+        return offset % LEXICON_IMAGE_ALIGN == 0 && offset <= h->file_size && count <= (h->file_size - offset) / elem_size;
+    };
+    if (0 != memcmp(h->magic, LEXICON_IMAGE_MAGIC, sizeof(h->magic)) ||
+        h->version != LEXICON_IMAGE_VERSION ||
+        h->byte_order != LEXICON_IMAGE_BYTE_ORDER ||
+        h->header_size != sizeof(LexiconImageHeader) ||
+        h->file_size != m_map_size ||
+        h->node_count == 0 ||
+        h->root_table_size != ROOT_TABLE_SIZE ||
+        h->unknown_entry < 0 || static_cast<uint32_t>(h->unknown_entry) >= h->entry_count ||
+        !section_ok(h->nodes_offset, h->node_count, sizeof(Node)) ||
+        !section_ok(h->edge_keys_offset, h->edge_count, sizeof(uint32_t)) ||
+        !section_ok(h->edge_nodes_offset, h->edge_count, sizeof(uint32_t)) ||
+        !section_ok(h->root_table_offset, h->root_table_size, sizeof(uint32_t)) ||
+        !section_ok(h->entries_offset, h->entry_count, sizeof(Entry)) ||
+        !section_ok(h->phones_offset, h->phone_count, sizeof(int32_t)) ||
+        !section_ok(h->tones_offset, h->phone_count, sizeof(int32_t))) {
+        printf("Invalid lexicon image %s (version %u, expect %u)!\n", image_filename.c_str(),
+               h->version, LEXICON_IMAGE_VERSION);
+        return -1;
+    }
+
+    m_nodes = reinterpret_cast<const Node*>(base + h->nodes_offset);
+    m_edge_keys = reinterpret_cast<const uint32_t*>(base + h->edge_keys_offset);
+    m_edge_nodes = reinterpret_cast<const uint32_t*>(base + h->edge_nodes_offset);
+    m_root_table = reinterpret_cast<const uint32_t*>(base + h->root_table_offset);
+    m_entries = reinterpret_cast<const Entry*>(base + h->entries_offset);
+    m_phones = reinterpret_cast<const int32_t*>(base + h->phones_offset);
+    m_tones = reinterpret_cast<const int32_t*>(base + h->tones_offset);
+    m_node_count = h->node_count;
+    m_edge_count = h->edge_count;
+    m_entry_count = h->entry_count;
+    m_phone_count = h->phone_count;
+    m_unknown_entry = h->unknown_entry;
+    return 0;
+}
+
+int Lexicon::Save(const std::string& image_filename) const {
+    if (!IsLoaded())
+        return -1;
+
+    LexiconImageHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, LEXICON_IMAGE_MAGIC, sizeof(h.magic));
+    h.version = LEXICON_IMAGE_VERSION;
+    h.byte_order = LEXICON_IMAGE_BYTE_ORDER;
+    h.header_size = sizeof(h);
+    h.node_count = m_node_count;
+    h.edge_count = m_edge_count;
+    h.root_table_size = ROOT_TABLE_SIZE;
+    h.entry_count = m_entry_count;
+    h.phone_count = m_phone_count;
+    h.unknown_entry = m_unknown_entry;
+
+    struct Section {
+        uint64_t* offset;
+        const void* data;
+        size_t bytes;
+    };
+    Section sections[] = {
+        {&h.nodes_offset, m_nodes, sizeof(Node) * m_node_count},
+        {&h.edge_keys_offset, m_edge_keys, sizeof(uint32_t) * m_edge_count},
+        {&h.edge_nodes_offset, m_edge_nodes, sizeof(uint32_t) * m_edge_count},
+        {&h.root_table_offset, m_root_table, sizeof(uint32_t) * ROOT_TABLE_SIZE},
+        {&h.entries_offset, m_entries, sizeof(Entry) * m_entry_count},
+        {&h.phones_offset, m_phones, sizeof(int32_t) * m_phone_count},
+        {&h.tones_offset, m_tones, sizeof(int32_t) * m_phone_count},
+    };
+    uint64_t pos = align_up(sizeof(h));
+    for (auto& s : sections) {
+        *s.offset = pos;
+        pos = align_up(pos + s.bytes);
+    }
+    h.file_size = pos;
+
+    std::vector<char> image(h.file_size, 0);
+    memcpy(image.data(), &h, sizeof(h));
+    for (auto& s : sections) {
+        if (s.bytes > 0)
+            memcpy(image.data() + *s.offset, s.data, s.bytes);
+    }
+
+    // 先写临时文件再rename，正在mmap旧镜像的进程不受影响
+    std::string tmp_filename = image_filename + ".tmp";
+    std::ofstream ofs(tmp_filename, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        printf("Open %s failed!\n", tmp_filename.c_str());
+        return -1;
+    }
+    ofs.write(image.data(), image.size());
+    ofs.close();
+    if (!ofs || 0 != rename(tmp_filename.c_str(), image_filename.c_str())) {
+        printf("Write %s failed!\n", image_filename.c_str());
+        remove(tmp_filename.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int32_t Lexicon::Insert(const std::string& word, const std::vector<int>& phones, const std::vector<int>& tones, bool override) {
+    uint32_t node = 0;
+    size_t i = 0, len;
+    while (i < word.size()) {
+        uint32_t cp = decode_utf8(word.data(), word.size(), i, len);
+        i += len;
+        uint64_t key = (static_cast<uint64_t>(node) << 32) | cp;
+        auto it = m_build_edges.find(key);
+        if (it != m_build_edges.end()) {
+            node = it->second;
+        } else {
+            uint32_t child = m_node_buf.size();
+            m_node_buf.push_back(Node{0, 0, -1});
+            m_build_edges.emplace(key, child);
+            node = child;
+        }
+    }
+
+    if (m_node_buf[node].entry >= 0 && !override)
+        return m_node_buf[node].entry;
+
+    // phone和tone个数不一致时按phone的个数对齐
+    Entry entry{static_cast<uint32_t>(m_phone_buf.size()), static_cast<uint32_t>(phones.size())};
+    m_phone_buf.insert(m_phone_buf.end(), phones.begin(), phones.end());
+    m_tone_buf.insert(m_tone_buf.end(), tones.begin(), tones.end());
+    m_tone_buf.resize(m_phone_buf.size(), 0);
+
+    if (m_node_buf[node].entry >= 0) {
+        m_entry_buf[m_node_buf[node].entry] = entry;
+    } else {
+        m_node_buf[node].entry = m_entry_buf.size();
+        m_entry_buf.push_back(entry);
+    }
+    return m_node_buf[node].entry;
+}
+
+int32_t Lexicon::Find(const std::string& word) const {
+    uint32_t node = 0;
+    size_t i = 0, len;
+    while (i < word.size()) {
+        uint32_t cp = decode_utf8(word.data(), word.size(), i, len);
+        i += len;
+        auto it = m_build_edges.find((static_cast<uint64_t>(node) << 32) | cp);
+        if (it == m_build_edges.end())
+            return -1;
+        node = it->second;
+    }
+    return m_node_buf[node].entry;
+}
+
+void Lexicon::Build() {
+    // (父节点, 码点)排序后，同一节点的子节点连续且按码点有序
+    std::vector<std::pair<uint64_t, uint32_t>> edges(m_build_edges.begin(), m_build_edges.end());
+    std::sort(edges.begin(), edges.end());
+
+    m_edge_key_buf.resize(edges.size());
+    m_edge_node_buf.resize(edges.size());
+    m_root_table_buf.assign(ROOT_TABLE_SIZE, 0);
+    for (size_t i = 0; i < edges.size(); i++) {
+        uint32_t parent = edges[i].first >> 32;
+        uint32_t cp = edges[i].first & 0xFFFFFFFF;
+        m_edge_key_buf[i] = cp;
+        m_edge_node_buf[i] = edges[i].second;
+        Node& node = m_node_buf[parent];
+        if (node.child_count == 0)
+            node.child_begin = i;
+        node.child_count++;
+        if (parent == 0 && cp < ROOT_TABLE_SIZE)
+            m_root_table_buf[cp] = edges[i].second;
+    }
+
+    std::unordered_map<uint64_t, uint32_t>().swap(m_build_edges);
+}
+
+uint32_t Lexicon::Child(uint32_t node, uint32_t cp) const {
+    if (node == 0 && cp < ROOT_TABLE_SIZE)
+        return m_root_table[cp];
+
+    const Node& n = m_nodes[node];
+    const uint32_t* begin = m_edge_keys + n.child_begin;
+    const uint32_t* end = begin + n.child_count;
+    const uint32_t* it = std::lower_bound(begin, end, cp);
+    if (it == end || *it != cp)
+        return 0;
+    return m_edge_nodes[it - m_edge_keys];
+}
+
+void Lexicon::Append(int32_t entry, std::vector<int>& phones, std::vector<int>& tones, std::vector<int>& word2ph) const {
+    const Entry& e = m_entries[entry];
+    phones.insert(phones.end(), m_phones + e.offset, m_phones + e.offset + e.size);
+    tones.insert(tones.end(), m_tones + e.offset, m_tones + e.offset + e.size);
+    word2ph.push_back(e.size);
+}
+
+void Lexicon::convert(const std::string& text, std::vector<int>& phones, std::vector<int>& tones, std::vector<int>& word2ph) const {
+    const char* s = text.data();
+    size_t n = text.size();
+    size_t i = 0;
+    while (i < n) {
+        size_t len;
+        uint32_t cp = decode_utf8(s, n, i, len);
+
+        // 英文单词整体查找，不做前缀匹配
+        if (is_ascii_letter(cp)) {
+            uint32_t node = 0;
+            bool found = true;
+            size_t j = i;
+            while (j < n && is_ascii_letter(static_cast<unsigned char>(s[j]))) {
+                if (found) {
+                    node = Child(node, std::tolower(static_cast<unsigned char>(s[j])));
+                    found = node != 0;
+                }
+                j++;
+            }
+            int32_t entry = found ? m_nodes[node].entry : -1;
+            Append(entry >= 0 ? entry : m_unknown_entry, phones, tones, word2ph);
+            i = j;
+            continue;
+        }
+
+        // 最长匹配，不跨过英文字母
+        uint32_t node = 0;
+        int32_t best = -1;
+        size_t best_end = i + len;
+        size_t j = i;
+        while (j < n) {
+            size_t l;
+            uint32_t c = decode_utf8(s, n, j, l);
+            if (is_ascii_letter(c))
+                break;
+            node = Child(node, map_punctuation(c));
+            if (node == 0)
+                break;
+            j += l;
+            if (m_nodes[node].entry >= 0) {
+                best = m_nodes[node].entry;
+                best_end = j;
+            }
+        }
+        Append(best >= 0 ? best : m_unknown_entry, phones, tones, word2ph);
+        i = best_end;
+    }
+}
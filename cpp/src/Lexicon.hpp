@@ -2,152 +2,88 @@
 
 #include <string>
 #include <vector>
-#include <fstream>
+#include <cstdint>
 #include <unordered_map>
-#include <assert.h>
-
-std::vector<std::string> split (const std::string &s, char delim) {
-    std::vector<std::string> result;
-    std::stringstream ss (s);
-    std::string item;
-    while (getline (ss, item, delim)) {
-        result.push_back (item);
-    }
-    return result;
-}
 
+// 词典：按unicode码点建trie，词条的phone/tone统一存放在一块连续内存里
+// convert时中文等按最长匹配切词，连续的英文字母作为一个单词整体查找(转小写)，
+// 查不到的字符输出"_"
+// lexicon_filename可以是文本词典，也可以是melotts_lexc编译出的二进制镜像，
+// 镜像直接只读mmap，trie原地使用，不再解析也不需要tokens文件
 class Lexicon {
+public:
+    Lexicon(const std::string& lexicon_filename, const std::string& tokens_filename);
+    ~Lexicon();
+
+    Lexicon(const Lexicon&) = delete;
+    Lexicon& operator=(const Lexicon&) = delete;
+
+    // 加载失败(文件打不开、镜像格式或版本不对)时为false
+    bool IsLoaded() const { return m_nodes != nullptr; }
+    bool IsMapped() const { return m_map_addr != nullptr; }
+
+    // 写出二进制镜像，成功返回0
+    int Save(const std::string& image_filename) const;
+
+    // 根据文件头判断是否为二进制镜像
+    static bool IsImage(const std::string& filename);
+
+    // 结果追加到phones/tones/word2ph末尾，word2ph每个元素对应一个匹配到的词
+    void convert(const std::string& text, std::vector<int>& phones, std::vector<int>& tones, std::vector<int>& word2ph) const;
+
+    size_t EntryCount() const { return m_entry_count; }
+
 private:
-    std::unordered_map<std::string, std::pair<std::vector<int>, std::vector<int>>> lexicon;
+    struct Node {
+        uint32_t child_begin;
+        uint32_t child_count;
+        // m_entries的下标，-1表示不是词尾
+        int32_t entry;
+    };
 
-public:
-    Lexicon(const std::string& lexicon_filename, const std::string& tokens_filename) {
-        std::unordered_map<std::string, int> tokens;
-        std::ifstream ifs(tokens_filename);
-        assert(ifs.is_open());
-
-        std::string line;
-        while ( std::getline(ifs, line) ) {
-            auto splitted_line = split(line, ' ');
-            tokens.insert({splitted_line[0], std::stoi(splitted_line[1])});
-        }
-        ifs.close();
-
-        ifs.open(lexicon_filename);
-        assert(ifs.is_open());
-        while ( std::getline(ifs, line) ) {
-            auto splitted_line = split(line, ' ');
-            std::string word_or_phrase = splitted_line[0];
-            size_t phone_tone_len = splitted_line.size() - 1;
-            size_t half_len = phone_tone_len / 2;
-            std::vector<int> phones, tones;
-            for (size_t i = 0; i < phone_tone_len; i++) {
-                auto phone_or_tone = splitted_line[i + 1];
-                if (i < half_len) {
-                    phones.push_back(tokens[phone_or_tone]);
-                } else {
-                    tones.push_back(std::stoi(phone_or_tone));
-                }
-            }
-
-            lexicon.insert({word_or_phrase, std::make_pair(phones, tones)});
-        }
-
-        lexicon["呣"] = lexicon["母"];
-        lexicon["嗯"] = lexicon["恩"];
-
-        const std::vector<std::string> punctuation{"!", "?", "…", ",", ".", "'", "-"};
-        for (auto p : punctuation) {
-            int i = tokens[p];
-            int tone = 0;
-            lexicon[p] = std::make_pair(std::vector<int>{i}, std::vector<int>{tone});
-        }
-        lexicon[" "] = std::make_pair(std::vector<int>{tokens["_"]}, std::vector<int>{0});
-    }
-
-    std::vector<std::string> splitEachChar(const std::string& text)
-    {
-        std::vector<std::string> words;
-        std::string input(text);
-        int len = input.length();
-        int i = 0;
-        
-        while (i < len) {
-        int next = 1;
-        if ((input[i] & 0x80) == 0x00) {
-            // std::cout << "one character: " << input[i] << std::endl;
-        } else if ((input[i] & 0xE0) == 0xC0) {
-            next = 2;
-            // std::cout << "two character: " << input.substr(i, next) << std::endl;
-        } else if ((input[i] & 0xF0) == 0xE0) {
-            next = 3;
-            // std::cout << "three character: " << input.substr(i, next) << std::endl;
-        } else if ((input[i] & 0xF8) == 0xF0) {
-            next = 4;
-            // std::cout << "four character: " << input.substr(i, next) << std::endl;
-        }
-        words.push_back(input.substr(i, next));
-        i += next;
-        }
-        return words;
-    } 
-
-    bool is_english(std::string s) {
-        if (s.size() == 1)
-            return (s[0] >= 'A' && s[0] <= 'Z') || (s[0] >= 'a' && s[0] <= 'z');
-        else
-            return false;
-    }
-
-    std::vector<std::string> merge_english(const std::vector<std::string>& splitted_text) {
-        std::vector<std::string> words;
-        int i = 0;
-        while (i < splitted_text.size()) {
-            std::string s;
-            if (is_english(splitted_text[i])) {
-                while (i < splitted_text.size()) {
-                    if (!is_english(splitted_text[i])) {
-                        break;
-                    }
-                    s += splitted_text[i];
-                    i++;
-                }
-                // to lowercase
-                std::transform(s.begin(), s.end(), s.begin(),
-                    [](unsigned char c){ return std::tolower(c); });
-                words.push_back(s);
-                if (i >= splitted_text.size())
-                    break;
-            }
-            else {
-                words.push_back(splitted_text[i]);
-                i++;
-            }
-        }
-        return words;
-    }
-
-    void convert(const std::string& text, std::vector<int>& phones, std::vector<int>& tones, std::vector<int>& word2ph) {
-        auto splitted_text = splitEachChar(text);
-        auto zh_mix_en = merge_english(splitted_text);
-        for (auto c : zh_mix_en) {
-            std::string s{c};
-            if (s == "，") 
-                s = ",";
-            else if (s == "。")
-                s = ".";
-            else if (s == "！")
-                s = "!";
-            else if (s == "？")
-                s = "?";
-
-            auto phones_and_tones = lexicon[" "];
-            if (lexicon.find(s) != lexicon.end()) {
-                phones_and_tones = lexicon[s];
-            }
-            phones.insert(phones.end(), phones_and_tones.first.begin(), phones_and_tones.first.end());
-            tones.insert(tones.end(), phones_and_tones.second.begin(), phones_and_tones.second.end());
-            word2ph.push_back(phones_and_tones.first.size());
-        }
-    }
-};
\ No newline at end of file
+    struct Entry {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    int LoadText(const std::string& lexicon_filename, const std::string& tokens_filename);
+    int LoadImage(const std::string& image_filename);
+
+    // 返回词条下标，override为false时保留已有的词条
+    int32_t Insert(const std::string& word, const std::vector<int>& phones, const std::vector<int>& tones, bool override);
+
+    // 查找已有词条，没有返回-1
+    int32_t Find(const std::string& word) const;
+
+    // 按码点排好子节点，生成扁平的只读trie
+    void Build();
+
+    // 子节点下标，没有返回0(根节点不可能是子节点)
+    uint32_t Child(uint32_t node, uint32_t cp) const;
+
+    void Append(int32_t entry, std::vector<int>& phones, std::vector<int>& tones, std::vector<int>& word2ph) const;
+
+    // 查找只通过下面的指针，指向自己的vector或者mmap的镜像
+    const Node* m_nodes;
+    const uint32_t* m_edge_keys;
+    const uint32_t* m_edge_nodes;
+    // 根节点的BMP子节点直接查表
+    const uint32_t* m_root_table;
+    const Entry* m_entries;
+    const int32_t* m_phones;
+    const int32_t* m_tones;
+    uint32_t m_node_count, m_edge_count, m_entry_count, m_phone_count;
+    int32_t m_unknown_entry;
+
+    // 文本词典加载时的存储
+    std::vector<Node> m_node_buf;
+    std::vector<uint32_t> m_edge_key_buf, m_edge_node_buf, m_root_table_buf;
+    std::vector<Entry> m_entry_buf;
+    std::vector<int32_t> m_phone_buf, m_tone_buf;
+
+    // 建树时用的边表，key为(父节点 << 32 | 码点)，Build之后清空
+    std::unordered_map<uint64_t, uint32_t> m_build_edges;
+
+    void* m_map_addr;
+    size_t m_map_size;
+};
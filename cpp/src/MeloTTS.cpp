@@ -0,0 +1,655 @@
+#include "MeloTTS.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <sstream>
+#include <condition_variable>
+#include <sys/time.h>
+
+#ifdef MELOTTS_USE_NPU
+#include <ax_sys_api.h>
+#include <ax_engine_api.h>
+#endif
+#include "Decoder.hpp"
+#include "OnnxWrapper.hpp"
+#include "OrtEnv.hpp"
+#include "EncoderPool.hpp"
+#include "Lexicon.hpp"
+#include "split_utils.hpp"
+#include "tts_utils.hpp"
+#include "audio_utils.hpp"
+#include "Resampler.hpp"
+#include "BoundedQueue.hpp"
+#include "Profiler.hpp"
+
+// 开启encoder绑定IO时预分配的phone长度，更长的句子会自动扩大
+static const int ENCODER_BINDING_PHONE_LEN = 512;
+
+static double get_current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// encoder线程交给decoder线程的一句话
+struct EncodedSentence {
+    std::string text;
+    std::vector<int> word2ph;
+    std::vector<int> pronoun_lens;
+    int phone_len;
+    double encoder_ms;
+    std::vector<Ort::Value> encoder_output;
+};
+
+static int read_speaker(const std::string& g_file, std::vector<float>& g) {
+    g.assign(256, 0);
+    FILE* fp = fopen(g_file.c_str(), "rb");
+    if (!fp) {
+        printf("Open %s failed!\n", g_file.c_str());
+        return -1;
+    }
+    fread(g.data(), sizeof(float), g.size(), fp);
+    fclose(fp);
+    return 0;
+}
+
+void MeloTTSConfig::ResolveDefaultPaths() {
+    std::string lower_lang = language;
+    std::transform(language.begin(), language.end(), lower_lang.begin(),
+        [](unsigned char c){ return std::tolower(c); });
+    if (encoder_file.empty()) {
+        encoder_file = "../models/encoder-" + lower_lang + ".onnx";
+    }
+    if (decoder_file.empty()) {
+        if (backend == "mock")
+            decoder_file = "mock:128";
+        else
+            decoder_file = "../models/decoder-" + lower_lang + (backend == "cpu" ? ".onnx" : ".axmodel");
+    }
+    if (g_file.empty()) {
+        if (lower_lang == "zh") {
+            g_file = "../models/g-zh_mix_en.bin";
+        } else {
+            g_file = "../models/g-" + lower_lang + ".bin";
+        }
+    }
+}
+
+MeloTTS::MeloTTS() :
+        m_hasInit(false),
+        m_encoder_load_ms(0),
+        m_decoder_load_ms(0) {}
+
+MeloTTS::~MeloTTS() {}
+
+int MeloTTS::InitSystem() {
+#ifdef MELOTTS_USE_NPU
+    static std::mutex init_mutex;
+    static bool inited = false;
+
+    std::lock_guard<std::mutex> lock(init_mutex);
+    if (inited)
+        return 0;
+
+    int ret = AX_SYS_Init();
+    if (0 != ret) {
+        fprintf(stderr, "AX_SYS_Init failed! ret = 0x%x\n", ret);
+        return -1;
+    }
+
+    AX_ENGINE_NPU_ATTR_T npu_attr;
+    memset(&npu_attr, 0, sizeof(npu_attr));
+    npu_attr.eHardMode = static_cast<AX_ENGINE_NPU_MODE_T>(0);
+    ret = AX_ENGINE_Init(&npu_attr);
+    if (0 != ret) {
+        fprintf(stderr, "Init ax-engine failed{0x%8x}.\n", ret);
+        return -1;
+    }
+
+    inited = true;
+#endif
+    return 0;
+}
+
+int MeloTTS::PrecompileEncoder(const MeloTTSConfig& config) {
+    OrtEnvOptions env_options;
+    env_options.intra_op_threads = config.intra_op_threads;
+    env_options.inter_op_threads = config.inter_op_threads;
+    OrtEnv::Get(env_options);
+
+    double cold_ms, warm_ms;
+    if (0 != OnnxWrapper::Precompile(config.encoder_file, &cold_ms, &warm_ms))
+        return -1;
+    printf("Encoder cache: %s\n", OnnxWrapper::GetCacheFile(config.encoder_file).c_str());
+    printf("  cold load %.2f ms, warm load %.2f ms\n", cold_ms, warm_ms);
+    return 0;
+}
+
+int MeloTTS::Init(const MeloTTSConfig& config) {
+    if (config.slice_planner != "greedy" && config.slice_planner != "optimal") {
+        printf("Unknown slice planner: %s\n", config.slice_planner.c_str());
+        return -1;
+    }
+    if (config.stitch_overlap < 0 || (config.crossfade != "power" && config.crossfade != "linear")) {
+        printf("Invalid stitch overlap %d or crossfade %s\n", config.stitch_overlap, config.crossfade.c_str());
+        return -1;
+    }
+    if (config.backend == "npu" && 0 != InitSystem())
+        return -1;
+
+    m_config = config;
+
+    // Load lexicon
+    m_lexicon.reset(new Lexicon(config.lexicon_file, config.token_file));
+    if (!m_lexicon->IsLoaded()) {
+        printf("Load lexicon failed!\n");
+        return -1;
+    }
+
+    // Read g.bin
+    if (0 != read_speaker(config.g_file, m_g))
+        return -1;
+
+    double start, end;
+
+    start = get_current_time();
+    OrtEnvOptions env_options;
+    env_options.intra_op_threads = config.intra_op_threads;
+    env_options.inter_op_threads = config.inter_op_threads;
+    OrtEnv::Get(env_options);
+    m_encoder_pool.reset(new EncoderPool());
+    if (0 != m_encoder_pool->Init(config.encoder_file, config.encoder_threads,
+                                  config.encoder_io_binding ? ENCODER_BINDING_PHONE_LEN : 0,
+                                  config.encoder_cache)) {
+        printf("encoder init failed!\n");
+        return -1;
+    }
+    end = get_current_time();
+    m_encoder_load_ms = end - start;
+    printf("Load encoder take %.2f ms (%s)\n", m_encoder_load_ms,
+           m_encoder_pool->GetEncoder().IsCacheHit() ? "cached" : "optimized from onnx");
+
+    start = get_current_time();
+    std::vector<std::string> decoder_files;
+    {
+        std::stringstream ss(config.decoder_file);
+        std::string file;
+        while (std::getline(ss, file, ',')) {
+            if (!file.empty())
+                decoder_files.push_back(file);
+        }
+    }
+    if (decoder_files.empty()) {
+        printf("No decoder model!\n");
+        return -1;
+    }
+    m_decoders.clear();
+    for (const std::string& file : decoder_files) {
+        std::unique_ptr<Decoder> decoder(Decoder::Create(config.backend, config.decoder_cached_io));
+        if (!decoder) {
+            printf("Unsupported decoder backend: %s\n", config.backend.c_str());
+            return -1;
+        }
+        if (0 != decoder->Init(file)) {
+            printf("Init decoder model %s failed!\n", file.c_str());
+            return -1;
+        }
+        if (config.decoder_depth > 1 && 0 != decoder->SetDepth(config.decoder_depth) && m_decoders.empty()) {
+            printf("%s decoder does not support depth %d, fall back to 1\n", config.backend.c_str(), config.decoder_depth);
+        }
+        // g在整个进程生命周期内基本不变，只在换说话人时重新拷贝
+        decoder->SetPersistentInput(m_g.data(), 1);
+        m_decoders.push_back(std::move(decoder));
+    }
+    // 按窗口长度从小到大排，z_p通道数都一样，直接比较输入大小
+    std::sort(m_decoders.begin(), m_decoders.end(), [](const std::unique_ptr<Decoder>& a, const std::unique_ptr<Decoder>& b) {
+        return a->GetInputSize(0) < b->GetInputSize(0);
+    });
+    for (size_t b = 1; b < m_decoders.size(); b++) {
+        if (m_decoders[b]->GetInputSize(0) == m_decoders[b - 1]->GetInputSize(0)) {
+            printf("Decoder models have the same window length!\n");
+            return -1;
+        }
+    }
+    // 按帧切片时每片首尾两段淡化区不能重叠
+    if (2 * config.stitch_overlap >= m_decoders.back()->GetOutputSize(0) / (int)sizeof(float) / 512) {
+        printf("Stitch overlap %d frames is too long for the decoder window!\n", config.stitch_overlap);
+        return -1;
+    }
+    // 多个窗口时每个先预热一次，再实测一次推理耗时，作为切片规划和分派的代价
+    m_decoder_costs.assign(m_decoders.size(), 1.0);
+    if (m_decoders.size() > 1) {
+        for (size_t b = 0; b < m_decoders.size(); b++) {
+            Decoder& decoder = *m_decoders[b];
+            if (0 != decoder.RunSync()) {
+                printf("Warm up decoder model failed!\n");
+                return -1;
+            }
+            double run_start = get_current_time();
+            decoder.RunSync();
+            m_decoder_costs[b] = std::max(get_current_time() - run_start, 0.001);
+            printf("Decoder window %d frames: %.2f ms per run\n",
+                   decoder.GetOutputSize(0) / (int)sizeof(float) / 512, m_decoder_costs[b]);
+        }
+    }
+    end = get_current_time();
+    m_decoder_load_ms = end - start;
+    printf("Load %zu %s decoder take %.2f ms\n", m_decoders.size(), config.backend.c_str(), m_decoder_load_ms);
+
+    m_hasInit = true;
+    return 0;
+}
+
+int MeloTTS::SetSpeaker(const std::string& g_file) {
+    if (!m_hasInit)
+        return -1;
+
+    std::vector<float> g;
+    if (0 != read_speaker(g_file, g))
+        return -1;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_g.swap(g);
+    m_config.g_file = g_file;
+    for (auto& decoder : m_decoders) {
+        if (0 != decoder->SetPersistentInput(m_g.data(), 1))
+            return -1;
+    }
+    return 0;
+}
+
+int MeloTTS::Synthesize(const std::string& text, const SynthesizeOptions& options,
+                        std::vector<float>& audio, SynthesizeStats* stats) {
+    CallbackSink sink([&audio](const float* samples, size_t num) {
+        audio.insert(audio.end(), samples, samples + num);
+        return 0;
+    });
+    return Synthesize(text, options, &sink, stats);
+}
+
+int MeloTTS::Synthesize(const std::string& text, const SynthesizeOptions& options,
+                        AudioSink* sink, SynthesizeStats* stats) {
+    if (!m_hasInit || !sink)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PROFILE_SCOPE(PROFILE_SYNTHESIZE);
+
+    // 需要其他采样率时在sink前面接一个重采样，滤波器状态跨片保留
+    ResampleSink resample_sink(sink);
+    if (options.sample_rate > 0 && options.sample_rate != GetSampleRate()) {
+        if (0 != resample_sink.Init(GetSampleRate(), options.sample_rate))
+            return -1;
+        sink = &resample_sink;
+    }
+
+    Lexicon& lexicon = *m_lexicon;
+    EncoderPool& encoder_pool = *m_encoder_pool;
+    std::vector<float>& g = m_g;
+
+    float noise_scale   = options.noise_scale;
+    float length_scale  = 1.0 / options.speed;
+    float noise_scale_w = options.noise_scale_w;
+    float sdp_ratio     = options.sdp_ratio;
+
+    // Split sentences
+    SplitResult sens;
+    {
+        PROFILE_SCOPE(PROFILE_SPLIT);
+        split_sentence(text, sens, 10, m_config.language);
+    }
+
+    // 两级流水线：编码线程负责前端+encoder，调用线程负责decoder
+    // 第N句在NPU上decode的同时，CPU已经在encode第N+1句
+    BoundedQueue<EncodedSentence> encoded_queue(m_config.pipeline_depth);
+    bool encoder_failed = false;
+    double encoder_busy = 0;
+    double pipeline_start = get_current_time();
+    for (auto& decoder : m_decoders) {
+        decoder->ResetRunMs();
+        decoder->ResetInputCopyStats();
+    }
+
+    // 编码线程按句子顺序把结果交给decoder，encoder池并发跑后面几句的前端和encoder，
+    // 最多领先pipeline_depth + 池大小句
+    std::thread encoder_thread([&]() {
+        size_t num = sens.size();
+        size_t window = m_config.pipeline_depth + encoder_pool.GetPoolSize();
+        std::vector<EncodedSentence> encoded(num);
+        std::vector<char> done(num, 0);
+        size_t submitted = 0, finished = 0;
+        bool cancelled = false;
+        std::mutex done_mutex;
+        std::condition_variable done_cond;
+
+        auto encode = [&](size_t n, OnnxWrapper& encoder, EncoderBinding* binding) {
+            double stage_start = get_current_time();
+            EncodedSentence& item = encoded[n];
+            bool ok = true;
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                ok = !cancelled;
+            }
+            if (ok) {
+                item.text = sens.sentence(n);
+
+                std::vector<int> phones, tones, langids;
+                {
+                    PROFILE_SCOPE(PROFILE_FRONTEND);
+                    // Convert sentence to phones and tones
+                    std::vector<int> phones_bef, tones_bef;
+                    lexicon.convert(item.text, phones_bef, tones_bef, item.word2ph);
+
+                    // Add blank between words
+                    phones = intersperse(phones_bef, 0);
+                    tones = intersperse(tones_bef, 0);
+                    for (int& i : item.word2ph) {
+                        i *= 2;
+                    }
+                    if (!item.word2ph.empty())
+                        item.word2ph[0] += 1;
+
+                    item.phone_len = phones.size();
+
+                    langids.assign(item.phone_len, 3);
+                }
+
+                // Run encoder
+                double enc_start = get_current_time();
+                try {
+                    if (binding) {
+                        auto& outputs = encoder.RunBound(*binding, phones, tones, langids, g, noise_scale, noise_scale_w, length_scale, sdp_ratio);
+                        item.encoder_output.clear();
+                        for (auto& value : outputs)
+                            item.encoder_output.push_back(std::move(value));
+                    }
+                    else
+                        item.encoder_output = encoder.Run(phones, tones, langids, g, noise_scale, noise_scale_w, length_scale, sdp_ratio);
+                    // 绑定IO时pronoun_lens在binding的buffer里，下一句会覆盖，先拷出来
+                    const int* pronoun_lens_data = item.encoder_output.at(1).GetTensorData<int>();
+                    item.pronoun_lens.assign(pronoun_lens_data, pronoun_lens_data + item.phone_len);
+                } catch (const Ort::Exception& e) {
+                    printf("Encoder exception: %s\n", e.what());
+                    ok = false;
+                }
+                item.encoder_ms = get_current_time() - enc_start;
+                PROFILE_RECORD_MS(PROFILE_ENCODER, item.encoder_ms);
+            }
+
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (!ok && !cancelled)
+                encoder_failed = true;
+            encoder_busy += get_current_time() - stage_start;
+            done[n] = 1;
+            finished++;
+            done_cond.notify_all();
+        };
+
+        for (size_t n = 0; n < num; n++) {
+            while (submitted < num && submitted < n + window) {
+                size_t k = submitted++;
+                encoder_pool.Submit([&encode, k](OnnxWrapper& encoder, EncoderBinding* binding) { encode(k, encoder, binding); });
+            }
+            {
+                std::unique_lock<std::mutex> lock(done_mutex);
+                done_cond.wait(lock, [&] { return done[n] != 0; });
+                if (encoder_failed)
+                    break;
+            }
+            if (!encoded_queue.Push(std::move(encoded[n])))
+                break;
+        }
+
+        // 提前结束时跳过还没开始的句子，等已提交的task结束后才能释放encoded
+        std::unique_lock<std::mutex> lock(done_mutex);
+        cancelled = true;
+        done_cond.wait(lock, [&] { return finished == submitted; });
+        lock.unlock();
+        encoded_queue.Close();
+    });
+
+    double decoder_busy = 0;
+    double first_audio_time = 0;
+    size_t total_samples = 0;
+    size_t total_slices = 0;
+    size_t useful_frames = 0, decoded_frames = 0;
+    double ms_saved = 0;
+    const bool optimal_slices = m_config.slice_planner == "optimal";
+    const int stitch_overlap = m_config.stitch_overlap;
+    CrossfadeStitcher stitcher(512 * stitch_overlap, m_config.crossfade == "power");
+    size_t copy_bytes = 0;
+    int ret_code = 0;
+    EncodedSentence item;
+    while (encoded_queue.Pop(item)) {
+        PROFILE_SCOPE(PROFILE_SENTENCE);
+        double stage_start = get_current_time();
+        printf("\nSplit sentence: %s\n", item.text.c_str());
+
+        auto& encoder_output = item.encoder_output;
+        float* zp_data = encoder_output.at(0).GetTensorMutableData<float>();
+        auto zp_info = encoder_output.at(0).GetTensorTypeAndShapeInfo();
+        auto zp_shape = zp_info.GetShape();
+        const std::vector<int>& pronoun_lens = item.pronoun_lens;
+        const auto& word2ph = item.word2ph;
+
+        // 各decoder窗口的dec_len，从小到大
+        std::vector<SliceBucket> buckets;
+        for (size_t b = 0; b < m_decoders.size(); b++)
+            buckets.emplace_back(m_decoders[b]->GetInputSize(0) / sizeof(float) / zp_shape[1], m_decoder_costs[b]);
+        // 后端不提供buffer视图时才需要的中转buffer
+        std::vector<float> decoder_output, zp_slice;
+
+        // Generate pronoun slices for better effect
+        std::vector<int> word2pronoun;
+        std::pair<std::vector<Slice>, std::vector<Slice>> dec_slices;
+        {
+            PROFILE_SCOPE(PROFILE_SLICE_PLAN);
+            word2pronoun = calc_word2pronoun(word2ph, pronoun_lens);
+            if (stitch_overlap > 0) {
+                // 按帧切片，只用到z_p上的切片
+                int total_frames = std::accumulate(word2pronoun.begin(), word2pronoun.end(), 0);
+                dec_slices.second = optimal_slices ? plan_frame_slices_optimal(total_frames, buckets, stitch_overlap)
+                                                   : generate_frame_slices(total_frames, buckets.back().len, stitch_overlap);
+            } else {
+                dec_slices = optimal_slices ? plan_slices_optimal(word2pronoun, buckets)
+                                            : generate_slices(word2pronoun, buckets.back().len);
+            }
+        }
+        stitcher.Reset();
+
+        size_t dec_slice_num = dec_slices.second.size();
+        // 每片分派给能放下它的最小窗口
+        std::vector<int> slice_buckets(dec_slice_num);
+        for (size_t i = 0; i < dec_slice_num; i++)
+            slice_buckets[i] = pick_bucket(buckets, dec_slices.second[i].end - dec_slices.second[i].start);
+
+        auto write_audio = [&](const float* audio, size_t num) -> int {
+            if (first_audio_time == 0) {
+                first_audio_time = get_current_time();
+                PROFILE_RECORD_MS(PROFILE_FIRST_AUDIO, first_audio_time - pipeline_start);
+            }
+            PROFILE_SCOPE(PROFILE_AUDIO_WRITE);
+            if (0 != sink->Write(audio, num)) {
+                printf("Write audio failed!\n");
+                return -1;
+            }
+            total_samples += num;
+            return 0;
+        };
+
+        // 处理overlap后写出第i片的音频
+        auto write_slice = [&](size_t i, const float* audio) -> int {
+            const Slice& zs = dec_slices.second[i];
+            int actual_size = std::min(zs.end - zs.start, buckets[slice_buckets[i]].len);
+
+            // 输出音频的长度
+            int sub_audio_len = 512 * actual_size;
+            if (stitch_overlap > 0)
+                return stitcher.Push(audio, sub_audio_len, i + 1 == dec_slice_num, write_audio);
+
+            const Slice& ps = dec_slices.first[i];
+
+            int audio_start = 0;
+            if (i > 0)
+                if (dec_slices.first[i - 1].end > ps.start)
+                    // 去掉第一个字
+                    audio_start = 512 * word2pronoun[ps.start];
+
+            int audio_end = sub_audio_len;
+            if (i < dec_slices.first.size() - 1)
+                if (ps.end > dec_slices.first[i + 1].start)
+                    // 去掉最后一个字
+                    audio_end = sub_audio_len - 512 * word2pronoun[ps.end - 1];
+
+            return write_audio(audio + audio_start, audio_end - audio_start);
+        };
+
+        // Iteratively run decoder
+        // 每个窗口最多depth片同时提交，第i片在NPU上跑时CPU打包第i+1片、拼接第i-1片
+        std::vector<std::vector<int>> free_slots(m_decoders.size());
+        for (size_t b = 0; b < m_decoders.size(); b++) {
+            for (int slot = m_decoders[b]->GetDepth() - 1; slot >= 0; slot--)
+                free_slots[b].push_back(slot);
+        }
+        // 按提交顺序等待，同一个decoder的Wait本身也按提交顺序返回
+        std::deque<size_t> in_flight;
+
+        auto finish_one = [&]() -> int {
+            int slot;
+            size_t i = in_flight.front();
+            in_flight.pop_front();
+            Decoder& decoder_model = *m_decoders[slice_buckets[i]];
+            int ret;
+            {
+                PROFILE_SCOPE(PROFILE_DECODER_WAIT);
+                ret = decoder_model.Wait(slot);
+            }
+            free_slots[slice_buckets[i]].push_back(slot);
+            if (0 != ret) {
+                printf("Run decoder model failed!\n");
+                return -1;
+            }
+            if (ret_code != 0)
+                return -1;
+            // 直接从输出buffer拼接，slot在下次提交前不会被覆盖
+            auto audio_view = decoder_model.GetOutputView<float>(0, slot);
+            if (audio_view.empty()) {
+                int audio_slice_len = decoder_model.GetOutputSize(0) / sizeof(float);
+                decoder_output.resize(audio_slice_len);
+                decoder_model.GetOutput(decoder_output.data(), 0, slot);
+                copy_bytes += audio_slice_len * sizeof(float);
+                return write_slice(i, decoder_output.data());
+            }
+            return write_slice(i, audio_view.data);
+        };
+
+        for (size_t i = 0; i < dec_slice_num; i++) {
+            const int b = slice_buckets[i];
+            Decoder& decoder_model = *m_decoders[b];
+            const int dec_len = buckets[b].len;
+            while (free_slots[b].empty() && ret_code == 0) {
+                if (0 != finish_one())
+                    ret_code = -1;
+            }
+            if (ret_code != 0)
+                break;
+            int slot = free_slots[b].back();
+            free_slots[b].pop_back();
+
+            {
+                PROFILE_SCOPE(PROFILE_SLICE_COPY);
+                // z_p每个通道的片段直接写进输入buffer，不足dec_len的部分补0
+                auto zp_view = decoder_model.GetInputView<float>(0, slot);
+                int zp_size = dec_len * zp_shape[1];
+                if (zp_view.empty())
+                    zp_slice.resize(zp_size);
+                float* zp_dst = zp_view.empty() ? zp_slice.data() : zp_view.data;
+
+                const Slice& zs = dec_slices.second[i];
+                int actual_size = std::min(zs.end - zs.start, dec_len);
+                for (int n = 0; n < zp_shape[1]; n++) {
+                    memcpy(zp_dst + n * dec_len, zp_data + n * zp_shape[2] + zs.start, sizeof(float) * actual_size);
+                    memset(zp_dst + n * dec_len + actual_size, 0, sizeof(float) * (dec_len - actual_size));
+                }
+                copy_bytes += sizeof(float) * actual_size * zp_shape[1];
+
+                if (zp_view.empty()) {
+                    decoder_model.SetInput(zp_slice.data(), 0, slot);
+                    copy_bytes += zp_size * sizeof(float);
+                }
+            }
+            if (0 != decoder_model.Submit(slot)) {
+                printf("Submit decoder model failed!\n");
+                free_slots[b].push_back(slot);
+                ret_code = -1;
+                break;
+            }
+            in_flight.push_back(i);
+        }
+        // 出错时也要等已提交的跑完，slot才能复用
+        while (!in_flight.empty()) {
+            if (0 != finish_one())
+                ret_code = -1;
+        }
+
+        total_slices += dec_slice_num;
+        useful_frames += std::accumulate(word2pronoun.begin(), word2pronoun.end(), 0);
+        for (int b : slice_buckets) {
+            decoded_frames += buckets[b].len;
+            ms_saved += buckets.back().cost - buckets[b].cost;
+        }
+        decoder_busy += get_current_time() - stage_start;
+
+        if (ret_code != 0) {
+            encoded_queue.Close();
+            break;
+        }
+    }
+    encoder_thread.join();
+
+    double pipeline_ms = get_current_time() - pipeline_start;
+    if (encoder_failed) {
+        printf("Run encoder failed!\n");
+        return -1;
+    }
+    if (ret_code != 0)
+        return ret_code;
+    if (sink == &resample_sink && 0 != resample_sink.Flush()) {
+        printf("Write audio failed!\n");
+        return -1;
+    }
+
+    if (stats) {
+        stats->sentences = sens.size();
+        stats->samples = total_samples;
+        stats->total_ms = pipeline_ms;
+        stats->first_audio_ms = first_audio_time > 0 ? first_audio_time - pipeline_start : 0;
+        stats->encoder_busy_ms = encoder_busy;
+        stats->decoder_busy_ms = decoder_busy;
+        stats->encoder_blocked_ms = encoded_queue.PushWaitMs();
+        stats->decoder_blocked_ms = encoded_queue.PopWaitMs();
+        stats->decoder_run_ms = 0;
+        stats->decoder_slices = total_slices;
+        stats->decoder_useful_frames = useful_frames;
+        stats->decoder_frames = decoded_frames;
+        stats->decoder_ms_saved = m_decoders.size() > 1 ? ms_saved : 0;
+        stats->decoder_copy_bytes = copy_bytes;
+        stats->decoder_copies_avoided = 0;
+        stats->decoder_bytes_avoided = 0;
+        for (auto& decoder : m_decoders) {
+            const InputCopyStats& input_stats = decoder->GetInputCopyStats();
+            stats->decoder_run_ms += decoder->GetRunMs();
+            stats->decoder_copy_bytes += input_stats.upload_bytes;
+            stats->decoder_copies_avoided += input_stats.skipped;
+            stats->decoder_bytes_avoided += input_stats.skipped_bytes;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "AudioSink.hpp"
+
+class Lexicon;
+class EncoderPool;
+class Decoder;
+
+// 模型路径等只在加载时用到的配置
+struct MeloTTSConfig {
+    std::string encoder_file;
+    // 可以用逗号分隔多个窗口长度(dec_len)不同的decoder，每片分派给能放下它的最小窗口
+    std::string decoder_file;
+    std::string lexicon_file;
+    std::string token_file;
+    std::string g_file;
+    std::string language = "ZH";
+
+    // decoder后端：npu跑decoder.axmodel，cpu用onnxruntime跑decoder.onnx，mock不跑模型只模拟耗时
+    std::string backend = "npu";
+
+    // encoder线程最多领先decoder多少句
+    int pipeline_depth = 2;
+
+    // 同时编码的句子数，>1时一段话的后几句由encoder池在多个核上并发编码
+    int encoder_threads = 1;
+
+    // encoder使用IoBinding，输入输出buffer预分配并复用
+    bool encoder_io_binding = false;
+
+    // 图优化后的encoder缓存在encoder_file旁边，之后启动跳过图优化
+    bool encoder_cache = true;
+
+    // onnxruntime全局线程池的intra-op/inter-op线程数，进程内第一个Init的配置生效
+    int intra_op_threads = 1;
+    int inter_op_threads = 1;
+
+    // decoder同时在飞的切片数，>1时打包下一片、拼接上一片与NPU推理重叠
+    int decoder_depth = 2;
+
+    // npu decoder的输入输出使用cached CMM，CPU打包z_p、读取音频更快
+    bool decoder_cached_io = false;
+
+    // decoder切片方式：greedy为原来的贪心切片，optimal按最少decoder代价做动态规划(多窗口时按各窗口实测耗时)
+    std::string slice_planner = "greedy";
+
+    // >0时decoder直接按z_p帧切片，相邻两片重叠stitch_overlap帧并交叉淡化拼接；
+    // 0为按词切片，重叠两个整词后直接裁掉
+    int stitch_overlap = 0;
+
+    // 交叉淡化曲线：power为等功率(sin/cos)，linear为等增益
+    std::string crossfade = "power";
+
+    // 按language和backend补全未指定的encoder/decoder/g路径
+    void ResolveDefaultPaths();
+};
+
+// 每次合成可以不同的参数
+struct SynthesizeOptions {
+    float speed = 0.8f;
+    float noise_scale = 0.3f;
+    float noise_scale_w = 0.6f;
+    float sdp_ratio = 0.2f;
+    // 输出采样率，0或与decoder相同(44100)时不重采样，否则在流水线内按片重采样后再写入sink
+    int sample_rate = 0;
+};
+
+// 一次合成的耗时统计，单位ms
+struct SynthesizeStats {
+    size_t sentences = 0;
+    // decoder输出的采样数(44.1kHz，重采样前)
+    size_t samples = 0;
+    double total_ms = 0;
+    double first_audio_ms = 0;
+    double encoder_busy_ms = 0;
+    double decoder_busy_ms = 0;
+    double encoder_blocked_ms = 0;
+    double decoder_blocked_ms = 0;
+    // decoder后端实际推理的时间，除以total_ms即NPU占用率
+    double decoder_run_ms = 0;
+    // decoder切片数，以及打包输入、取输出时CPU拷贝的字节数
+    size_t decoder_slices = 0;
+    // 句子的有效帧数与decoder实际计算的帧数(各片窗口的dec_len之和)，两者之比为切片效率
+    size_t decoder_useful_frames = 0;
+    size_t decoder_frames = 0;
+    // 多个decoder窗口时，与每片都用最大窗口相比估计省下的推理时间
+    double decoder_ms_saved = 0;
+    size_t decoder_copy_bytes = 0;
+    // 常驻输入(g)没有变化而省掉的拷贝
+    size_t decoder_copies_avoided = 0;
+    size_t decoder_bytes_avoided = 0;
+};
+
+// MeloTTS推理引擎：模型只在Init时加载一次，之后可以反复调用Synthesize
+// 同一个实例的Synthesize是串行的，需要并发请多建几个实例
+class MeloTTS {
+public:
+    MeloTTS();
+    ~MeloTTS();
+
+    // 初始化AX_SYS和AX_ENGINE，进程内只做一次，npu后端Init时会自动调用
+    static int InitSystem();
+
+    int Init(const MeloTTSConfig& config);
+
+    // 离线生成encoder缓存并打印冷/热加载时间，不需要Init
+    static int PrecompileEncoder(const MeloTTSConfig& config);
+
+    // 换说话人，重新读取g.bin，decoder在下一次运行前才会拷贝新的g
+    int SetSpeaker(const std::string& g_file);
+
+    // 合成整段音频
+    int Synthesize(const std::string& text, const SynthesizeOptions& options,
+                   std::vector<float>& audio, SynthesizeStats* stats = nullptr);
+
+    // 流式合成，每段decoder输出裁剪后立即写入sink，sink需已Open
+    int Synthesize(const std::string& text, const SynthesizeOptions& options,
+                   AudioSink* sink, SynthesizeStats* stats = nullptr);
+
+    // decoder输出的采样率
+    int GetSampleRate() const { return 44100; }
+
+    const MeloTTSConfig& GetConfig() const { return m_config; }
+
+    double GetEncoderLoadMs() const { return m_encoder_load_ms; }
+    double GetDecoderLoadMs() const { return m_decoder_load_ms; }
+
+private:
+    MeloTTS(const MeloTTS&) = delete;
+    MeloTTS& operator=(const MeloTTS&) = delete;
+
+    bool m_hasInit;
+    MeloTTSConfig m_config;
+    std::unique_ptr<Lexicon> m_lexicon;
+    std::unique_ptr<EncoderPool> m_encoder_pool;
+    // 按窗口长度从小到大排列，m_decoder_costs为各自单次推理的实测耗时
+    std::vector<std::unique_ptr<Decoder>> m_decoders;
+    std::vector<double> m_decoder_costs;
+    std::vector<float> m_g;
+    double m_encoder_load_ms, m_decoder_load_ms;
+    std::mutex m_mutex;
+};
@@ -0,0 +1,78 @@
+#include "MockDecoder.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+// 与decoder.axmodel一致的z_p通道数、g长度和每帧的采样数
+static const int MOCK_ZP_CHANNELS = 192;
+static const int MOCK_G_LEN = 256;
+static const int MOCK_SAMPLES_PER_FRAME = 512;
+// 每次推理的固定开销
+static const int MOCK_FIXED_US = 500;
+
+int MockDecoder::Init(const std::string& model_file) {
+    if (!IsMockFile(model_file)) {
+        printf("mock decoder model should be mock:<dec_len>[:<us_per_frame>], got %s\n", model_file.c_str());
+        return -1;
+    }
+    char* end = nullptr;
+    m_dec_len = strtol(model_file.c_str() + 5, &end, 10);
+    m_us_per_frame = 50;
+    if (*end == ':')
+        m_us_per_frame = strtol(end + 1, &end, 10);
+    if (m_dec_len <= 0 || m_us_per_frame < 0 || *end != '\0') {
+        printf("Invalid mock decoder: %s\n", model_file.c_str());
+        return -1;
+    }
+
+    m_inputs.resize(2);
+    m_inputs[0].assign(MOCK_ZP_CHANNELS * m_dec_len, 0);
+    m_inputs[1].assign(MOCK_G_LEN, 0);
+    m_outputs.resize(1);
+    m_outputs[0].assign(m_dec_len * MOCK_SAMPLES_PER_FRAME, 0);
+    return 0;
+}
+
+int MockDecoder::SetInput(void* pInput, int index, int slot) {
+    if (slot != 0 || index < 0 || index >= (int)m_inputs.size())
+        return -1;
+    memcpy(m_inputs[index].data(), pInput, m_inputs[index].size() * sizeof(float));
+    return 0;
+}
+
+int MockDecoder::RunSync() {
+    if (m_inputs.empty())
+        return -1;
+    if (0 != SyncPersistentInputs(0))
+        return -1;
+
+    auto start = std::chrono::steady_clock::now();
+    const float* zp = m_inputs[0].data();
+    float* audio = m_outputs[0].data();
+    for (int t = 0; t < m_dec_len; t++) {
+        float sum = 0;
+        for (int c = 0; c < MOCK_ZP_CHANNELS; c++)
+            sum += zp[c * m_dec_len + t];
+        float mean = sum / MOCK_ZP_CHANNELS;
+        for (int k = 0; k < MOCK_SAMPLES_PER_FRAME; k++)
+            audio[t * MOCK_SAMPLES_PER_FRAME + k] = mean;
+    }
+    std::this_thread::sleep_until(start + std::chrono::microseconds(MOCK_FIXED_US + m_dec_len * m_us_per_frame));
+    return 0;
+}
+
+int MockDecoder::GetOutput(void* pOutput, int index, int slot) {
+    if (slot != 0 || index < 0 || index >= (int)m_outputs.size())
+        return -1;
+    memcpy(pOutput, m_outputs[index].data(), m_outputs[index].size() * sizeof(float));
+    return 0;
+}
+
+int MockDecoder::Release() {
+    m_inputs.clear();
+    m_outputs.clear();
+    return 0;
+}
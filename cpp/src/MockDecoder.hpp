@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Decoder.hpp"
+
+// 不加载模型的假decoder，没有NPU的x86上验证切片、多窗口分派和拼接逻辑。
+// model_file写成"mock:<dec_len>[:<us_per_frame>]"，输入输出shape与decoder.axmodel一致，
+// 每次推理按固定开销 + dec_len * us_per_frame模拟NPU耗时，
+// 输出第t帧的512个采样都等于z_p第t帧在各通道上的均值，拼接错位时能直接从音频看出来
+class MockDecoder : public Decoder {
+public:
+    MockDecoder() :
+            m_dec_len(0),
+            m_us_per_frame(0) {}
+
+    int Init(const std::string& model_file) override;
+
+    int SetInput(void* pInput, int index, int slot = 0) override;
+
+    int RunSync() override;
+
+    int GetOutput(void* pOutput, int index, int slot = 0) override;
+
+    int GetInputSize(int index) override {
+        return m_inputs[index].size() * sizeof(float);
+    }
+
+    int GetOutputSize(int index) override {
+        return m_outputs[index].size() * sizeof(float);
+    }
+
+    void* GetInputPtr(int index, int slot = 0) override {
+        return slot == 0 && index >= 0 && index < (int)m_inputs.size() ? m_inputs[index].data() : nullptr;
+    }
+
+    void* GetOutputPtr(int index, int slot = 0) override {
+        return slot == 0 && index >= 0 && index < (int)m_outputs.size() ? m_outputs[index].data() : nullptr;
+    }
+
+    int Release() override;
+
+    // 是否是mock decoder的model_file
+    static bool IsMockFile(const std::string& model_file) {
+        return model_file.compare(0, 5, "mock:") == 0;
+    }
+
+private:
+    int m_dec_len;
+    int m_us_per_frame;
+    std::vector<std::vector<float>> m_inputs, m_outputs;
+};
@@ -0,0 +1,135 @@
+#include "OnnxDecoder.hpp"
+#include "OrtEnv.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+// decoder.onnx导出时z_p/g/audio都是固定shape，直接按shape预分配输入输出
+static int get_static_shape(Ort::TypeInfo type_info, const std::string& name, std::vector<int64_t>& shape, size_t& count) {
+    auto tensor_info = type_info.GetTensorTypeAndShapeInfo();
+    if (tensor_info.GetElementType() != ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+        printf("decoder tensor %s is not float!\n", name.c_str());
+        return -1;
+    }
+    shape = tensor_info.GetShape();
+    count = 1;
+    for (auto dim : shape) {
+        if (dim <= 0) {
+            printf("decoder tensor %s has dynamic shape!\n", name.c_str());
+            return -1;
+        }
+        count *= dim;
+    }
+    return 0;
+}
+
+int OnnxDecoder::Init(const std::string& model_file) {
+    Ort::SessionOptions session_options;
+    // decoder计算量大，不用全局线程池，intra op线程数交给onnxruntime按物理核数决定
+    session_options.SetIntraOpNumThreads(0);
+    session_options.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
+
+    try {
+        m_session = new Ort::Session(OrtEnv::Get(), model_file.c_str(), session_options);
+    } catch (const Ort::Exception& e) {
+        printf("Load %s failed! %s\n", model_file.c_str(), e.what());
+        return -1;
+    }
+
+    Ort::AllocatorWithDefaultOptions allocator;
+    size_t input_num = m_session->GetInputCount();
+    size_t output_num = m_session->GetOutputCount();
+    if (input_num != 2 || output_num < 1) {
+        printf("decoder %s should have inputs z_p, g and output audio!\n", model_file.c_str());
+        Release();
+        return -1;
+    }
+
+    m_input_shapes.resize(input_num);
+    m_inputs.resize(input_num);
+    for (size_t i = 0; i < input_num; i++) {
+        m_input_names.emplace_back(m_session->GetInputNameAllocated(i, allocator).get());
+        size_t count;
+        if (0 != get_static_shape(m_session->GetInputTypeInfo(i), m_input_names[i], m_input_shapes[i], count)) {
+            Release();
+            return -1;
+        }
+        m_inputs[i].assign(count, 0);
+    }
+
+    m_output_shapes.resize(output_num);
+    m_outputs.resize(output_num);
+    for (size_t i = 0; i < output_num; i++) {
+        m_output_names.emplace_back(m_session->GetOutputNameAllocated(i, allocator).get());
+        size_t count;
+        if (0 != get_static_shape(m_session->GetOutputTypeInfo(i), m_output_names[i], m_output_shapes[i], count)) {
+            Release();
+            return -1;
+        }
+        m_outputs[i].assign(count, 0);
+    }
+
+    m_hasInit = true;
+    return 0;
+}
+
+int OnnxDecoder::SetInput(void* pInput, int index, int slot) {
+    if (slot != 0 || index < 0 || index >= (int)m_inputs.size())
+        return -1;
+    memcpy(m_inputs[index].data(), pInput, m_inputs[index].size() * sizeof(float));
+    return 0;
+}
+
+int OnnxDecoder::RunSync() {
+    if (!m_hasInit)
+        return -1;
+    if (0 != SyncPersistentInputs(0))
+        return -1;
+
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    std::vector<const char*> input_names, output_names;
+    std::vector<Ort::Value> input_vals, output_vals;
+    for (size_t i = 0; i < m_inputs.size(); i++) {
+        input_names.push_back(m_input_names[i].c_str());
+        input_vals.emplace_back(Ort::Value::CreateTensor<float>(memory_info, m_inputs[i].data(), m_inputs[i].size(),
+                                                                m_input_shapes[i].data(), m_input_shapes[i].size()));
+    }
+    // 输出直接写进预分配的buffer，省一次拷贝
+    for (size_t i = 0; i < m_outputs.size(); i++) {
+        output_names.push_back(m_output_names[i].c_str());
+        output_vals.emplace_back(Ort::Value::CreateTensor<float>(memory_info, m_outputs[i].data(), m_outputs[i].size(),
+                                                                 m_output_shapes[i].data(), m_output_shapes[i].size()));
+    }
+
+    try {
+        m_session->Run(Ort::RunOptions{nullptr}, input_names.data(), input_vals.data(), input_vals.size(),
+                       output_names.data(), output_vals.data(), output_vals.size());
+    } catch (const Ort::Exception& e) {
+        printf("Run decoder onnx failed! %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
+
+int OnnxDecoder::GetOutput(void* pOutput, int index, int slot) {
+    if (slot != 0 || index < 0 || index >= (int)m_outputs.size())
+        return -1;
+    memcpy(pOutput, m_outputs[index].data(), m_outputs[index].size() * sizeof(float));
+    return 0;
+}
+
+int OnnxDecoder::Release() {
+    if (m_session) {
+        delete m_session;
+        m_session = nullptr;
+    }
+    m_input_names.clear();
+    m_output_names.clear();
+    m_input_shapes.clear();
+    m_output_shapes.clear();
+    m_inputs.clear();
+    m_outputs.clear();
+    m_hasInit = false;
+    return 0;
+}
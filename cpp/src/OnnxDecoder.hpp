@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "onnxruntime_cxx_api.h"
+#include "Decoder.hpp"
+
+// 用onnxruntime CPU跑decoder.onnx，没有NPU的机器上也能跑通整条流水线，
+// 也可以作为NPU输出的对照
+class OnnxDecoder : public Decoder {
+public:
+    OnnxDecoder() :
+            m_hasInit(false),
+            m_session(nullptr) {}
+
+    ~OnnxDecoder() {
+        Release();
+    }
+
+    int Init(const std::string& model_file) override;
+
+    int SetInput(void* pInput, int index, int slot = 0) override;
+
+    int RunSync() override;
+
+    int GetOutput(void* pOutput, int index, int slot = 0) override;
+
+    int GetInputSize(int index) override {
+        return m_inputs[index].size() * sizeof(float);
+    }
+
+    int GetOutputSize(int index) override {
+        return m_outputs[index].size() * sizeof(float);
+    }
+
+    void* GetInputPtr(int index, int slot = 0) override {
+        return slot == 0 && index >= 0 && index < (int)m_inputs.size() ? m_inputs[index].data() : nullptr;
+    }
+
+    void* GetOutputPtr(int index, int slot = 0) override {
+        return slot == 0 && index >= 0 && index < (int)m_outputs.size() ? m_outputs[index].data() : nullptr;
+    }
+
+    int Release() override;
+
+private:
+    bool m_hasInit;
+    Ort::Session* m_session;
+    std::vector<std::string> m_input_names, m_output_names;
+    std::vector<std::vector<int64_t>> m_input_shapes, m_output_shapes;
+    std::vector<std::vector<float>> m_inputs, m_outputs;
+};
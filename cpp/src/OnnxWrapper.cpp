@@ -1,14 +1,56 @@
 #include "OnnxWrapper.hpp"
+#include "OrtEnv.hpp"
+#include "onnxruntime_session_options_config_keys.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 
-int OnnxWrapper::Init(const std::string& model_file) {
-    // set ort env
-    m_ort_env = Ort::Env(ORT_LOGGING_LEVEL_ERROR, model_file.c_str());
-    // 0. session options
+// Run的参数和输出顺序，只用来在session里查找，实际用的名字取自session
+static const char* const kInputNames[] = {"phone", "tone", "language", "g", "noise_scale", "noise_scale_w", "length_scale", "sdp_ratio"};
+static const char* const kOutputNames[] = {"z_p", "pronoun_lens", "audio_len"};
+static const int kInputNum = sizeof(kInputNames) / sizeof(kInputNames[0]);
+static const int kOutputNum = sizeof(kOutputNames) / sizeof(kOutputNames[0]);
+
+// 模型文件内容的FNV-1a 64位hash
+static int hash_file(const std::string& filename, uint64_t& hash) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs.is_open())
+        return -1;
+    hash = 14695981039346656037ULL;
+    std::vector<char> buf(1 << 16);
+    while (ifs) {
+        ifs.read(buf.data(), buf.size());
+        std::streamsize n = ifs.gcount();
+        for (std::streamsize i = 0; i < n; i++) {
+            hash ^= static_cast<unsigned char>(buf[i]);
+            hash *= 1099511628211ULL;
+        }
+    }
+    return ifs.bad() ? -1 : 0;
+}
+
+std::string OnnxWrapper::GetCacheFile(const std::string& model_file) {
+    uint64_t hash;
+    if (0 != hash_file(model_file, hash))
+        return "";
+    std::string base = model_file;
+    size_t dot = base.rfind('.');
+    if (dot != std::string::npos && base.find('/', dot) == std::string::npos)
+        base.resize(dot);
+    char key[64];
+    snprintf(key, sizeof(key), ".%016llx.ort-%s.ort", (unsigned long long)hash, OrtGetApiBase()->GetVersionString());
+    return base + key;
+}
+
+static Ort::SessionOptions create_session_options() {
+    // 线程数由OrtEnv的全局线程池决定，多个session、多个调用线程共用
     Ort::SessionOptions session_options;
-    session_options.SetIntraOpNumThreads(1);
+    session_options.DisablePerSessionThreads();
     session_options.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
 
     // GPU compatiable.
@@ -17,24 +59,100 @@ int OnnxWrapper::Init(const std::string& model_file) {
     // #ifdef USE_CUDA
     //  OrtSessionOptionsAppendExecutionProvider_CUDA(session_options, 0); // C API stable.
     // #endif
- 
+    return session_options;
+}
+
+int OnnxWrapper::Init(const std::string& model_file, bool use_cache) {
+    m_cache_hit = false;
+    std::string cache_file = use_cache ? GetCacheFile(model_file) : "";
+
+    // 0. 缓存的ORT格式模型已经做过图优化，直接加载；加载失败(损坏、截断)时回到原始模型并重新生成
+    if (!cache_file.empty() && 0 == access(cache_file.c_str(), R_OK)) {
+        Ort::SessionOptions session_options = create_session_options();
+        session_options.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+        session_options.AddConfigEntry(kOrtSessionOptionsConfigLoadModelFormat, "ORT");
+        try {
+            m_session = new Ort::Session(OrtEnv::Get(), cache_file.c_str(), session_options);
+            m_cache_hit = true;
+        } catch (const Ort::Exception& e) {
+            printf("Load encoder cache %s failed, rebuild it: %s\n", cache_file.c_str(), e.what());
+            unlink(cache_file.c_str());
+        }
+    }
+
     // 1. session
-    m_session = new Ort::Session(m_ort_env, model_file.c_str(), session_options);
+    if (!m_session) {
+        Ort::SessionOptions session_options = create_session_options();
+        // 优化后的模型先写临时文件再rename，并发启动或中途崩溃不会留下半个缓存
+        std::string tmp_file;
+        if (!cache_file.empty()) {
+            tmp_file = cache_file + ".tmp." + std::to_string(getpid());
+            session_options.SetOptimizedModelFilePath(tmp_file.c_str());
+            session_options.AddConfigEntry(kOrtSessionOptionsConfigSaveModelFormat, "ORT");
+        }
+        try {
+            m_session = new Ort::Session(OrtEnv::Get(), model_file.c_str(), session_options);
+        } catch (const Ort::Exception& e) {
+            // 失败时可能已经写了一半的临时文件
+            printf("Load encoder %s failed: %s\n", model_file.c_str(), e.what());
+            if (!tmp_file.empty())
+                unlink(tmp_file.c_str());
+            m_session = nullptr;
+            return -1;
+        }
+        if (!tmp_file.empty() && 0 != rename(tmp_file.c_str(), cache_file.c_str())) {
+            // 模型目录只读时只是没有缓存，不影响推理
+            printf("Save encoder cache %s failed\n", cache_file.c_str());
+            unlink(tmp_file.c_str());
+        }
+    }
     // memory allocation and options
     Ort::AllocatorWithDefaultOptions allocator;
     // 2. input name & input dims
     m_input_num = m_session->GetInputCount();
-    // for (int i = 0; i < m_input_num; i++) {
-    //     std::string input_name(m_session->GetInputNameAllocated(i, allocator).get());
-    //     printf("name[%d]: %s\n", i, input_name.c_str());
-    // }
+    std::vector<std::string> input_names;
+    for (int i = 0; i < m_input_num; i++)
+        input_names.emplace_back(m_session->GetInputNameAllocated(i, allocator).get());
 
     // 4. output names & output dims
     m_output_num = m_session->GetOutputCount();
-    // for (int i = 0; i < m_output_num; i++) {
-    //     std::string output_name(m_session->GetOutputNameAllocated(i, allocator).get());
-    //     printf("name[%d]: %s\n", i, output_name.c_str());
-    // }
+    std::vector<std::string> output_names;
+    for (int i = 0; i < m_output_num; i++)
+        output_names.emplace_back(m_session->GetOutputNameAllocated(i, allocator).get());
+
+    // 按Run的顺序排好session里的名字，缺少时报错
+    m_input_names.clear();
+    m_output_names.clear();
+    for (int i = 0; i < kInputNum; i++) {
+        auto it = std::find(input_names.begin(), input_names.end(), kInputNames[i]);
+        if (it == input_names.end()) {
+            printf("encoder input %s not found!\n", kInputNames[i]);
+            return -1;
+        }
+        m_input_names.push_back(*it);
+    }
+    for (int i = 0; i < kOutputNum; i++) {
+        auto it = std::find(output_names.begin(), output_names.end(), kOutputNames[i]);
+        if (it == output_names.end()) {
+            printf("encoder output %s not found!\n", kOutputNames[i]);
+            return -1;
+        }
+        m_output_names.push_back(*it);
+        // info引用type_info里的数据，type_info要保留到用完
+        Ort::TypeInfo type_info = m_session->GetOutputTypeInfo(it - output_names.begin());
+        auto info = type_info.GetTensorTypeAndShapeInfo();
+        if (i == 1)
+            m_bind_pronoun_lens = info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32;
+        else if (i == 2)
+            m_bind_audio_len = info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32 &&
+                               info.GetShape() == std::vector<int64_t>{1};
+    }
+    m_input_name_ptrs.clear();
+    m_output_name_ptrs.clear();
+    for (auto& name : m_input_names)
+        m_input_name_ptrs.push_back(name.c_str());
+    for (auto& name : m_output_names)
+        m_output_name_ptrs.push_back(name.c_str());
  
     return 0;
 }
@@ -61,9 +179,6 @@ std::vector<Ort::Value> OnnxWrapper::Run(std::vector<int>& phone,
     std::array<int64_t, 1> noise_scale_w_dims{1};
     std::array<int64_t, 1> sdp_scale_dims{1};
 
-    const char* input_names[] = {"phone", "tone", "language", "g", "noise_scale", "noise_scale_w", "length_scale", "sdp_ratio"};
-    const char* output_names[] = {"z_p", "pronoun_lens", "audio_len"};
-
     Ort::MemoryInfo memory_info_handler = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
     std::vector<Ort::Value> input_vals;
     input_vals.emplace_back(Ort::Value::CreateTensor<int>(memory_info_handler, phone.data(), phone.size(), phone_dims.data(), phone_dims.size()));
@@ -75,5 +190,163 @@ std::vector<Ort::Value> OnnxWrapper::Run(std::vector<int>& phone,
     input_vals.emplace_back(Ort::Value::CreateTensor<float>(memory_info_handler, &length_scale, 1, length_scale_dims.data(), length_scale_dims.size()));
     input_vals.emplace_back(Ort::Value::CreateTensor<float>(memory_info_handler, &sdp_ratio, 1, sdp_scale_dims.data(), sdp_scale_dims.size()));
 
-    return m_session->Run(Ort::RunOptions{nullptr}, input_names, input_vals.data(), input_vals.size(), output_names, m_output_num);
-}
\ No newline at end of file
+    return m_session->Run(Ort::RunOptions{nullptr}, m_input_name_ptrs.data(), input_vals.data(), input_vals.size(), m_output_name_ptrs.data(), m_output_name_ptrs.size());
+}
+
+int OnnxWrapper::Precompile(const std::string& model_file, double* cold_ms, double* warm_ms) {
+    std::string cache_file = GetCacheFile(model_file);
+    if (cache_file.empty()) {
+        printf("Read %s failed!\n", model_file.c_str());
+        return -1;
+    }
+    // 删掉旧缓存，冷启动计时包含完整的图优化
+    unlink(cache_file.c_str());
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        {
+            OnnxWrapper cold;
+            if (0 != cold.Init(model_file, true))
+                return -1;
+        }
+        auto mid = std::chrono::steady_clock::now();
+        {
+            OnnxWrapper warm;
+            if (0 != warm.Init(model_file, true) || !warm.IsCacheHit()) {
+                printf("Load encoder cache %s failed!\n", cache_file.c_str());
+                return -1;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        if (cold_ms)
+            *cold_ms = std::chrono::duration<double, std::milli>(mid - start).count();
+        if (warm_ms)
+            *warm_ms = std::chrono::duration<double, std::milli>(end - mid).count();
+    } catch (const Ort::Exception& e) {
+        printf("Precompile %s failed: %s\n", model_file.c_str(), e.what());
+        return -1;
+    }
+    return 0;
+}
+
+int OnnxWrapper::InitBinding(EncoderBinding& b, int max_phone_len) {
+    if (!m_session || max_phone_len <= 0)
+        return -1;
+
+    b.binding = Ort::IoBinding(*m_session);
+    b.memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    b.max_phone_len = max_phone_len;
+    b.phone.assign(max_phone_len, 0);
+    b.tone.assign(max_phone_len, 0);
+    b.language.assign(max_phone_len, 0);
+    b.pronoun_lens.assign(max_phone_len, 0);
+    b.g.assign(256, 0);
+    std::fill(b.scalars, b.scalars + 4, 0.0f);
+    b.views.clear();
+    b.views.resize(max_phone_len + 1);
+    b.bound_len = 0;
+
+    std::array<int64_t, 3> g_dims{1, 256, 1};
+    std::array<int64_t, 1> scalar_dims{1};
+    b.fixed_inputs.clear();
+    b.fixed_inputs.emplace_back(Ort::Value::CreateTensor<float>(b.memory_info, b.g.data(), b.g.size(), g_dims.data(), g_dims.size()));
+    for (int i = 0; i < 4; i++)
+        b.fixed_inputs.emplace_back(Ort::Value::CreateTensor<float>(b.memory_info, &b.scalars[i], 1, scalar_dims.data(), scalar_dims.size()));
+    for (int i = 0; i < 5; i++)
+        b.binding.BindInput(m_input_name_ptrs[3 + i], b.fixed_inputs[i]);
+
+    // 先按输出顺序绑定一次，之后重新绑定同名输出不改变顺序
+    for (int i = 0; i < kOutputNum; i++)
+        b.binding.BindOutput(m_output_name_ptrs[i], b.memory_info);
+    if (m_bind_audio_len) {
+        b.audio_len_value = Ort::Value::CreateTensor<int>(b.memory_info, &b.audio_len, 1, scalar_dims.data(), scalar_dims.size());
+        b.binding.BindOutput(m_output_name_ptrs[2], b.audio_len_value);
+    }
+    b.outputs.clear();
+    b.outputs.reserve(kOutputNum);
+    return 0;
+}
+
+int OnnxWrapper::BindInputs(EncoderBinding& b,
+                            const std::vector<int>& phone,
+                            const std::vector<int>& tones,
+                            const std::vector<int>& langids,
+                            const std::vector<float>& g,
+                            float noise_scale,
+                            float noise_scale_w,
+                            float length_scale,
+                            float sdp_ratio) {
+    int len = phone.size();
+    if (len == 0 || tones.size() != phone.size() || langids.size() != phone.size() || g.size() != b.g.size())
+        return -1;
+    // 超过最大长度时按新长度重新分配，之前缓存的视图全部作废
+    if (len > b.max_phone_len && 0 != InitBinding(b, std::max(len, b.max_phone_len * 2)))
+        return -1;
+
+    memcpy(b.phone.data(), phone.data(), sizeof(int) * len);
+    memcpy(b.tone.data(), tones.data(), sizeof(int) * len);
+    memcpy(b.language.data(), langids.data(), sizeof(int) * len);
+    memcpy(b.g.data(), g.data(), sizeof(float) * g.size());
+    b.scalars[0] = noise_scale;
+    b.scalars[1] = noise_scale_w;
+    b.scalars[2] = length_scale;
+    b.scalars[3] = sdp_ratio;
+
+    std::vector<Ort::Value>& views = b.views[len];
+    if (views.empty()) {
+        std::array<int64_t, 1> dims{len};
+        views.reserve(4);
+        views.emplace_back(Ort::Value::CreateTensor<int>(b.memory_info, b.phone.data(), len, dims.data(), dims.size()));
+        views.emplace_back(Ort::Value::CreateTensor<int>(b.memory_info, b.tone.data(), len, dims.data(), dims.size()));
+        views.emplace_back(Ort::Value::CreateTensor<int>(b.memory_info, b.language.data(), len, dims.data(), dims.size()));
+        views.emplace_back(Ort::Value::CreateTensor<int>(b.memory_info, b.pronoun_lens.data(), len, dims.data(), dims.size()));
+    }
+    if (b.bound_len != len) {
+        for (int i = 0; i < 3; i++)
+            b.binding.BindInput(m_input_name_ptrs[i], views[i]);
+        if (m_bind_pronoun_lens)
+            b.binding.BindOutput(m_output_name_ptrs[1], views[3]);
+        b.bound_len = len;
+    }
+
+    // 长度不固定的输出每次都要重新绑定，否则onnxruntime会把上一次的输出当作预分配的buffer
+    b.binding.BindOutput(m_output_name_ptrs[0], b.memory_info);
+    if (!m_bind_pronoun_lens)
+        b.binding.BindOutput(m_output_name_ptrs[1], b.memory_info);
+    if (!m_bind_audio_len)
+        b.binding.BindOutput(m_output_name_ptrs[2], b.memory_info);
+    return 0;
+}
+
+void OnnxWrapper::RunBinding(EncoderBinding& b) {
+    m_session->Run(Ort::RunOptions{nullptr}, b.binding);
+}
+
+std::vector<Ort::Value>& OnnxWrapper::GetBoundOutputs(EncoderBinding& b) {
+    // 不用IoBinding::GetOutputValues，它每次返回新的vector。
+    // 输出数组用默认allocator：session的arena分配和释放时还要维护空闲块的集合，分配次数更多
+    OrtValue** values = nullptr;
+    size_t count = 0;
+    Ort::AllocatorWithDefaultOptions allocator;
+    Ort::ThrowOnError(Ort::GetApi().GetBoundOutputValues(b.binding, allocator, &values, &count));
+    b.outputs.clear();
+    for (size_t i = 0; i < count; i++)
+        b.outputs.emplace_back(values[i]);
+    allocator.Free(values);
+    return b.outputs;
+}
+
+std::vector<Ort::Value>& OnnxWrapper::RunBound(EncoderBinding& b,
+                                               const std::vector<int>& phone,
+                                               const std::vector<int>& tones,
+                                               const std::vector<int>& langids,
+                                               const std::vector<float>& g,
+                                               float noise_scale,
+                                               float noise_scale_w,
+                                               float length_scale,
+                                               float sdp_ratio) {
+    if (0 != BindInputs(b, phone, tones, langids, g, noise_scale, noise_scale_w, length_scale, sdp_ratio))
+        throw Ort::Exception("invalid encoder input", ORT_INVALID_ARGUMENT);
+    RunBinding(b);
+    return GetBoundOutputs(b);
+}
@@ -1,27 +1,94 @@
+#pragma once
+
 #include "onnxruntime_cxx_api.h"
 
+// 绑定IO推理用的输入输出buffer，按最大phone长度预分配，超出时自动扩大；
+// 每种phone长度的tensor视图第一次用到时创建并缓存，之后推理不再分配输入和固定大小的输出。
+// z_p要交给decoder阶段，下一句推理时还在使用，只能每次绑定到onnxruntime的arena上。
+// 一个binding同时只能在一个线程上使用
+struct EncoderBinding {
+    Ort::IoBinding binding{nullptr};
+    Ort::MemoryInfo memory_info{nullptr};
+    int max_phone_len = 0;
+    std::vector<int> phone, tone, language, pronoun_lens;
+    std::vector<float> g;
+    // noise_scale, noise_scale_w, length_scale, sdp_ratio
+    float scalars[4];
+    int audio_len = 0;
+    // g、标量输入和audio_len输出形状固定，只绑定一次
+    std::vector<Ort::Value> fixed_inputs;
+    Ort::Value audio_len_value{nullptr};
+    // 下标为phone长度：phone/tone/language/pronoun_lens的视图
+    std::vector<std::vector<Ort::Value>> views;
+    int bound_len = 0;
+    // 上一次推理的输出，容量保留给下一次
+    std::vector<Ort::Value> outputs;
+};
+
 class OnnxWrapper {
 public:
     OnnxWrapper():
-        m_session(nullptr) {
+        m_session(nullptr),
+        m_bind_pronoun_lens(false),
+        m_bind_audio_len(false),
+        m_cache_hit(false) {
 
     }
     ~OnnxWrapper() {
         Release();
     }
 
-    int Init(const std::string& model_file);
+    // use_cache时图优化后的模型以ORT格式缓存在model_file旁边，
+    // 文件名带模型hash和onnxruntime版本，之后启动直接加载缓存
+    int Init(const std::string& model_file, bool use_cache = false);
+
+    // 本次Init是否从缓存加载
+    bool IsCacheHit() const { return m_cache_hit; }
+
+    // model_file对应的缓存路径，读不到模型时返回空串
+    static std::string GetCacheFile(const std::string& model_file);
+
+    // 离线重新生成缓存，返回冷启动(图优化并写缓存)和热启动(读缓存)的加载时间
+    static int Precompile(const std::string& model_file, double* cold_ms, double* warm_ms);
 
-    std::vector<Ort::Value> Run(std::vector<int>& phone, 
+    // 可以在多个线程上同时调用
+    std::vector<Ort::Value> Run(std::vector<int>& phone,
                                 std::vector<int>& tones,
                                 std::vector<int>& langids,
                                 std::vector<float>& g,
-                                
+
                                 float noise_scale,
-                                float length_scale,
                                 float noise_scale_w,
+                                float length_scale,
                                 float sdp_ratio);
 
+    // 绑定IO推理，输出顺序与Run相同(z_p, pronoun_lens, audio_len)，放在binding.outputs里，
+    // 调用者可以把其中的Ort::Value移走。pronoun_lens和audio_len指向binding里的buffer，
+    // 下一次用同一个binding推理前有效
+    int InitBinding(EncoderBinding& binding, int max_phone_len);
+    std::vector<Ort::Value>& RunBound(EncoderBinding& binding,
+                                     const std::vector<int>& phone,
+                                     const std::vector<int>& tones,
+                                     const std::vector<int>& langids,
+                                     const std::vector<float>& g,
+                                     float noise_scale,
+                                     float noise_scale_w,
+                                     float length_scale,
+                                     float sdp_ratio);
+
+    // RunBound拆开的三步，benchmark分别统计每一步的分配次数
+    int BindInputs(EncoderBinding& binding,
+                   const std::vector<int>& phone,
+                   const std::vector<int>& tones,
+                   const std::vector<int>& langids,
+                   const std::vector<float>& g,
+                   float noise_scale,
+                   float noise_scale_w,
+                   float length_scale,
+                   float sdp_ratio);
+    void RunBinding(EncoderBinding& binding);
+    std::vector<Ort::Value>& GetBoundOutputs(EncoderBinding& binding);
+
     inline int GetInputSize(int index) const {
         return m_input_sizes[index];
     }
@@ -39,9 +106,14 @@ public:
     }
 
 private:
-    Ort::Env m_ort_env;
     Ort::Session* m_session;
     int m_input_num, m_output_num;
+    // 按Run的参数顺序排列，名字取自session
     std::vector<std::string> m_input_names, m_output_names;
+    std::vector<const char*> m_input_name_ptrs, m_output_name_ptrs;
     std::vector<int> m_input_sizes, m_output_sizes;
-};
\ No newline at end of file
+    // pronoun_lens是int32、audio_len是形状为[1]的int32时才能绑定到预分配的buffer
+    bool m_bind_pronoun_lens;
+    bool m_bind_audio_len;
+    bool m_cache_hit;
+};
@@ -0,0 +1,36 @@
+#include "OrtEnv.hpp"
+
+#include <cstdio>
+#include <mutex>
+#include <memory>
+
+static std::mutex s_env_mutex;
+static std::unique_ptr<Ort::Env> s_env;
+static OrtEnvOptions s_env_options;
+
+Ort::Env& OrtEnv::Get(const OrtEnvOptions& options) {
+    std::lock_guard<std::mutex> lock(s_env_mutex);
+    if (s_env) {
+        if (options.intra_op_threads != s_env_options.intra_op_threads ||
+            options.inter_op_threads != s_env_options.inter_op_threads) {
+            printf("Ort env already created with intra_op_threads=%d inter_op_threads=%d, ignore %d/%d\n",
+                   s_env_options.intra_op_threads, s_env_options.inter_op_threads,
+                   options.intra_op_threads, options.inter_op_threads);
+        }
+        return *s_env;
+    }
+
+    Ort::ThreadingOptions threading_options;
+    threading_options.SetGlobalIntraOpNumThreads(options.intra_op_threads);
+    threading_options.SetGlobalInterOpNumThreads(options.inter_op_threads);
+    // 多个调用线程共享线程池，关闭spin避免空转抢占A55核心
+    threading_options.SetGlobalSpinControl(0);
+    s_env.reset(new Ort::Env(threading_options, ORT_LOGGING_LEVEL_ERROR, "melotts"));
+    s_env_options = options;
+    return *s_env;
+}
+
+OrtEnvOptions OrtEnv::GetOptions() {
+    std::lock_guard<std::mutex> lock(s_env_mutex);
+    return s_env_options;
+}
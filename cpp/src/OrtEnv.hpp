@@ -0,0 +1,20 @@
+#pragma once
+
+#include "onnxruntime_cxx_api.h"
+
+// 进程内共享的Ort::Env，带全局线程池；所有session共用一个env，
+// encoder session关闭自己的线程池，改用全局线程池
+struct OrtEnvOptions {
+    // 全局intra-op/inter-op线程数，1表示只在调用线程上计算
+    int intra_op_threads = 1;
+    int inter_op_threads = 1;
+};
+
+class OrtEnv {
+public:
+    // 第一次调用时按options创建，之后返回同一个env，options不同时打印提示并忽略
+    static Ort::Env& Get(const OrtEnvOptions& options = OrtEnvOptions());
+
+    // 创建env时实际使用的配置
+    static OrtEnvOptions GetOptions();
+};
@@ -0,0 +1,211 @@
+#include "Profiler.hpp"
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <signal.h>
+#include <unistd.h>
+
+// 小于16us每微秒一个桶，之后每个2的幂分8个桶，相对误差不超过12.5%
+static const int kLinearBuckets = 16;
+static const int kSubBuckets = 8;
+static const int kBucketNum = kLinearBuckets + (64 - 4) * kSubBuckets;
+
+static const char* const kStageNames[PROFILE_STAGE_NUM] = {
+    "split", "frontend", "encoder", "slice_plan", "slice_copy", "decoder_run",
+    "decoder_wait", "audio_write", "sentence", "first_audio", "synthesize", "wav_save"
+};
+
+struct Histogram {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> min;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[kBucketNum];
+};
+
+static Histogram s_histograms[PROFILE_STAGE_NUM];
+static std::atomic<bool> s_enabled(false);
+static int s_signal_pipe[2] = {-1, -1};
+// min从最大值开始
+__attribute__((unused)) static const bool s_initialized = (Profiler::Reset(), true);
+
+static int bucket_index(uint64_t us) {
+    if (us < kLinearBuckets)
+        return static_cast<int>(us);
+    int e = 63 - __builtin_clzll(us);
+    int sub = static_cast<int>(us >> (e - 3)) & (kSubBuckets - 1);
+    return kLinearBuckets + (e - 4) * kSubBuckets + sub;
+}
+
+// 桶的中点
+static double bucket_value(int index) {
+    if (index < kLinearBuckets)
+        return index;
+    int e = (index - kLinearBuckets) / kSubBuckets + 4;
+    int sub = (index - kLinearBuckets) % kSubBuckets;
+    double width = static_cast<double>(1ULL << (e - 3));
+    return (kSubBuckets + sub) * width + width / 2;
+}
+
+static void atomic_min(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t cur = target.load(std::memory_order_relaxed);
+    while (value < cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+
+static void atomic_max(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t cur = target.load(std::memory_order_relaxed);
+    while (value > cur && !target.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+
+struct StageSummary {
+    uint64_t count;
+    double total_ms, min_ms, max_ms, p50_ms, p90_ms, p99_ms;
+};
+
+static StageSummary summarize(const Histogram& h) {
+    StageSummary s = {};
+    std::vector<uint64_t> buckets(kBucketNum);
+    uint64_t count = 0;
+    for (int i = 0; i < kBucketNum; i++) {
+        buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+    // 以桶的计数为准，count/total和桶之间可能差一次正在进行的记录
+    s.count = count;
+    if (count == 0)
+        return s;
+    s.total_ms = h.total.load(std::memory_order_relaxed) / 1000.0;
+    s.min_ms = h.min.load(std::memory_order_relaxed) / 1000.0;
+    s.max_ms = h.max.load(std::memory_order_relaxed) / 1000.0;
+
+    double* targets[] = {&s.p50_ms, &s.p90_ms, &s.p99_ms};
+    const double quantiles[] = {0.5, 0.9, 0.99};
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < kBucketNum && q < 3; i++) {
+        seen += buckets[i];
+        while (q < 3 && seen > 0 && seen >= quantiles[q] * count) {
+            double v = bucket_value(i) / 1000.0;
+            *targets[q] = std::min(std::max(v, s.min_ms), s.max_ms);
+            q++;
+        }
+    }
+    return s;
+}
+
+bool Profiler::IsCompiled() {
+#ifdef MELOTTS_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Profiler::IsEnabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetEnabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::Record(ProfileStage stage, uint64_t us) {
+    Histogram& h = s_histograms[stage];
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    atomic_min(h.min, us);
+    atomic_max(h.max, us);
+    h.total.fetch_add(us, std::memory_order_relaxed);
+    h.buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::Reset() {
+    for (auto& h : s_histograms) {
+        h.count.store(0, std::memory_order_relaxed);
+        h.total.store(0, std::memory_order_relaxed);
+        h.min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+        h.max.store(0, std::memory_order_relaxed);
+        for (auto& b : h.buckets)
+            b.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* Profiler::StageName(ProfileStage stage) {
+    return kStageNames[stage];
+}
+
+std::string Profiler::ToJson() {
+    std::string json = "{\"stages\": {";
+    char buf[512];
+    bool first = true;
+    for (int i = 0; i < PROFILE_STAGE_NUM; i++) {
+        StageSummary s = summarize(s_histograms[i]);
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\": {\"count\": %llu, \"total_ms\": %.3f, \"mean_ms\": %.3f, \"min_ms\": %.3f, "
+                 "\"max_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f}",
+                 first ? "" : ", ", kStageNames[i], (unsigned long long)s.count, s.total_ms,
+                 s.count ? s.total_ms / s.count : 0.0, s.min_ms, s.max_ms, s.p50_ms, s.p90_ms, s.p99_ms);
+        json += buf;
+        first = false;
+    }
+    json += "}}\n";
+    return json;
+}
+
+int Profiler::DumpJson(const std::string& file) {
+    std::string json = ToJson();
+    // 先写临时文件再rename，读的一方不会看到写了一半的json
+    std::string tmp_file = file + ".tmp";
+    FILE* fp = fopen(tmp_file.c_str(), "w");
+    if (!fp) {
+        printf("Open %s failed!\n", tmp_file.c_str());
+        return -1;
+    }
+    bool ok = fwrite(json.data(), 1, json.size(), fp) == json.size();
+    ok &= fclose(fp) == 0;
+    if (!ok || 0 != rename(tmp_file.c_str(), file.c_str())) {
+        printf("Write %s failed!\n", file.c_str());
+        unlink(tmp_file.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+void Profiler::Print(FILE* fp) {
+    fprintf(fp, "%-14s %8s %10s %10s %10s %10s %10s\n", "stage", "count", "total", "mean", "p50", "p90", "p99");
+    for (int i = 0; i < PROFILE_STAGE_NUM; i++) {
+        StageSummary s = summarize(s_histograms[i]);
+        if (s.count == 0)
+            continue;
+        fprintf(fp, "%-14s %8llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", kStageNames[i], (unsigned long long)s.count,
+                s.total_ms, s.total_ms / s.count, s.p50_ms, s.p90_ms, s.p99_ms);
+    }
+}
+
+static void handle_dump_signal(int sig) {
+    char c = 0;
+    ssize_t n = write(s_signal_pipe[1], &c, 1);
+    (void)n;
+}
+
+int Profiler::DumpOnSignal(int sig, const std::string& file) {
+    if (s_signal_pipe[0] >= 0) {
+        printf("Profiler dump signal already installed!\n");
+        return -1;
+    }
+    if (0 != pipe(s_signal_pipe)) {
+        printf("Create profiler signal pipe failed!\n");
+        return -1;
+    }
+    std::thread([file]() {
+        char c;
+        while (read(s_signal_pipe[0], &c, 1) == 1) {
+            if (0 == DumpJson(file))
+                printf("Profile written to %s\n", file.c_str());
+        }
+    }).detach();
+    signal(sig, handle_dump_signal);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+// 流水线各阶段的耗时统计：每个阶段一个对数分桶的直方图，全部是原子计数，
+// 任意线程都可以记录，随时可以导出p50/p90/p99。
+// 编译时没有定义MELOTTS_PROFILE时PROFILE_*宏为空；运行时默认关闭，SetEnabled(true)后才计时
+enum ProfileStage {
+    PROFILE_SPLIT,          // 分句
+    PROFILE_FRONTEND,       // 一句话的词典转换和intersperse
+    PROFILE_ENCODER,        // 一句话的encoder推理
+    PROFILE_SLICE_PLAN,     // 计算word2pronoun和decoder切片
+    PROFILE_SLICE_COPY,     // 一片z_p打包进decoder输入
+    PROFILE_DECODER_RUN,    // 一片decoder推理(NPU或CPU)
+    PROFILE_DECODER_WAIT,   // 调用线程等待一片decoder完成
+    PROFILE_AUDIO_WRITE,    // 一片音频裁剪后写入sink(含重采样)
+    PROFILE_SENTENCE,       // 一句话从出队到全部切片写完
+    PROFILE_FIRST_AUDIO,    // Synthesize开始到第一段音频写出
+    PROFILE_SYNTHESIZE,     // 一次Synthesize
+    PROFILE_WAV_SAVE,       // 保存整段wav
+    PROFILE_STAGE_NUM
+};
+
+class Profiler {
+public:
+    // 编译时是否打开了MELOTTS_PROFILE
+    static bool IsCompiled();
+
+    static bool IsEnabled();
+    static void SetEnabled(bool enabled);
+
+    static void Record(ProfileStage stage, uint64_t us);
+    static void Reset();
+
+    static const char* StageName(ProfileStage stage);
+
+    // {"stages": {"encoder": {"count", "total_ms", "mean_ms", "min_ms", "max_ms", "p50_ms", "p90_ms", "p99_ms"}, ...}}
+    static std::string ToJson();
+    static int DumpJson(const std::string& file);
+
+    // 可读的表格，只列出有记录的阶段
+    static void Print(FILE* fp);
+
+    // 常驻进程收到sig时把当前统计写到file，信号处理函数里只写管道，由后台线程导出
+    static int DumpOnSignal(int sig, const std::string& file);
+};
+
+// 作用域计时，析构时记录到stage；构造时没有开启则什么都不做
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileStage stage) :
+            m_stage(stage),
+            m_enabled(Profiler::IsEnabled()) {
+        if (m_enabled)
+            m_start = std::chrono::steady_clock::now();
+    }
+
+    ~ProfileScope() {
+        if (m_enabled)
+            Profiler::Record(m_stage, std::chrono::duration_cast<std::chrono::microseconds>(
+                                              std::chrono::steady_clock::now() - m_start).count());
+    }
+
+private:
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ProfileStage m_stage;
+    bool m_enabled;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef MELOTTS_PROFILE
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(stage)
+#define PROFILE_RECORD_MS(stage, ms) \
+    do { if (Profiler::IsEnabled()) Profiler::Record(stage, static_cast<uint64_t>((ms) * 1000.0)); } while (0)
+#else
+#define PROFILE_SCOPE(stage) ((void)0)
+#define PROFILE_RECORD_MS(stage, ms) ((void)0)
+#endif
@@ -0,0 +1,169 @@
+#include "Resampler.hpp"
+#include "audio_utils.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+// 阻带衰减(dB)，通带边缘为较低采样率奈奎斯特频率的比例，阻带从奈奎斯特频率开始
+static const double STOPBAND_DB = 80.0;
+static const double PASSBAND_EDGE = 0.91;
+// 约分后L、M的上限，避免不常见的采样率设计出巨大的滤波器组
+static const int MAX_FACTOR = 1024;
+
+static const double PI = 3.14159265358979323846;
+
+// 第一类零阶修正贝塞尔函数，Kaiser窗用
+static double bessel_i0(double x) {
+    double sum = 1, term = 1, q = x * x / 4;
+    for (int k = 1; k < 100; k++) {
+        term *= q / (static_cast<double>(k) * k);
+        sum += term;
+        if (term < sum * 1e-15)
+            break;
+    }
+    return sum;
+}
+
+static int gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+std::shared_ptr<const Resampler::FilterBank> Resampler::GetBank(int in_rate, int out_rate) {
+    static std::mutex banks_mutex;
+    static std::map<std::pair<int, int>, std::shared_ptr<const FilterBank>> banks;
+
+    if (in_rate <= 0 || out_rate <= 0)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(banks_mutex);
+    auto it = banks.find(std::make_pair(in_rate, out_rate));
+    if (it != banks.end())
+        return it->second;
+
+    int g = gcd(in_rate, out_rate);
+    std::shared_ptr<FilterBank> bank(new FilterBank());
+    bank->in_rate = in_rate;
+    bank->out_rate = out_rate;
+    bank->up = out_rate / g;
+    bank->down = in_rate / g;
+    if (bank->up > MAX_FACTOR || bank->down > MAX_FACTOR) {
+        printf("Unsupported resample from %d Hz to %d Hz\n", in_rate, out_rate);
+        return nullptr;
+    }
+
+    // 在上采样L倍后的采样率下设计低通，截止频率在过渡带中点，按Kaiser公式由过渡带宽度和衰减定长度
+    const double high_rate = static_cast<double>(in_rate) * bank->up;
+    const double nyquist = std::min(in_rate, out_rate) / 2.0;
+    const double transition = (1.0 - PASSBAND_EDGE) * nyquist / high_rate;
+    const double cutoff = (1.0 + PASSBAND_EDGE) / 2 * nyquist / high_rate;
+    const double beta = 0.1102 * (STOPBAND_DB - 8.7);
+    int len = static_cast<int>(std::ceil((STOPBAND_DB - 8) / (2.285 * 2 * PI * transition)));
+    bank->taps = (len + bank->up - 1) / bank->up;
+    len = bank->taps * bank->up;
+
+    std::vector<double> h(len);
+    const double center = (len - 1) / 2.0;
+    const double i0_beta = bessel_i0(beta);
+    double sum = 0;
+    for (int k = 0; k < len; k++) {
+        double x = k - center;
+        double sinc = x == 0 ? 2 * cutoff : std::sin(2 * PI * cutoff * x) / (PI * x);
+        double r = len > 1 ? 2 * x / (len - 1) : 0;
+        double window = bessel_i0(beta * std::sqrt(std::max(0.0, 1 - r * r))) / i0_beta;
+        h[k] = sinc * window;
+        sum += h[k];
+    }
+
+    // 插零后每个相位只用到1/L的taps，直流增益归一化到L
+    const double scale = bank->up / sum;
+    bank->coeffs.resize(len);
+    for (int p = 0; p < bank->up; p++) {
+        for (int k = 0; k < bank->taps; k++)
+            bank->coeffs[p * bank->taps + (bank->taps - 1 - k)] = static_cast<float>(h[p + k * bank->up] * scale);
+    }
+    bank->delay = (len - 1) / 2;
+
+    banks[std::make_pair(in_rate, out_rate)] = bank;
+    return bank;
+}
+
+int Resampler::Init(int in_rate, int out_rate) {
+    m_bank = GetBank(in_rate, out_rate);
+    if (!m_bank)
+        return -1;
+    Reset();
+    return 0;
+}
+
+void Resampler::Reset() {
+    if (!m_bank)
+        return;
+    m_history.assign(m_bank->taps - 1, 0);
+    m_history_start = -(m_bank->taps - 1);
+    m_in_count = 0;
+    m_out_count = 0;
+}
+
+void Resampler::Process(const float* in, size_t num, std::vector<float>& out) {
+    if (!m_bank)
+        return;
+    const FilterBank& bank = *m_bank;
+    m_history.insert(m_history.end(), in, in + num);
+    m_in_count += num;
+
+    // 第m个输出在上采样后的时刻t = m * M + delay，用到第t / L个输入及其之前的taps - 1个
+    for (;;) {
+        int64_t t = m_out_count * bank.down + bank.delay;
+        int64_t n = t / bank.up;
+        if (n >= m_in_count)
+            break;
+        int phase = static_cast<int>(t % bank.up);
+        const float* x = m_history.data() + (n - (bank.taps - 1) - m_history_start);
+        out.push_back(dot_product(&bank.coeffs[phase * bank.taps], x, bank.taps));
+        m_out_count++;
+    }
+
+    // 丢掉之后不会再用到的输入
+    int64_t next_n = (m_out_count * bank.down + bank.delay) / bank.up;
+    int64_t keep_from = std::min(next_n - (bank.taps - 1), m_in_count);
+    if (keep_from > m_history_start) {
+        m_history.erase(m_history.begin(), m_history.begin() + (keep_from - m_history_start));
+        m_history_start = keep_from;
+    }
+}
+
+void Resampler::Flush(std::vector<float>& out) {
+    if (!m_bank)
+        return;
+    const FilterBank& bank = *m_bank;
+    int64_t total = (m_in_count * bank.up + bank.down - 1) / bank.down;
+    if (m_out_count < total) {
+        // 补零到最后一个输出需要的输入为止，多算出来的输出丢掉
+        int64_t last_n = ((total - 1) * bank.down + bank.delay) / bank.up;
+        int64_t in_count = m_in_count;
+        std::vector<float> zeros(static_cast<size_t>(std::max<int64_t>(0, last_n + 1 - in_count)), 0.0f);
+        Process(zeros.data(), zeros.size(), out);
+        if (m_out_count > total)
+            out.resize(out.size() - (m_out_count - total));
+    }
+    Reset();
+}
+
+int ResampleSink::Write(const float* samples, size_t num) {
+    m_buffer.clear();
+    m_resampler.Process(samples, num, m_buffer);
+    return m_buffer.empty() ? 0 : m_sink->Write(m_buffer.data(), m_buffer.size());
+}
+
+int ResampleSink::Flush() {
+    m_buffer.clear();
+    m_resampler.Flush(m_buffer);
+    return m_buffer.empty() ? 0 : m_sink->Write(m_buffer.data(), m_buffer.size());
+}
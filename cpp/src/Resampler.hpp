@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "AudioSink.hpp"
+
+// 有理数倍率的多相重采样：out_rate / in_rate约分为L / M，Kaiser窗sinc原型滤波器拆成L个相位的滤波器组，
+// 每个输出采样只算一个相位的点积。过渡带在较低采样率奈奎斯特频率的91%~100%之间，阻带衰减80dB。
+// 可以按片流式调用Process，片之间保留历史输入和相位，输出与整段一次处理相同，已经补偿了滤波器延迟
+class Resampler {
+public:
+    // 滤波器组，同一对采样率在进程内只设计一次
+    struct FilterBank {
+        int in_rate;
+        int out_rate;
+        int up;         // L
+        int down;       // M
+        int taps;       // 每个相位的taps
+        // up * taps，每个相位倒序存放，和按时间顺序的输入直接做点积
+        std::vector<float> coeffs;
+        // 原型滤波器的群延迟，单位是上采样后的采样点
+        int64_t delay;
+    };
+
+    Resampler() : m_in_count(0), m_out_count(0) {}
+
+    // 不支持的采样率(约分后L或M过大)返回-1
+    int Init(int in_rate, int out_rate);
+
+    // 处理num个输入采样，结果追加到out
+    void Process(const float* in, size_t num, std::vector<float>& out);
+
+    // 输入结束，输出延迟中剩下的采样，总输出数为ceil(输入数 * L / M)，之后可以开始下一段
+    void Flush(std::vector<float>& out);
+
+    // 丢弃历史，开始新的一段
+    void Reset();
+
+    const FilterBank* GetBank() const { return m_bank.get(); }
+
+    // 取得(必要时设计)滤波器组，失败返回nullptr
+    static std::shared_ptr<const FilterBank> GetBank(int in_rate, int out_rate);
+
+private:
+    std::shared_ptr<const FilterBank> m_bank;
+    // 输入历史，m_history[0]对应第m_history_start个输入采样，负数下标是开头补的0
+    std::vector<float> m_history;
+    int64_t m_history_start;
+    int64_t m_in_count;
+    int64_t m_out_count;
+};
+
+// 把decoder的44.1kHz输出重采样后交给下游sink，Open/Close不转发，由调用方管理下游sink；
+// 一段音频结束时调用Flush写出剩余的采样
+class ResampleSink : public AudioSink {
+public:
+    explicit ResampleSink(AudioSink* sink) : m_sink(sink) {}
+
+    int Init(int in_rate, int out_rate) { return m_resampler.Init(in_rate, out_rate); }
+
+    int Open(int sample_rate) override { return 0; }
+
+    int Write(const float* samples, size_t num) override;
+
+    int Close() override { return 0; }
+
+    int Flush();
+
+private:
+    AudioSink* m_sink;
+    Resampler m_resampler;
+    std::vector<float> m_buffer;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MELOTTS_AUDIO_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MELOTTS_AUDIO_SSE 1
+#endif
+
+// float转16bit PCM：限幅到[-1, 1]，乘32767后就近取整(与lrintf一致，0.5时取偶数)
+inline void float_to_int16(const float* src, int16_t* dst, size_t n) {
+    size_t k = 0;
+#if defined(MELOTTS_AUDIO_NEON) && defined(__aarch64__)
+    const float32x4_t lo = vdupq_n_f32(-1.0f), hi = vdupq_n_f32(1.0f), scale = vdupq_n_f32(32767.0f);
+    for (; k + 8 <= n; k += 8) {
+        float32x4_t a = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + k), lo), hi), scale);
+        float32x4_t b = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + k + 4), lo), hi), scale);
+        vst1q_s16(dst + k, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+    }
+#elif defined(MELOTTS_AUDIO_SSE)
+    const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(32767.0f);
+    for (; k + 8 <= n; k += 8) {
+        __m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + k), lo), hi), scale);
+        __m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + k + 4), lo), hi), scale);
+        // cvtps按MXCSR的默认舍入(就近取偶)转换，packs饱和到int16
+        __m128i v = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + k), v);
+    }
+#endif
+    for (; k < n; k++) {
+        float s = std::min(std::max(src[k], -1.0f), 1.0f);
+        dst[k] = static_cast<int16_t>(std::lrint(s * 32767.0f));
+    }
+}
+
+// sum(a[k] * b[k])
+inline float dot_product(const float* a, const float* b, size_t n) {
+    size_t k = 0;
+    float sum = 0;
+#if defined(MELOTTS_AUDIO_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+    for (; k + 8 <= n; k += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + k), vld1q_f32(b + k));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + k + 4), vld1q_f32(b + k + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#elif defined(MELOTTS_AUDIO_SSE)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (; k + 8 <= n; k += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(b + k)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + k + 4), _mm_loadu_ps(b + k + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#endif
+    for (; k < n; k++)
+        sum += a[k] * b[k];
+    return sum;
+}
+
+// out[k] = a[k] * fade_out[k] + b[k] * fade_in[k]，out可以与a相同
+inline void crossfade(const float* a, const float* b, const float* fade_out, const float* fade_in,
+                      float* out, size_t n) {
+    size_t k = 0;
+#if defined(MELOTTS_AUDIO_NEON)
+    for (; k + 4 <= n; k += 4) {
+        float32x4_t v = vmulq_f32(vld1q_f32(a + k), vld1q_f32(fade_out + k));
+        v = vmlaq_f32(v, vld1q_f32(b + k), vld1q_f32(fade_in + k));
+        vst1q_f32(out + k, v);
+    }
+#elif defined(MELOTTS_AUDIO_SSE)
+    for (; k + 4 <= n; k += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(a + k), _mm_loadu_ps(fade_out + k));
+        v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(b + k), _mm_loadu_ps(fade_in + k)));
+        _mm_storeu_ps(out + k, v);
+    }
+#endif
+    for (; k < n; k++)
+        out[k] = a[k] * fade_out[k] + b[k] * fade_in[k];
+}
+
+// 相邻两片decoder输出的overlap-add拼接：每片开头overlap个采样与上一片末尾交叉淡化，
+// 不是最后一片时末尾overlap个采样留到下一片。
+// equal_power为true时用sin/cos曲线(等功率)，否则线性(等增益)
+class CrossfadeStitcher {
+public:
+    CrossfadeStitcher(size_t overlap, bool equal_power) :
+            m_overlap(overlap),
+            m_has_tail(false) {
+        const double half_pi = 1.57079632679489661923;
+        m_fade_in.resize(overlap);
+        m_fade_out.resize(overlap);
+        for (size_t k = 0; k < overlap; k++) {
+            double t = (k + 0.5) / overlap;
+            m_fade_in[k] = equal_power ? std::sin(half_pi * t) : t;
+            m_fade_out[k] = equal_power ? std::cos(half_pi * t) : 1.0 - t;
+        }
+        m_tail.resize(overlap);
+    }
+
+    // 新的一句话开始，丢掉上一片的末尾
+    void Reset() { m_has_tail = false; }
+
+    // 拼接一片n个采样的音频，调用write(const float*, size_t)写出，write返回非0时中止并返回-1
+    template <typename Write>
+    int Push(const float* audio, size_t n, bool last, Write&& write) {
+        size_t head = m_has_tail ? std::min(m_overlap, n) : 0;
+        if (head > 0) {
+            crossfade(m_tail.data(), audio, m_fade_out.data(), m_fade_in.data(), m_tail.data(), head);
+            if (0 != write(m_tail.data(), head))
+                return -1;
+        }
+        size_t keep = !last && n >= head + m_overlap ? m_overlap : 0;
+        if (n - keep > head && 0 != write(audio + head, n - keep - head))
+            return -1;
+        m_has_tail = keep > 0;
+        if (m_has_tail)
+            std::copy(audio + n - keep, audio + n, m_tail.begin());
+        return 0;
+    }
+
+private:
+    size_t m_overlap;
+    bool m_has_tail;
+    std::vector<float> m_fade_in, m_fade_out, m_tail;
+};
@@ -1,8 +1,8 @@
+#pragma once
+
 #include <vector>
 #include <string>
-#include <algorithm>
-#include <sstream>
-#include <cctype>
+#include <cstdint>
 
 using namespace std;
 
@@ -11,218 +11,339 @@ inline bool is_utf8_continuation_byte(unsigned char c) {
     return (c & 0xC0) == 0x80;
 }
 
+// UTF-8字符的字节数，由首字节判断，无效字节按1个字节
+inline size_t utf8_char_len(unsigned char c) {
+    if ((c & 0x80) == 0) {
+        return 1;
+    } else if ((c & 0xE0) == 0xC0) {
+        return 2;
+    } else if ((c & 0xF0) == 0xE0) {
+        return 3;
+    } else if ((c & 0xF8) == 0xF0) {
+        return 4;
+    }
+    return 1;
+}
+
 // 计算UTF-8字符串的字符数（非字节数）
-size_t utf8_strlen(const string& str) {
+inline size_t utf8_strlen(const char* str, size_t size) {
     size_t len = 0;
-    for (size_t i = 0; i < str.size(); ) {
-        unsigned char c = str[i];
-        if ((c & 0x80) == 0) { // ASCII字符
-            i += 1;
-        } else if ((c & 0xE0) == 0xC0) { // 2字节UTF-8
-            i += 2;
-        } else if ((c & 0xF0) == 0xE0) { // 3字节UTF-8（包括大部分中文）
-            i += 3;
-        } else if ((c & 0xF8) == 0xF0) { // 4字节UTF-8
-            i += 4;
-        } else {
-            i++; // 无效UTF-8，跳过
-        }
+    for (size_t i = 0; i < size; ) {
+        i += utf8_char_len(str[i]);
         len++;
     }
     return len;
 }
 
-// 合并短句的英文版本
-vector<string> merge_short_sentences_en(const vector<string>& sens) {
-    vector<string> sens_out;
-    for (const auto& s : sens) {
-        // 如果前一个句子太短（<=2个单词），就与当前句子合并
-        if (!sens_out.empty()) {
-            istringstream iss(sens_out.back());
-            int word_count = distance(istream_iterator<string>(iss), istream_iterator<string>());
-            if (word_count <= 2) {
-                sens_out.back() += " " + s;
-                continue;
-            }
-        }
-        sens_out.push_back(s);
-    }
-    
-    // 处理最后一个句子如果太短的情况
-    if (!sens_out.empty() && sens_out.size() > 1) {
-        istringstream iss(sens_out.back());
-        int word_count = distance(istream_iterator<string>(iss), istream_iterator<string>());
-        if (word_count <= 2) {
-            sens_out[sens_out.size()-2] += " " + sens_out.back();
-            sens_out.pop_back();
-        }
-    }
-    
-    return sens_out;
+inline size_t utf8_strlen(const string& str) {
+    return utf8_strlen(str.data(), str.size());
 }
 
-// 合并短句的中文版本
-vector<string> merge_short_sentences_zh(const vector<string>& sens) {
-    vector<string> sens_out;
-    for (const auto& s : sens) {
-        // 如果前一个句子太短（<=2个字符），就与当前句子合并
-        if (!sens_out.empty() && utf8_strlen(sens_out.back()) <= 2) {
-            sens_out.back() += " " + s;
-        } else {
-            sens_out.push_back(s);
-        }
+// 一个句子在SplitResult::text中的位置
+struct SentenceSpan {
+    size_t offset;
+    size_t size;
+    // 中文为字符数，拉丁语系为单词数，合并短句时使用
+    size_t length;
+};
+
+// 分句结果：规范化后的句子依次写入text，相邻句子之间隔一个空格，
+// 所以合并后的句子仍是text中连续的一段；重复使用同一个对象可以避免重新分配
+struct SplitResult {
+    string text;
+    vector<SentenceSpan> spans;
+
+    size_t size() const { return spans.size(); }
+    bool empty() const { return spans.empty(); }
+
+    string sentence(size_t i) const { return text.substr(spans[i].offset, spans[i].size); }
+    const char* data(size_t i) const { return text.data() + spans[i].offset; }
+
+    void clear() {
+        text.clear();
+        spans.clear();
     }
-    
-    // 处理最后一个句子如果太短的情况
-    if (!sens_out.empty() && sens_out.size() > 1 && utf8_strlen(sens_out.back()) <= 2) {
-        sens_out[sens_out.size()-2] += " " + sens_out.back();
-        sens_out.pop_back();
+};
+
+namespace split_detail {
+
+// 扫描时对每个字符的处理
+enum SplitAction : uint8_t {
+    SPLIT_COPY,         // 原样输出
+    SPLIT_SPACE,        // 可合并的空白，输出为空格
+    SPLIT_BLANK,        // 其他空白，原样输出，句首句尾去掉
+    SPLIT_REMOVE,       // 删除
+    SPLIT_END_KEEP,     // 输出后断句
+    SPLIT_END_DROP,     // 断句，不输出
+};
+
+// ASCII字符直接查表，非ASCII只有少数标点需要处理
+struct SplitTable {
+    uint8_t ascii[128];
+    // 可以整段原样拷贝的字节：普通ASCII，以及不可能是下面这些标点首字节的非ASCII字节
+    bool plain[256];
+    // 非ASCII标点的替换字符，0表示不输出
+    struct Mapping {
+        uint32_t cp;
+        uint8_t action;
+        char to;
+    };
+    Mapping mappings[12];
+    size_t mapping_count;
+};
+
+inline SplitTable make_table(bool latin) {
+    SplitTable t;
+    for (int c = 0; c < 128; c++)
+        t.ascii[c] = SPLIT_COPY;
+    t.ascii[static_cast<int>('\r')] = SPLIT_BLANK;
+    t.ascii[static_cast<int>('\v')] = SPLIT_BLANK;
+    t.ascii[static_cast<int>('\f')] = SPLIT_BLANK;
+    t.mapping_count = 0;
+    for (int c = 0; c < 256; c++)
+        t.plain[c] = c >= 0x80;
+    auto map = [&t](uint32_t cp, uint8_t action, char to) {
+        t.mappings[t.mapping_count++] = SplitTable::Mapping{cp, action, to};
+        t.plain[cp < 0x800 ? 0xC0 | (cp >> 6) : 0xE0 | (cp >> 12)] = false;
+    };
+
+    if (latin) {
+        t.ascii[static_cast<int>(' ')] = SPLIT_BLANK;
+        t.ascii[static_cast<int>('\n')] = SPLIT_BLANK;
+        t.ascii[static_cast<int>('\t')] = SPLIT_BLANK;
+        t.ascii[static_cast<int>('.')] = SPLIT_END_DROP;
+        for (char c : string("<>()[]\""))
+            t.ascii[static_cast<int>(c)] = SPLIT_REMOVE;
+        map(0x3002, SPLIT_END_DROP, 0);     // 。
+        map(0xFF01, SPLIT_END_DROP, 0);     // ！
+        map(0xFF1F, SPLIT_END_DROP, 0);     // ？
+        map(0xFF1B, SPLIT_END_DROP, 0);     // ；
+        map(0xFF0C, SPLIT_COPY, ',');       // ，
+        map(0x201C, SPLIT_REMOVE, 0);       // “
+        map(0x201D, SPLIT_REMOVE, 0);       // ”
+        map(0x2018, SPLIT_COPY, '\'');      // ‘
+        map(0x2019, SPLIT_COPY, '\'');      // ’
+        map(0x00AB, SPLIT_REMOVE, 0);       // «
+        map(0x00BB, SPLIT_REMOVE, 0);       // »
+    } else {
+        // 换行和制表符当作空格，连续的空格减半
+        t.ascii[static_cast<int>(' ')] = SPLIT_SPACE;
+        t.ascii[static_cast<int>('\n')] = SPLIT_SPACE;
+        t.ascii[static_cast<int>('\t')] = SPLIT_SPACE;
+        for (char c : string(".,!?;"))
+            t.ascii[static_cast<int>(c)] = SPLIT_END_KEEP;
+        map(0x3002, SPLIT_END_KEEP, '.');   // 。
+        map(0xFF01, SPLIT_END_KEEP, '.');   // ！
+        map(0xFF1F, SPLIT_END_KEEP, '.');   // ？
+        map(0xFF1B, SPLIT_END_KEEP, '.');   // ；
+        map(0xFF0C, SPLIT_END_KEEP, ',');   // ，
     }
-    
-    return sens_out;
+    for (int c = 0; c < 128; c++)
+        t.plain[c] = t.ascii[c] == SPLIT_COPY;
+    return t;
 }
 
-// 替换字符串中的子串
-string replace_all(const string& input, const string& from, const string& to) {
-    string result = input;
-    size_t pos = 0;
-    while ((pos = result.find(from, pos)) != string::npos) {
-        result.replace(pos, from.length(), to);
-        pos += to.length();
-    }
-    return result;
+inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
 }
 
-// 分割拉丁语系文本（英文、法文、西班牙文等）
-vector<string> split_sentences_latin(const string& text, int min_len = 10) {
-    string processed = text;
-    
-    // 替换中文标点为英文标点
-    processed = replace_all(processed, "。", ".");
-    processed = replace_all(processed, "！", ".");
-    processed = replace_all(processed, "？", ".");
-    processed = replace_all(processed, "；", ".");
-    processed = replace_all(processed, "，", ",");
-    processed = replace_all(processed, "“", "\"");
-    processed = replace_all(processed, "”", "\"");
-    processed = replace_all(processed, "‘", "'");
-    processed = replace_all(processed, "’", "'");
-    
-    // 移除特定字符
-    string chars_to_remove = "<>()[]\"«»";
-    for (char c : chars_to_remove) {
-        processed.erase(remove(processed.begin(), processed.end(), c), processed.end());
-    }
-    
-    // 分割句子（简化版，按句号分割）
-    vector<string> sentences;
-    size_t start = 0;
-    size_t end = processed.find('.');
-    
-    while (end != string::npos) {
-        string sentence = processed.substr(start, end - start);
-        // 去除前后空白
-        sentence.erase(sentence.begin(), find_if(sentence.begin(), sentence.end(), [](int ch) { return !isspace(ch); }));
-        sentence.erase(find_if(sentence.rbegin(), sentence.rend(), [](int ch) { return !isspace(ch); }).base(), sentence.end());
-        if (!sentence.empty()) {
-            sentences.push_back(sentence);
+inline SentenceSpan join(const string& text, const SentenceSpan& a, const SentenceSpan& b, bool latin) {
+    SentenceSpan merged{a.offset, b.offset + b.size - a.offset, a.length + b.length};
+    // 单词数直接相加；字符数多出一个分隔空格，含无效UTF-8时按字节重新数
+    if (!latin)
+        merged.length = utf8_strlen(text.data() + merged.offset, merged.size);
+    return merged;
+}
+
+// 单次扫描：解码UTF-8、按表处理标点和空白、去掉句首句尾空白
+inline void scan(const string& text, const SplitTable& table, bool latin, SplitResult& result) {
+    string& out = result.text;
+    vector<SentenceSpan>& spans = result.spans;
+    out.reserve(text.size() + 1);
+
+    const char* s = text.data();
+    size_t n = text.size();
+    bool started = false;
+    size_t begin = 0, length = 0;
+    size_t space_run = 0;
+    bool prev_blank = true;
+
+    auto start_sentence = [&]() {
+        if (!spans.empty())
+            out.push_back(' ');
+        begin = out.size();
+        length = 0;
+        prev_blank = true;
+        started = true;
+    };
+    auto end_sentence = [&]() {
+        if (!started)
+            return;
+        while (out.size() > begin && is_blank(out.back()))
+            out.pop_back();
+        if (!latin)
+            length = utf8_strlen(out.data() + begin, out.size() - begin);
+        spans.push_back(SentenceSpan{begin, out.size() - begin, length});
+        started = false;
+    };
+    // 输出非空白字符，拉丁语系在空白之后开始一个新单词
+    auto emit = [&](const char* p, size_t len) {
+        if (!started)
+            start_sentence();
+        out.append(p, len);
+        if (prev_blank)
+            length++;
+        prev_blank = false;
+    };
+    auto emit_blank = [&](char c) {
+        if (!started)
+            return;
+        out.push_back(c);
+        prev_blank = true;
+    };
+
+    size_t i = 0;
+    while (i < n) {
+        unsigned char c = s[i];
+        // 不需要处理的字节整段拷贝，无效的UTF-8也是原样输出
+        if (table.plain[c]) {
+            size_t j = i + 1;
+            while (j < n && table.plain[static_cast<unsigned char>(s[j])])
+                j++;
+            space_run = 0;
+            emit(s + i, j - i);
+            i = j;
+            continue;
         }
-        start = end + 1;
-        end = processed.find('.', start);
-    }
-    
-    // 添加最后一部分
-    if (start < processed.size()) {
-        string sentence = processed.substr(start);
-        sentence.erase(sentence.begin(), find_if(sentence.begin(), sentence.end(), [](int ch) { return !isspace(ch); }));
-        sentence.erase(find_if(sentence.rbegin(), sentence.rend(), [](int ch) { return !isspace(ch); }).base(), sentence.end());
-        if (!sentence.empty()) {
-            sentences.push_back(sentence);
+
+        uint8_t action;
+        char to = 0;
+        size_t len = 1;
+        if (c < 0x80) {
+            action = table.ascii[c];
+            to = static_cast<char>(c);
+        } else {
+            action = SPLIT_COPY;
+            len = utf8_char_len(c);
+            bool valid = len > 1 && i + len <= n;
+            for (size_t k = 1; valid && k < len; k++)
+                valid = is_utf8_continuation_byte(s[i + k]);
+            if (!valid) {
+                // 无效或截断的序列逐字节原样输出
+                len = 1;
+            } else {
+                uint32_t cp = c & (0x7F >> len);
+                for (size_t k = 1; k < len; k++)
+                    cp = (cp << 6) | (static_cast<unsigned char>(s[i + k]) & 0x3F);
+                for (size_t m = 0; m < table.mapping_count; m++) {
+                    if (table.mappings[m].cp == cp) {
+                        action = table.mappings[m].action;
+                        to = table.mappings[m].to;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (action != SPLIT_SPACE)
+            space_run = 0;
+
+        switch (action) {
+            case SPLIT_COPY:
+                if (to != 0 && c >= 0x80)
+                    emit(&to, 1);
+                else
+                    emit(s + i, len);
+                break;
+            case SPLIT_SPACE:
+                // 与原来两两替换"  "的结果一致：k个连续空格保留(k+1)/2个
+                if (space_run % 2 == 0)
+                    emit_blank(' ');
+                space_run++;
+                break;
+            case SPLIT_BLANK:
+                emit_blank(to);
+                break;
+            case SPLIT_REMOVE:
+                break;
+            case SPLIT_END_KEEP:
+                emit(&to, 1);
+                end_sentence();
+                break;
+            case SPLIT_END_DROP:
+                end_sentence();
+                break;
         }
+        i += len;
     }
-    
-    return merge_short_sentences_en(sentences);
+    end_sentence();
 }
 
-// 分割中文文本
-vector<string> split_sentences_zh(const string& text, int min_len = 10) {
-    string processed = text;
-    
-    // 替换中文标点为英文标点
-    processed = replace_all(processed, "。", ".");
-    processed = replace_all(processed, "！", ".");
-    processed = replace_all(processed, "？", ".");
-    processed = replace_all(processed, "；", ".");
-    processed = replace_all(processed, "，", ",");
-    
-    // 将文本中的换行符、空格和制表符替换为空格
-    processed = replace_all(processed, "\n", " ");
-    processed = replace_all(processed, "\t", " ");
-    processed = replace_all(processed, "  ", " "); // 多个空格合并为一个
-    
-    // 在标点符号后添加一个特殊标记用于分割
-    string punctuation = ".,!?;";
-    for (char c : punctuation) {
-        string from(1, c);
-        string to = from + " $#!";
-        processed = replace_all(processed, from, to);
+// 前一句太短时与当前句合并，最后一句太短时并入前一句
+inline void merge_short(const string& text, vector<SentenceSpan>& spans, bool latin) {
+    size_t out = 0;
+    for (size_t i = 0; i < spans.size(); i++) {
+        if (out > 0 && spans[out - 1].length <= 2)
+            spans[out - 1] = join(text, spans[out - 1], spans[i], latin);
+        else
+            spans[out++] = spans[i];
     }
-    
-    // 分割句子
-    vector<string> sentences;
-    size_t start = 0;
-    size_t end = processed.find("$#!");
-    
-    while (end != string::npos) {
-        string sentence = processed.substr(start, end - start);
-        // 去除前后空白
-        sentence.erase(sentence.begin(), find_if(sentence.begin(), sentence.end(), [](int ch) { return !isspace(ch); }));
-        sentence.erase(find_if(sentence.rbegin(), sentence.rend(), [](int ch) { return !isspace(ch); }).base(), sentence.end());
-        if (!sentence.empty()) {
-            sentences.push_back(sentence);
-        }
-        start = end + 3; // "$#!" 长度为3
-        end = processed.find("$#!", start);
+    if (out > 1 && spans[out - 1].length <= 2) {
+        spans[out - 2] = join(text, spans[out - 2], spans[out - 1], latin);
+        out--;
     }
-    
-    // 添加最后一部分
-    if (start < processed.size()) {
-        string sentence = processed.substr(start);
-        sentence.erase(sentence.begin(), find_if(sentence.begin(), sentence.end(), [](int ch) { return !isspace(ch); }));
-        sentence.erase(find_if(sentence.rbegin(), sentence.rend(), [](int ch) { return !isspace(ch); }).base(), sentence.end());
-        if (!sentence.empty()) {
-            sentences.push_back(sentence);
-        }
-    }
-    
-    // 按最小长度合并句子
-    vector<string> new_sentences;
-    vector<string> new_sent;
-    int count_len = 0;
-    
-    for (size_t i = 0; i < sentences.size(); ++i) {
-        new_sent.push_back(sentences[i]);
-        count_len += utf8_strlen(sentences[i]);
-        if (count_len > min_len || i == sentences.size() - 1) {
+    spans.resize(out);
+}
+
+// 按最小长度合并句子
+inline void merge_min_len(const string& text, vector<SentenceSpan>& spans, int min_len) {
+    size_t out = 0, group = 0;
+    long long count_len = 0;
+    for (size_t i = 0; i < spans.size(); i++) {
+        count_len += spans[i].length;
+        if (count_len > min_len || i == spans.size() - 1) {
+            spans[out++] = group == i ? spans[i] : join(text, spans[group], spans[i], false);
+            group = i + 1;
             count_len = 0;
-            ostringstream oss;
-            for (size_t j = 0; j < new_sent.size(); ++j) {
-                if (j != 0) oss << " ";
-                oss << new_sent[j];
-            }
-            new_sentences.push_back(oss.str());
-            new_sent.clear();
         }
     }
-    
-    return merge_short_sentences_zh(new_sentences);
+    spans.resize(out);
+}
+
+} // namespace split_detail
+
+// 分割拉丁语系文本（英文、法文、西班牙文等），按句号分句，min_len不使用
+inline void split_sentences_latin(const string& text, SplitResult& result, int min_len = 10) {
+    static const split_detail::SplitTable table = split_detail::make_table(true);
+    result.clear();
+    split_detail::scan(text, table, true, result);
+    split_detail::merge_short(result.text, result.spans, true);
+}
+
+// 分割中文文本，标点保留在句尾
+inline void split_sentences_zh(const string& text, SplitResult& result, int min_len = 10) {
+    static const split_detail::SplitTable table = split_detail::make_table(false);
+    result.clear();
+    split_detail::scan(text, table, false, result);
+    split_detail::merge_min_len(result.text, result.spans, min_len);
+    split_detail::merge_short(result.text, result.spans, false);
 }
 
 // 主分割函数
-vector<string> split_sentence(const string& text, int min_len = 10, const string& language_str = "EN") {
+inline void split_sentence(const string& text, SplitResult& result, int min_len = 10, const string& language_str = "EN") {
     if (language_str == "EN" || language_str == "FR" || language_str == "ES" || language_str == "SP") {
-        return split_sentences_latin(text, min_len);
+        split_sentences_latin(text, result, min_len);
     } else {
-        return split_sentences_zh(text, min_len);
+        split_sentences_zh(text, result, min_len);
     }
-}
\ No newline at end of file
+}
+
+inline vector<string> split_sentence(const string& text, int min_len = 10, const string& language_str = "EN") {
+    SplitResult result;
+    split_sentence(text, result, min_len, language_str);
+    vector<string> sens;
+    sens.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i++)
+        sens.push_back(result.sentence(i));
+    return sens;
+}
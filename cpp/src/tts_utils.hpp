@@ -0,0 +1,280 @@
+#pragma once
+
+#include <vector>
+#include <numeric>
+#include <utility>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// 在每个音素之间插入blank
+inline std::vector<int> intersperse(const std::vector<int>& lst, int item) {
+    std::vector<int> result(lst.size() * 2 + 1, item);
+    for (size_t i = 1; i < result.size(); i+=2) {
+        result[i] = lst[i / 2];
+    }
+    return result;
+}
+
+// 计算每个词的发音时长
+inline std::vector<int> calc_word2pronoun(const std::vector<int>& word2ph, const std::vector<int>& pronoun_lens) {
+    std::vector<int> indice = {0};
+    for (size_t i = 0; i + 1 < word2ph.size(); ++i) {
+        indice.push_back(indice.back() + word2ph[i]);
+    }
+
+    std::vector<int> word2pronoun;
+    for (size_t i = 0; i < word2ph.size(); ++i) {
+        int start = indice[i];
+        int end = start + word2ph[i];
+        int sum = std::accumulate(pronoun_lens.begin() + start, pronoun_lens.begin() + end, 0);
+        word2pronoun.push_back(sum);
+    }
+    return word2pronoun;
+}
+
+struct Slice {
+    int start;
+    int end;
+    Slice(int s, int e) : start(s), end(e) {}
+};
+
+// 生成有overlap的slice，slice索引是对于zp的
+inline std::pair<std::vector<Slice>, std::vector<Slice>> generate_slices(const std::vector<int>& word2pronoun, int dec_len) {
+    int pn_start = 0, pn_end = 0;
+    int zp_start = 0, zp_end = 0;
+    int zp_len = 0;
+    std::vector<Slice> pn_slices;
+    std::vector<Slice> zp_slices;
+
+    while (pn_end < static_cast<int>(word2pronoun.size())) {
+        // 检查是否可以向前overlap两个字
+        if (pn_end - pn_start > 2 &&
+            std::accumulate(word2pronoun.begin() + pn_end - 2, word2pronoun.begin() + pn_end + 1, 0) <= dec_len) {
+            zp_len = std::accumulate(word2pronoun.begin() + pn_end - 2, word2pronoun.begin() + pn_end, 0);
+            zp_start = zp_end - zp_len;
+            pn_start = pn_end - 2;
+        } else {
+            zp_len = 0;
+            zp_start = zp_end;
+            pn_start = pn_end;
+        }
+
+        while (pn_end < static_cast<int>(word2pronoun.size()) &&
+               zp_len + word2pronoun[pn_end] <= dec_len) {
+            zp_len += word2pronoun[pn_end];
+            pn_end++;
+        }
+
+        zp_end = zp_start + zp_len;
+        pn_slices.emplace_back(pn_start, pn_end);
+        zp_slices.emplace_back(zp_start, zp_end);
+    }
+
+    return std::make_pair(pn_slices, zp_slices);
+}
+
+// 一种decoder窗口：len为窗口帧数，cost为跑一次的代价(比如实测的推理ms)
+struct SliceBucket {
+    int len;
+    double cost;
+    SliceBucket(int l, double c) : len(l), cost(c) {}
+};
+
+// buckets按len从小到大排列，返回能放下frames帧的最小窗口，都放不下时返回最大的(由调用方截断)
+inline int pick_bucket(const std::vector<SliceBucket>& buckets, int frames) {
+    for (size_t b = 0; b < buckets.size(); b++) {
+        if (frames <= buckets[b].len)
+            return static_cast<int>(b);
+    }
+    return static_cast<int>(buckets.size()) - 1;
+}
+
+// 按最小decoder代价切片：和generate_slices一样只在词边界切，相邻两片要么不重叠，
+// 要么正好重叠两个词(拼接时前一片去掉最后一个词、后一片去掉第一个词)，重叠时前一片至少三个词。
+// 每片放进能装下它的最小窗口(pick_bucket)，在此约束下对word2pronoun做动态规划，
+// 先最小化各片窗口cost之和，再最小化切片数，最后最小化补零的帧数(即尽量多重叠)。
+// 只有一种窗口时就是最少切片数。单个词超过最大窗口时单独成片，和generate_slices一样由调用方截断
+inline std::pair<std::vector<Slice>, std::vector<Slice>> plan_slices_optimal(const std::vector<int>& word2pronoun,
+                                                                             const std::vector<SliceBucket>& buckets) {
+    const int n = static_cast<int>(word2pronoun.size());
+    std::vector<Slice> pn_slices, zp_slices;
+    if (n == 0 || buckets.empty())
+        return std::make_pair(pn_slices, zp_slices);
+
+    const int max_len = buckets.back().len;
+    std::vector<int> prefix(n + 1, 0);
+    for (int i = 0; i < n; i++)
+        prefix[i + 1] = prefix[i] + word2pronoun[i];
+    auto fits = [&](int s, int e) { return e - s == 1 || prefix[e] - prefix[s] <= max_len; };
+    auto bucket = [&](int s, int e) -> const SliceBucket& { return buckets[pick_bucket(buckets, prefix[e] - prefix[s])]; };
+    auto padding = [&](int s, int e) { return std::max(0, bucket(s, e).len - (prefix[e] - prefix[s])); };
+
+    // 一片最多的词数，状态按(片尾, 片长)存
+    int max_words = 1;
+    for (int s = 0, e = 1; e <= n; e++) {
+        while (!fits(s, e))
+            s++;
+        max_words = std::max(max_words, e - s);
+    }
+
+    // 状态(e, len)表示最后一片是[e - len, e)，cost = (窗口代价, 切片数, 补零帧数)，按字典序比较
+    struct State {
+        double cost = std::numeric_limits<double>::max();
+        int slices = 1 << 30;
+        int padded = 0;
+        // 上一片的状态，prev_len为0表示这是第一片
+        int prev_end = 0;
+        int prev_len = 0;
+
+        // (c, s, p)是否比当前更好，代价是浮点累加的，差别很小时视为相等
+        bool Better(double c, int s, int p) const {
+            const double eps = 1e-9 * std::max(1.0, std::fabs(c));
+            if (c < cost - eps)
+                return true;
+            if (c > cost + eps)
+                return false;
+            return s < slices || (s == slices && p < padded);
+        }
+    };
+    const int width = max_words + 1;
+    std::vector<State> states(static_cast<size_t>(n + 1) * width);
+    auto at = [&](int e, int len) -> State& { return states[static_cast<size_t>(e) * width + len]; };
+
+    for (int e = 1; e <= std::min(n, max_words) && fits(0, e); e++) {
+        at(e, e).cost = bucket(0, e).cost;
+        at(e, e).slices = 1;
+        at(e, e).padded = padding(0, e);
+    }
+    for (int e = 1; e < n; e++) {
+        for (int len = 1; len <= std::min(e, max_words); len++) {
+            const State cur = at(e, len);
+            if (cur.prev_len == 0 && cur.slices != 1)
+                continue;
+            // 下一片从e开始(不重叠)，或者从e-2开始(重叠两个词，当前片至少三个词)
+            int starts[2] = {e, len >= 3 ? e - 2 : -1};
+            for (int next_s : starts) {
+                if (next_s < 0)
+                    continue;
+                for (int next_e = e + 1; next_e <= n && fits(next_s, next_e); next_e++) {
+                    State& next = at(next_e, next_e - next_s);
+                    double cost = cur.cost + bucket(next_s, next_e).cost;
+                    int padded = cur.padded + padding(next_s, next_e);
+                    if (next.Better(cost, cur.slices + 1, padded)) {
+                        next.cost = cost;
+                        next.slices = cur.slices + 1;
+                        next.padded = padded;
+                        next.prev_end = e;
+                        next.prev_len = len;
+                    }
+                }
+            }
+        }
+    }
+
+    int best_len = 1;
+    for (int len = 2; len <= std::min(n, max_words); len++) {
+        const State& st = at(n, len);
+        if (at(n, best_len).Better(st.cost, st.slices, st.padded))
+            best_len = len;
+    }
+    for (int e = n, len = best_len; len > 0; ) {
+        const State& st = at(e, len);
+        pn_slices.emplace_back(e - len, e);
+        zp_slices.emplace_back(prefix[e - len], prefix[e]);
+        e = st.prev_end;
+        len = st.prev_len;
+    }
+    std::reverse(pn_slices.begin(), pn_slices.end());
+    std::reverse(zp_slices.begin(), zp_slices.end());
+    return std::make_pair(pn_slices, zp_slices);
+}
+
+// 只有一种dec_len的窗口时按最少decoder调用切片
+inline std::pair<std::vector<Slice>, std::vector<Slice>> plan_slices_optimal(const std::vector<int>& word2pronoun, int dec_len) {
+    return plan_slices_optimal(word2pronoun, std::vector<SliceBucket>{SliceBucket(dec_len, 1.0)});
+}
+
+// 不按词边界、直接在z_p帧上切片，相邻两片重叠overlap帧，由CrossfadeStitcher交叉淡化拼接。
+// 每片都是dec_len帧，最后一片到句尾为止，最短只有overlap + 1帧
+inline std::vector<Slice> generate_frame_slices(int total_frames, int dec_len, int overlap) {
+    std::vector<Slice> zp_slices;
+    if (total_frames <= 0 || dec_len <= overlap)
+        return zp_slices;
+    for (int start = 0; ; start += dec_len - overlap) {
+        int end = std::min(start + dec_len, total_frames);
+        zp_slices.emplace_back(start, end);
+        if (end == total_frames)
+            break;
+    }
+    return zp_slices;
+}
+
+// generate_frame_slices的多窗口版本：对片尾位置做动态规划，每片放进能装下它的最小窗口，
+// 先最小化各片窗口cost之和，再最小化切片数和补零帧数。
+// 不是最后一片时把窗口填满不会更差，所以每片只需要考虑各窗口长度和到句尾为止这几种结尾。
+// 除了最后一片，每片至少2 * overlap + 1帧，首尾两段淡化区不会重叠；
+// 最后一片从上一片结尾前overlap帧开始，最短只有overlap + 1帧，只在开头淡化
+inline std::vector<Slice> plan_frame_slices_optimal(int total_frames, const std::vector<SliceBucket>& buckets, int overlap) {
+    std::vector<Slice> zp_slices;
+    if (total_frames <= 0 || buckets.empty() || buckets.back().len <= 2 * overlap)
+        return zp_slices;
+    const int max_len = buckets.back().len;
+    const int min_len = 2 * overlap + 1;
+
+    struct State {
+        double cost = std::numeric_limits<double>::max();
+        int slices = 1 << 30;
+        int padded = 0;
+        // 这一片的起点，-1表示不可达
+        int start = -1;
+
+        bool Better(double c, int s, int p) const {
+            const double eps = 1e-9 * std::max(1.0, std::fabs(c));
+            if (c < cost - eps)
+                return true;
+            if (c > cost + eps)
+                return false;
+            return s < slices || (s == slices && p < padded);
+        }
+    };
+    // states[e]：最后一片结束在e帧
+    std::vector<State> states(total_frames + 1);
+    auto relax = [&](int prev_end, int start, int end) {
+        const SliceBucket& b = buckets[pick_bucket(buckets, end - start)];
+        const State& prev = states[prev_end];
+        double cost = (prev_end > 0 ? prev.cost : 0) + b.cost;
+        int slices = (prev_end > 0 ? prev.slices : 0) + 1;
+        int padded = (prev_end > 0 ? prev.padded : 0) + b.len - (end - start);
+        if (states[end].Better(cost, slices, padded)) {
+            states[end].cost = cost;
+            states[end].slices = slices;
+            states[end].padded = padded;
+            states[end].start = start;
+        }
+    };
+
+    // 从start开始的一片，prev_end为0表示第一片
+    auto extend = [&](int prev_end, int start) {
+        if (total_frames - start <= max_len)
+            relax(prev_end, start, total_frames);
+        for (const SliceBucket& b : buckets) {
+            if (b.len >= min_len && start + b.len < total_frames)
+                relax(prev_end, start, start + b.len);
+        }
+    };
+    extend(0, 0);
+    for (int prev_end = min_len; prev_end < total_frames; prev_end++) {
+        if (states[prev_end].start >= 0)
+            extend(prev_end, prev_end - overlap);
+    }
+
+    for (int end = total_frames; end > 0; ) {
+        int start = states[end].start;
+        zp_slices.emplace_back(start, end);
+        end = start > 0 ? start + overlap : 0;
+    }
+    std::reverse(zp_slices.begin(), zp_slices.end());
+    return zp_slices;
+}
@@ -477,6 +477,33 @@ namespace utils {
         return 0;
     }
 
+    // cached buffer在NPU写完之后、CPU读之前丢弃cache中的旧数据
+    static inline AX_S32 cache_io_invalidate(const AX_ENGINE_IO_BUFFER_T *io_buf) {
+        if (io_buf->phyAddr != 0) {
+            AX_SYS_MinvalidateCache(io_buf->phyAddr, io_buf->pVirAddr, io_buf->nSize);
+        }
+
+        return 0;
+    }
+
+    // 运行前把CPU写入的所有输入刷回内存
+    static inline AX_S32 cache_io_flush(const AX_ENGINE_IO_T &io) {
+        for (AX_U32 i = 0; i < io.nInputSize; ++i) {
+            cache_io_flush(&io.pInputs[i]);
+        }
+
+        return 0;
+    }
+
+    // 运行后作废所有输出的cache
+    static inline AX_S32 cache_io_invalidate(const AX_ENGINE_IO_T &io) {
+        for (AX_U32 i = 0; i < io.nOutputSize; ++i) {
+            cache_io_invalidate(&io.pOutputs[i]);
+        }
+
+        return 0;
+    }
+
     static inline AX_S32 push_io_output(void* output,
                                         int index,
                                         AX_ENGINE_IO_T& io) {
@@ -139,7 +139,8 @@ def main():
         inputs = (
             torch.rand(1, 192, dec_len), g
         )
-        decoder_name = f"decoder-{lower_lang}.onnx"
+        # 默认长度之外的decoder带上dec_len，可以和默认的一起作为多个窗口加载
+        decoder_name = f"decoder-{lower_lang}.onnx" if dec_len == 128 else f"decoder-{lower_lang}-{dec_len}.onnx"
         tts.model.forward = tts.model.flow_dec_forward
         torch.onnx.export(tts.model,               # model being run
                         inputs,                    # model input (or a tuple for multiple inputs)